@@ -0,0 +1,693 @@
+//
+// Headless benchmark that replays the demo scenes through a null back-end
+// and reports where the CPU time goes per frame. With -s the scenes are drawn
+// by the software back-end instead, and a checksum of the pixels is printed.
+//
+// Build and run from the example directory:
+//   cc -O2 -I../src -DNANOVG_NO_GLEW -DNANOVG_NO_GL bench.c demo.c -o bench -lm -lpthread
+//   ./bench [-n frames] [-t] [-c] [-g] [-s threads] [-a]
+//
+//   -n frames  number of frames per scene (default 200)
+//   -t         enable NVG_THREADED_TESSELLATION style deferred tessellation
+//   -c         reset the glyph atlas every frame to measure cold glyph rasterization
+//   -g         take text as glyph instances (renderGlyphs) instead of triangles
+//   -s threads render with nanovg_sw.h on this many threads (0 = one per CPU) and print a
+//              checksum of the last frame of each scene, which has to be the same for any
+//              thread count and with or without -t; text is always drawn as glyph instances
+//   -a         pack glyph boxes of the demo fonts with the font atlas packer and with
+//              reference MaxRects and size class shelf packers, and compare atlas fill
+//              and packing throughput instead of running the scenes
+//
+// Stage times are summed over all threads, so with -t they can exceed the
+// wall clock frame time.
+//
+
+#define NVG_PROFILE
+#include "nanovg.c"
+#define NANOVG_SW_IMPLEMENTATION
+#include "nanovg_sw.h"
+#include "demo.h"
+
+#define BENCH_MAX_TEXTURES 64
+#define ICON_LOGIN 0xE740
+#define ICON_TRASH 0xE729
+
+typedef struct BenchTexture {
+	int w, h;
+} BenchTexture;
+
+typedef struct BenchBackend {
+	BenchTexture textures[BENCH_MAX_TEXTURES];
+	int ntextures;
+	double checksum;	// Keeps the geometry observable so nothing gets optimized away.
+} BenchBackend;
+
+static int benchRenderCreate(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+	return 1;
+}
+
+static int benchRenderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	BenchBackend* bb = (BenchBackend*)uptr;
+	NVG_NOTUSED(type);
+	NVG_NOTUSED(imageFlags);
+	NVG_NOTUSED(data);
+	if (bb->ntextures >= BENCH_MAX_TEXTURES) return 0;
+	bb->textures[bb->ntextures].w = w;
+	bb->textures[bb->ntextures].h = h;
+	return ++bb->ntextures;
+}
+
+static int benchRenderDeleteTexture(void* uptr, int image)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(image);
+	return 1;
+}
+
+static int benchRenderUpdateTexture(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(image);
+	NVG_NOTUSED(x);
+	NVG_NOTUSED(y);
+	NVG_NOTUSED(w);
+	NVG_NOTUSED(h);
+	NVG_NOTUSED(data);
+	return 1;
+}
+
+static int benchRenderGetTextureSize(void* uptr, int image, int* w, int* h)
+{
+	BenchBackend* bb = (BenchBackend*)uptr;
+	if (image < 1 || image > bb->ntextures) return 0;
+	*w = bb->textures[image-1].w;
+	*h = bb->textures[image-1].h;
+	return 1;
+}
+
+static void benchRenderViewport(void* uptr, float width, float height, float devicePixelRatio)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(width);
+	NVG_NOTUSED(height);
+	NVG_NOTUSED(devicePixelRatio);
+}
+
+static void benchRenderCancel(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+}
+
+static void benchRenderFlush(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+}
+
+static void benchConsumeVerts(BenchBackend* bb, const NVGvertex* verts, int nverts)
+{
+	int i;
+	for (i = 0; i < nverts; i++)
+		bb->checksum += verts[i].x + verts[i].y;
+}
+
+static void benchRenderFill(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+							const float* bounds, const NVGpath* paths, int npaths)
+{
+	BenchBackend* bb = (BenchBackend*)uptr;
+	int i;
+	NVG_NOTUSED(paint);
+	NVG_NOTUSED(compositeOperation);
+	NVG_NOTUSED(scissor);
+	NVG_NOTUSED(fringe);
+	NVG_NOTUSED(bounds);
+	for (i = 0; i < npaths; i++) {
+		benchConsumeVerts(bb, paths[i].fill, paths[i].nfill);
+		benchConsumeVerts(bb, paths[i].stroke, paths[i].nstroke);
+	}
+}
+
+static void benchRenderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+							  float strokeWidth, const NVGpath* paths, int npaths)
+{
+	BenchBackend* bb = (BenchBackend*)uptr;
+	int i;
+	NVG_NOTUSED(paint);
+	NVG_NOTUSED(compositeOperation);
+	NVG_NOTUSED(scissor);
+	NVG_NOTUSED(fringe);
+	NVG_NOTUSED(strokeWidth);
+	for (i = 0; i < npaths; i++)
+		benchConsumeVerts(bb, paths[i].stroke, paths[i].nstroke);
+}
+
+static void benchRenderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+								 const NVGvertex* verts, int nverts, float fringe)
+{
+	NVG_NOTUSED(paint);
+	NVG_NOTUSED(compositeOperation);
+	NVG_NOTUSED(scissor);
+	NVG_NOTUSED(fringe);
+	benchConsumeVerts((BenchBackend*)uptr, verts, nverts);
+}
+
+static void benchRenderGlyphs(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+							  const NVGglyphInstance* glyphs, int nglyphs, float fringe)
+{
+	BenchBackend* bb = (BenchBackend*)uptr;
+	int i;
+	NVG_NOTUSED(paint);
+	NVG_NOTUSED(compositeOperation);
+	NVG_NOTUSED(scissor);
+	NVG_NOTUSED(fringe);
+	for (i = 0; i < nglyphs; i++)
+		bb->checksum += glyphs[i].x + glyphs[i].y;
+}
+
+static void benchRenderDelete(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+}
+
+static NVGcontext* benchCreate(BenchBackend* bb, int threaded, int glyphs)
+{
+	NVGparams params;
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = benchRenderCreate;
+	params.renderCreateTexture = benchRenderCreateTexture;
+	params.renderDeleteTexture = benchRenderDeleteTexture;
+	params.renderUpdateTexture = benchRenderUpdateTexture;
+	params.renderGetTextureSize = benchRenderGetTextureSize;
+	params.renderViewport = benchRenderViewport;
+	params.renderCancel = benchRenderCancel;
+	params.renderFlush = benchRenderFlush;
+	params.renderFill = benchRenderFill;
+	params.renderStroke = benchRenderStroke;
+	params.renderTriangles = benchRenderTriangles;
+	params.renderGlyphs = glyphs ? benchRenderGlyphs : NULL;
+	params.renderDelete = benchRenderDelete;
+	params.userPtr = bb;
+	params.edgeAntiAlias = 1;
+	params.threadedTessellation = threaded;
+	return nvgCreateInternal(&params);
+}
+
+// Scenes
+
+#define BENCH_WIDTH 1000.0f
+#define BENCH_HEIGHT 600.0f
+
+typedef void (*BenchSceneFunc)(NVGcontext* vg, float t, DemoData* data);
+
+static void sceneDemo(NVGcontext* vg, float t, DemoData* data) { renderDemo(vg, 500, 300, BENCH_WIDTH, BENCH_HEIGHT, t, 0, data); }
+static void sceneEyes(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(data); drawEyes(vg, BENCH_WIDTH - 250, 50, 150, 100, 500, 300, t); }
+static void sceneParagraph(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawParagraph(vg, BENCH_WIDTH - 450, 50, 150, 100, 500, 300); }
+static void sceneGraph(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(data); drawGraph(vg, 0, BENCH_HEIGHT/2, BENCH_WIDTH, BENCH_HEIGHT/2, t); }
+static void sceneColorwheel(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(data); drawColorwheel(vg, BENCH_WIDTH - 300, BENCH_HEIGHT - 300, 250.0f, 250.0f, t); }
+static void sceneLines(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(data); drawLines(vg, 120, BENCH_HEIGHT - 50, 600, 50, t); }
+static void sceneWidths(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawWidths(vg, 10, 50, 30); }
+static void sceneCaps(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawCaps(vg, 10, 300, 30); }
+static void sceneScissor(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(data); drawScissor(vg, 50, BENCH_HEIGHT - 80, t); }
+static void sceneWindow(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawWindow(vg, "Widgets `n Stuff", 50, 50, 300, 400); }
+static void sceneSearchBox(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawSearchBox(vg, "Search", 60, 95, 280, 25); }
+static void sceneDropDown(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawDropDown(vg, "Effects", 60, 135, 280, 28); }
+static void sceneLabel(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawLabel(vg, "Login", 60, 180, 280, 20); }
+static void sceneEditBox(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawEditBox(vg, "Email", 60, 205, 280, 28); }
+static void sceneEditBoxNum(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawEditBoxNum(vg, "123.00", "px", 240, 343, 100, 28); }
+static void sceneCheckBox(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawCheckBox(vg, "Remember me", 60, 278, 140, 28); }
+static void sceneButton(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawButton(vg, ICON_LOGIN, "Sign in", 198, 278, 140, 28, nvgRGBA(0,96,128,255)); }
+static void sceneSlider(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(t); NVG_NOTUSED(data); drawSlider(vg, 0.4f, 60, 343, 170, 28); }
+static void sceneSpinner(NVGcontext* vg, float t, DemoData* data) { NVG_NOTUSED(data); drawSpinner(vg, 445, 300, 10, t); }
+static void sceneThumbnails(NVGcontext* vg, float t, DemoData* data) { drawThumbnails(vg, 365, 119, 160, 300, data->images, 12, t); }
+
+typedef struct BenchScene {
+	const char* name;
+	BenchSceneFunc func;
+} BenchScene;
+
+static const BenchScene benchScenes[] = {
+	{ "demo", sceneDemo },
+	{ "eyes", sceneEyes },
+	{ "paragraph", sceneParagraph },
+	{ "graph", sceneGraph },
+	{ "colorwheel", sceneColorwheel },
+	{ "lines", sceneLines },
+	{ "widths", sceneWidths },
+	{ "caps", sceneCaps },
+	{ "scissor", sceneScissor },
+	{ "window", sceneWindow },
+	{ "searchbox", sceneSearchBox },
+	{ "dropdown", sceneDropDown },
+	{ "label", sceneLabel },
+	{ "editbox", sceneEditBox },
+	{ "editboxnum", sceneEditBoxNum },
+	{ "checkbox", sceneCheckBox },
+	{ "button", sceneButton },
+	{ "slider", sceneSlider },
+	{ "spinner", sceneSpinner },
+	{ "thumbnails", sceneThumbnails },
+};
+
+// Clears the software back-end's frame buffer and sets it as the render target, if there is one.
+static void benchBeginFrame(NVGcontext* vg, unsigned char* pixels)
+{
+	int i;
+	if (pixels == NULL)
+		return;
+	for (i = 0; i < (int)BENCH_WIDTH * (int)BENCH_HEIGHT; i++) {
+		pixels[i*4+0] = 77;
+		pixels[i*4+1] = 77;
+		pixels[i*4+2] = 82;
+		pixels[i*4+3] = 255;
+	}
+	nvgBeginFrameSW(vg, pixels, (int)BENCH_WIDTH, (int)BENCH_HEIGHT, (int)BENCH_WIDTH * 4);
+}
+
+static unsigned int benchPixelChecksum(const unsigned char* pixels)
+{
+	unsigned int h = 2166136261u;
+	int i;
+	for (i = 0; i < (int)BENCH_WIDTH * (int)BENCH_HEIGHT * 4; i++)
+		h = (h ^ pixels[i]) * 16777619u;
+	return h;
+}
+
+static void benchRun(NVGcontext* vg, const BenchScene* scene, DemoData* data, int nframes, int cold, unsigned char* pixels)
+{
+	NVGframeStats stats;
+	double total = 0, flatten = 0, joins = 0, expand = 0, text = 0, glyphs = 0, record;
+	int i;
+
+	// Warm up caches and buffers before measuring.
+	for (i = 0; i < 4; i++) {
+		benchBeginFrame(vg, pixels);
+		nvgBeginFrame(vg, BENCH_WIDTH, BENCH_HEIGHT, 1.0f);
+		scene->func(vg, i / 60.0f, data);
+		nvgEndFrame(vg);
+	}
+
+	for (i = 0; i < nframes; i++) {
+		long long start;
+		if (cold)
+			fonsResetAtlas(vg->fs, vg->fs->params.width, vg->fs->params.height);
+		benchBeginFrame(vg, pixels);
+		start = nvg__profileTicks();
+		nvgBeginFrame(vg, BENCH_WIDTH, BENCH_HEIGHT, 1.0f);
+		scene->func(vg, i / 60.0f, data);
+		nvgEndFrame(vg);
+		total += (nvg__profileTicks() - start) * 1e-9;
+
+		nvgGetFrameStats(vg, &stats);
+		flatten += stats.flattenTime;
+		joins += stats.joinsTime;
+		expand += stats.expandTime;
+		text += stats.textTime;
+		glyphs += stats.glyphTime;
+	}
+
+	record = total - flatten - joins - expand - text - glyphs;
+	if (record < 0) record = 0;
+
+	printf("%-12s %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f", scene->name,
+		   total * 1e9 / nframes, record * 1e9 / nframes, flatten * 1e9 / nframes, joins * 1e9 / nframes,
+		   expand * 1e9 / nframes, text * 1e9 / nframes, glyphs * 1e9 / nframes);
+	if (pixels != NULL)
+		printf(" %08x", benchPixelChecksum(pixels));
+	printf("\n");
+}
+
+// Atlas packing
+
+#define BENCH_MAX_BANDS 64
+
+typedef struct BenchRect {
+	int x, y, w, h;
+} BenchRect;
+
+typedef struct BenchRects {
+	BenchRect* rects;
+	int nrects;
+	int crects;
+} BenchRects;
+
+static void benchAddRect(BenchRects* list, int x, int y, int w, int h)
+{
+	if (list->nrects+1 > list->crects) {
+		list->crects = list->nrects+1 + list->crects/2;
+		list->rects = (BenchRect*)realloc(list->rects, sizeof(BenchRect) * list->crects);
+	}
+	list->rects[list->nrects].x = x;
+	list->rects[list->nrects].y = y;
+	list->rects[list->nrects].w = w;
+	list->rects[list->nrects].h = h;
+	list->nrects++;
+}
+
+// Adds the padded bitmap boxes of a codepoint range at each size, in a shuffled order per size as text would bring them.
+static void benchAddGlyphBoxes(BenchRects* boxes, NVGcontext* vg, int font, unsigned int first, unsigned int last,
+							   const float* sizes, int nsizes, int blur, unsigned int* seed)
+{
+	FONSttFontImpl* impl = &vg->fs->fonts[font]->font;
+	int n = (int)(last - first + 1), pad = blur + 2, i, j;
+	unsigned int* order = (unsigned int*)malloc(sizeof(unsigned int) * n);
+	for (i = 0; i < nsizes; i++) {
+		float scale = fons__tt_getPixelHeightScale(impl, sizes[i]);
+		for (j = 0; j < n; j++)
+			order[j] = first + j;
+		for (j = n-1; j > 0; j--) {
+			unsigned int k, t;
+			*seed = *seed * 1103515245u + 12345u;
+			k = (*seed >> 16) % (unsigned int)(j+1);
+			t = order[j]; order[j] = order[k]; order[k] = t;
+		}
+		for (j = 0; j < n; j++) {
+			int g = fons__tt_getGlyphIndex(impl, (int)order[j]), advance, lsb, x0, y0, x1, y1;
+			if (g == 0) continue;
+			fons__tt_buildGlyphBitmap(impl, g, sizes[i], scale, &advance, &lsb, &x0, &y0, &x1, &y1);
+			benchAddRect(boxes, 0, 0, x1-x0 + pad*2, y1-y0 + pad*2);
+		}
+	}
+	free(order);
+}
+
+// Reference MaxRects packer with the best short side fit rule, one free list per band.
+typedef struct BenchMaxRects {
+	BenchRects bands[BENCH_MAX_BANDS];
+	int width, bandHeight, nbands;
+} BenchMaxRects;
+
+static void benchMaxRectsReset(BenchMaxRects* mr, int w, int h)
+{
+	int i;
+	mr->width = w;
+	mr->bandHeight = h / FONS_ATLAS_BANDS;
+	mr->nbands = FONS_ATLAS_BANDS;
+	for (i = 0; i < mr->nbands; i++) {
+		mr->bands[i].nrects = 0;
+		benchAddRect(&mr->bands[i], 0, 0, w, mr->bandHeight);
+	}
+}
+
+static int benchMaxRectsAdd(BenchMaxRects* mr, int w, int h, int* x, int* y)
+{
+	int i, j, bestBand = -1, best = -1, bestShort = 0x7fffffff, bestLong = 0x7fffffff, n;
+	BenchRects* free;
+	BenchRect used;
+
+	for (i = 0; i < mr->nbands; i++) {
+		for (j = 0; j < mr->bands[i].nrects; j++) {
+			BenchRect* r = &mr->bands[i].rects[j];
+			int dw = r->w - w, dh = r->h - h;
+			int shortSide = dw < dh ? dw : dh, longSide = dw < dh ? dh : dw;
+			if (dw < 0 || dh < 0) continue;
+			if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong)) {
+				bestBand = i;
+				best = j;
+				bestShort = shortSide;
+				bestLong = longSide;
+			}
+		}
+	}
+	if (best == -1)
+		return 0;
+
+	// Split every free rect the new one overlaps, then drop the free rects contained in others.
+	free = &mr->bands[bestBand];
+	used.x = free->rects[best].x;
+	used.y = free->rects[best].y;
+	used.w = w;
+	used.h = h;
+	n = free->nrects;
+	for (i = 0; i < n; i++) {
+		BenchRect r = free->rects[i];
+		if (used.x >= r.x+r.w || used.x+used.w <= r.x || used.y >= r.y+r.h || used.y+used.h <= r.y)
+			continue;
+		if (used.x > r.x) benchAddRect(free, r.x, r.y, used.x - r.x, r.h);
+		if (used.x+used.w < r.x+r.w) benchAddRect(free, used.x+used.w, r.y, r.x+r.w - (used.x+used.w), r.h);
+		if (used.y > r.y) benchAddRect(free, r.x, r.y, r.w, used.y - r.y);
+		if (used.y+used.h < r.y+r.h) benchAddRect(free, r.x, used.y+used.h, r.w, r.y+r.h - (used.y+used.h));
+		free->rects[i] = free->rects[--n];
+		free->rects[n] = free->rects[--free->nrects];
+		i--;
+	}
+	for (i = 0; i < free->nrects; i++) {
+		for (j = i+1; j < free->nrects; j++) {
+			BenchRect* a = &free->rects[i];
+			BenchRect* b = &free->rects[j];
+			if (a->x >= b->x && a->y >= b->y && a->x+a->w <= b->x+b->w && a->y+a->h <= b->y+b->h) {
+				free->rects[i--] = free->rects[--free->nrects];
+				break;
+			}
+			if (b->x >= a->x && b->y >= a->y && b->x+b->w <= a->x+a->w && b->y+b->h <= a->y+a->h)
+				free->rects[j--] = free->rects[--free->nrects];
+		}
+	}
+
+	*x = used.x;
+	*y = bestBand * mr->bandHeight + used.y;
+	return 1;
+}
+
+// Reference shelf packer, rects go to the shelf of their size class with the least height left over.
+typedef struct BenchShelves {
+	BenchRects shelves[BENCH_MAX_BANDS];	// x is the used width, y and h the shelf row.
+	int top[BENCH_MAX_BANDS];
+	int width, bandHeight, nbands;
+} BenchShelves;
+
+static int benchShelfClass(int h)
+{
+	if (h <= 8) return (h+1) & ~1;
+	if (h <= 32) return (h+3) & ~3;
+	return (h+7) & ~7;
+}
+
+static void benchShelvesReset(BenchShelves* sp, int w, int h)
+{
+	int i;
+	sp->width = w;
+	sp->bandHeight = h / FONS_ATLAS_BANDS;
+	sp->nbands = FONS_ATLAS_BANDS;
+	for (i = 0; i < sp->nbands; i++) {
+		sp->shelves[i].nrects = 0;
+		sp->top[i] = 0;
+	}
+}
+
+static int benchShelvesAdd(BenchShelves* sp, int w, int h, int* x, int* y)
+{
+	int c = benchShelfClass(h), pass, i, j, bestBand = -1, best = -1, bestWaste = 0x7fffffff;
+	BenchRect* shelf;
+
+	// Prefer a shelf of about the size class, then a new shelf, then any shelf tall enough.
+	for (pass = 0; pass < 3 && best == -1; pass++) {
+		for (i = 0; i < sp->nbands; i++) {
+			if (pass == 1) {
+				if (sp->top[i] + c <= sp->bandHeight) {
+					benchAddRect(&sp->shelves[i], 0, sp->top[i], sp->width, c);
+					sp->top[i] += c;
+					bestBand = i;
+					best = sp->shelves[i].nrects-1;
+					break;
+				}
+				continue;
+			}
+			for (j = 0; j < sp->shelves[i].nrects; j++) {
+				BenchRect* r = &sp->shelves[i].rects[j];
+				if (r->h < h || r->x + w > sp->width || (pass == 0 && r->h > c + c/4)) continue;
+				if (r->h - h < bestWaste) {
+					bestBand = i;
+					best = j;
+					bestWaste = r->h - h;
+				}
+			}
+		}
+	}
+	if (best == -1)
+		return 0;
+
+	shelf = &sp->shelves[bestBand].rects[best];
+	*x = shelf->x;
+	*y = bestBand * sp->bandHeight + shelf->y;
+	shelf->x += w;
+	return 1;
+}
+
+typedef struct BenchPacker {
+	const char* name;
+	void (*reset)(void* packer, int w, int h);
+	int (*add)(void* packer, int w, int h, int* x, int* y);
+} BenchPacker;
+
+static void benchSkylineReset(void* packer, int w, int h)
+{
+	FONSatlas** atlas = (FONSatlas**)packer;
+	if (*atlas != NULL) fons__deleteAtlas(*atlas);
+	*atlas = fons__allocAtlas(w, h);
+}
+static int benchSkylineAdd(void* packer, int w, int h, int* x, int* y) { return fons__atlasAddRect(*(FONSatlas**)packer, w, h, x, y); }
+static void benchMaxRectsResetAny(void* packer, int w, int h) { benchMaxRectsReset((BenchMaxRects*)packer, w, h); }
+static int benchMaxRectsAddAny(void* packer, int w, int h, int* x, int* y) { return benchMaxRectsAdd((BenchMaxRects*)packer, w, h, x, y); }
+static void benchShelvesResetAny(void* packer, int w, int h) { benchShelvesReset((BenchShelves*)packer, w, h); }
+static int benchShelvesAddAny(void* packer, int w, int h, int* x, int* y) { return benchShelvesAdd((BenchShelves*)packer, w, h, x, y); }
+
+// Fill at the first rect that does not fit, which is when fontstash adds a page or evicts,
+// fill after offering every rect, and rects packed per second.
+static void benchPack(const char* name, const BenchRects* boxes, int w, int h)
+{
+	static FONSatlas* skyline = NULL;
+	static BenchMaxRects maxRects;
+	static BenchShelves shelves;
+	const BenchPacker packers[] = {
+		{ "skyline", benchSkylineReset, benchSkylineAdd },
+		{ "maxrects", benchMaxRectsResetAny, benchMaxRectsAddAny },
+		{ "shelves", benchShelvesResetAny, benchShelvesAddAny },
+	};
+	void* states[] = { &skyline, &maxRects, &shelves };
+	int i, j, k, x, y;
+
+	for (i = 0; i < 3; i++) {
+		double firstFill = -1, fill = 0, best = 1e30;
+		int packed = 0, rounds = 8;
+		packers[i].reset(states[i], w, h);
+		for (j = 0; j < boxes->nrects; j++) {
+			const BenchRect* r = &boxes->rects[j];
+			if (packers[i].add(states[i], r->w, r->h, &x, &y)) {
+				fill += (double)r->w * r->h;
+				packed++;
+			} else if (firstFill < 0) {
+				firstFill = fill;
+			}
+		}
+		if (firstFill < 0) firstFill = fill;
+		for (k = 0; k < 5; k++) {
+			long long start = nvg__profileTicks();
+			for (j = 0; j < rounds; j++) {
+				packers[i].reset(states[i], w, h);
+				for (x = 0; x < boxes->nrects; x++)
+					packers[i].add(states[i], boxes->rects[x].w, boxes->rects[x].h, &y, &y);
+			}
+			best = nvg__minf((float)best, (float)((nvg__profileTicks() - start) * 1e-9));
+		}
+		printf("%-10s %-9s %6d %6d %9.1f%% %9.1f%% %10.2f\n", i == 0 ? name : "", packers[i].name, boxes->nrects, packed,
+			   firstFill * 100.0 / ((double)w * h), fill * 100.0 / ((double)w * h), boxes->nrects * rounds / best * 1e-6);
+	}
+	if (skyline != NULL) fons__deleteAtlas(skyline);
+	skyline = NULL;
+	for (i = 0; i < BENCH_MAX_BANDS; i++) {
+		free(maxRects.bands[i].rects);
+		free(shelves.shelves[i].rects);
+	}
+	memset(&maxRects, 0, sizeof(maxRects));
+	memset(&shelves, 0, sizeof(shelves));
+}
+
+static void benchAtlas(NVGcontext* vg, DemoData* data)
+{
+	static const float uiSizes[] = { 12, 13, 14, 15, 16, 18, 20, 22, 24, 28, 32, 36, 48 };
+	static const float emojiSizes[] = { 16, 20, 24, 32, 40 };
+	float zoomSizes[57];
+	BenchRects boxes;
+	unsigned int seed = 1;
+	int i;
+
+	memset(&boxes, 0, sizeof(boxes));
+	printf("%-10s %-9s %6s %6s %10s %10s %10s\n", "workload", "packer", "rects", "packed", "fill@fail", "fill", "Mrects/s");
+
+	benchAddGlyphBoxes(&boxes, vg, data->fontNormal, 33, 126, uiSizes, 13, 0, &seed);
+	benchAddGlyphBoxes(&boxes, vg, data->fontBold, 33, 126, uiSizes, 6, 0, &seed);
+	benchPack("ui", &boxes, 512, 512);
+
+	boxes.nrects = 0;
+	for (i = 0; i < 57; i++)
+		zoomSizes[i] = 8.0f + i;
+	benchAddGlyphBoxes(&boxes, vg, data->fontNormal, 33, 126, zoomSizes, 57, 0, &seed);
+	benchPack("zoom", &boxes, 1024, 1024);
+
+	boxes.nrects = 0;
+	benchAddGlyphBoxes(&boxes, vg, data->fontEmoji, 0x1f600, 0x1f64f, emojiSizes, 5, 0, &seed);
+	benchAddGlyphBoxes(&boxes, vg, data->fontNormal, 33, 126, emojiSizes, 5, 0, &seed);
+	benchPack("emoji", &boxes, 512, 512);
+
+	boxes.nrects = 0;
+	benchAddGlyphBoxes(&boxes, vg, data->fontNormal, 33, 126, emojiSizes, 5, 2, &seed);
+	benchAddGlyphBoxes(&boxes, vg, data->fontNormal, 33, 126, emojiSizes, 5, 4, &seed);
+	benchPack("blur", &boxes, 512, 512);
+
+	free(boxes.rects);
+}
+
+int main(int argc, char** argv)
+{
+	BenchBackend bb;
+	DemoData data;
+	NVGcontext* vg;
+	unsigned char* pixels = NULL;
+	int nframes = 200, threaded = 0, cold = 0, glyphs = 0, atlas = 0, sw = 0, nthreads = 0, i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i+1 < argc) {
+			nframes = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0) {
+			threaded = 1;
+		} else if (strcmp(argv[i], "-c") == 0) {
+			cold = 1;
+		} else if (strcmp(argv[i], "-g") == 0) {
+			glyphs = 1;
+		} else if (strcmp(argv[i], "-s") == 0 && i+1 < argc) {
+			sw = 1;
+			nthreads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-a") == 0) {
+			atlas = 1;
+		} else {
+			printf("usage: %s [-n frames] [-t] [-c] [-g] [-s threads] [-a]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (nframes < 1) nframes = 1;
+
+	memset(&bb, 0, sizeof(bb));
+	if (sw) {
+		pixels = (unsigned char*)malloc((size_t)BENCH_WIDTH * (size_t)BENCH_HEIGHT * 4);
+		vg = pixels != NULL ? nvgCreateSW(NVG_ANTIALIAS | NVG_STENCIL_STROKES | (threaded ? NVG_THREADED_TESSELLATION : 0), nthreads) : NULL;
+		glyphs = 1;
+	} else {
+		vg = benchCreate(&bb, threaded, glyphs);
+	}
+	if (vg == NULL) {
+		printf("Could not init nanovg.\n");
+		free(pixels);
+		return 1;
+	}
+	if (loadDemoData(vg, &data) == -1) {
+		nvgDeleteInternal(vg);
+		free(pixels);
+		return 1;
+	}
+
+	if (atlas) {
+		benchAtlas(vg, &data);
+		freeDemoData(vg, &data);
+		nvgDeleteInternal(vg);
+		free(pixels);
+		return 0;
+	}
+
+	printf("%d frames, %s back-end, %s tessellation, %s glyph cache, text as %s, ns/frame\n", nframes,
+		   sw ? "software" : "null", threaded ? "threaded" : "inline", cold ? "cold" : "warm", glyphs ? "glyphs" : "triangles");
+	printf("%-12s %10s %10s %10s %10s %10s %10s %10s%s\n",
+		   "scene", "total", "record", "flatten", "joins", "expand", "text", "glyphs", sw ? " pixels" : "");
+	for (i = 0; i < (int)(sizeof(benchScenes) / sizeof(benchScenes[0])); i++)
+		benchRun(vg, &benchScenes[i], &data, nframes, cold, pixels);
+
+	freeDemoData(vg, &data);
+	nvgDeleteInternal(vg);
+	free(pixels);
+
+	// Print the checksum so the consumed geometry stays live.
+	if (!sw)
+		printf("checksum %g\n", bb.checksum);
+	return 0;
+}
@@ -107,6 +107,11 @@ fragment half4 fragment_main(VertexOut in [[stage_in]],
                 color = half4(color.rgb * color.a, color.a);
             } else if (uniforms.texType == 2) {
                 color = half4(color.r);
+            } else if (uniforms.texType == 3) {
+                // Distance field, soften the edge over a pixel plus the blur.
+                float d = color.r;
+                float w = 0.5f * fwidth(d) + uniforms.feather;
+                color = half4(smoothstep(0.5f - w, 0.5f + w, d));
             }
             color *= scissor;
             result = color * (half4)uniforms.innerCol;
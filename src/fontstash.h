@@ -24,6 +24,12 @@
 enum FONSflags {
 	FONS_ZERO_TOPLEFT = 1,
 	FONS_ZERO_BOTTOMLEFT = 2,
+	// Glyphs are rasterized once as signed distance fields at FONS_SDF_SIZE, with the edge
+	// at 128, and scaled to the requested size. Blur is left to the renderer.
+	FONS_SDF = 4,
+	// Glyph bitmaps are queued when their atlas space is reserved and rasterized later by
+	// fonsRasterizePendingGlyph(), possibly on several threads. Ignored with FreeType.
+	FONS_DEFER_GLYPHS = 8,
 };
 
 enum FONSalign {
@@ -57,6 +63,8 @@ enum FONSerrorCode {
 struct FONSparams {
 	int width, height;
 	unsigned char flags;
+	// Number of atlas pages the stash may use, 0 means one. The render callbacks only see the first page.
+	int maxPages;
 	void* userPtr;
 	int (*renderCreate)(void* uptr, int width, int height);
 	int (*renderResize)(void* uptr, int width, int height);
@@ -70,11 +78,29 @@ struct FONSquad
 {
 	float x0,y0,s0,t0;
 	float x1,y1,s1,t1;
+	int page;
 };
 typedef struct FONSquad FONSquad;
 
+enum FONSshapeType {
+	FONS_SHAPE_MOVE = 1,
+	FONS_SHAPE_LINE = 2,
+	FONS_SHAPE_QUAD = 3,
+	FONS_SHAPE_CUBIC = 4,
+};
+
+// Outline vertex of a glyph, in font units with y up.
+struct FONSshapeVertex {
+	float x, y;			// End point.
+	float cx0, cy0;		// Control point of quadratic curves, first control point of cubic curves.
+	float cx1, cy1;		// Second control point of cubic curves.
+	int type;
+};
+typedef struct FONSshapeVertex FONSshapeVertex;
+
 struct FONStextIter {
 	float x, y, nextx, nexty, scale, spacing;
+	float glyphx;		// Pen position of the current glyph after kerning.
 	unsigned int codepoint;
 	short isize, iblur;
 	struct FONSfont* font;
@@ -100,8 +126,27 @@ void fonsGetAtlasSize(FONScontext* s, int* width, int* height);
 int fonsExpandAtlas(FONScontext* s, int width, int height);
 // Resets the whole stash.
 int fonsResetAtlas(FONScontext* stash, int width, int height);
+// Saves the glyph table and atlas pages to a file, so that a later run with the same fonts can
+// restore them instead of rasterizing the glyphs again. Returns 1 on success.
+int fonsSaveCache(FONScontext* s, const char* path);
+// Restores the atlas saved by fonsSaveCache(), replacing the current one. Glyphs are restored only
+// for fonts whose data and fallbacks are unchanged, so call it after adding the fonts. Returns the
+// number of glyphs restored, 0 if the file is missing or was saved by another version or settings.
+int fonsLoadCache(FONScontext* s, const char* path);
+// Returns the number of glyphs rasterized since the stash was created.
+int fonsGetRasterizedGlyphCount(FONScontext* s);
+// Starts a new frame. When all atlas pages are full, the band of glyphs used least
+// recently is evicted, but never one holding glyphs used since the last call.
+void fonsAdvanceFrame(FONScontext* s);
+// Returns a counter that changes whenever cached glyphs move or leave the atlas, so quads
+// kept from earlier calls are only valid while it stays the same.
+int fonsGetAtlasGeneration(FONScontext* s);
+// Marks the glyph of a kept quad as used this frame, as looking it up again would.
+void fonsTouchQuad(FONScontext* s, const FONSquad* q);
 
 // Add fonts
+// Font files are memory mapped and parsed once per process, stashes that add the same
+// path and index share them until the last of them is deleted.
 int fonsAddFont(FONScontext* s, const char* name, const char* path, int fontIndex);
 int fonsAddFontMem(FONScontext* s, const char* name, unsigned char* data, int ndata, int freeData, int fontIndex);
 int fonsGetFontByName(FONScontext* s, const char* name);
@@ -130,10 +175,34 @@ void fonsVertMetrics(FONScontext* s, float* ascender, float* descender, float* l
 // Text iterator
 int fonsTextIterInit(FONScontext* stash, FONStextIter* iter, float x, float y, const char* str, const char* end, int bitmapOption);
 int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, struct FONSquad* quad);
+// Returns id of the font the current glyph of the iterator comes from, which may be a fallback
+// of the iterated font, and stores the glyph index and the scale from font units to pixels.
+// Returns FONS_INVALID if there is no current glyph.
+int fonsTextIterGlyph(FONScontext* stash, FONStextIter* iter, int* glyph, float* scale);
+
+// Glyph outlines
+// Returns number of vertices in the outline of the glyph and stores them in verts, 0 if the glyph
+// has no outline. The vertices are freed with fonsFreeGlyphShape().
+int fonsGetGlyphShape(FONScontext* stash, int font, int glyph, FONSshapeVertex** verts);
+void fonsFreeGlyphShape(FONScontext* stash, FONSshapeVertex* verts);
 
 // Pull texture changes
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height);
 int fonsValidateTexture(FONScontext* s, int* dirty);
+// Same as above for each atlas page, the calls above operate on the first page.
+int fonsGetPageCount(FONScontext* s);
+const unsigned char* fonsGetPageData(FONScontext* s, int page, int* width, int* height);
+int fonsValidatePage(FONScontext* s, int page, int* dirty);
+
+// Deferred glyph rasterization (FONS_DEFER_GLYPHS). Pending glyphs may be rasterized in any order
+// and concurrently, each thread passing its own worker index below FONS_MAX_SCRATCH. Clear them
+// once all are done and before the texture data is read.
+int fonsGetPendingGlyphCount(FONScontext* s);
+void fonsRasterizePendingGlyph(FONScontext* s, int glyph, int worker);
+void fonsClearPendingGlyphs(FONScontext* s);
+// Reserves and rasterizes the glyph of the codepoint at the current font, size and blur.
+// Returns 1 if the glyph was added, 0 if it was already cached or no font has it, -1 if the atlas is full.
+int fonsPrewarmGlyph(FONScontext* s, unsigned int codepoint);
 
 // Draws the stash texture for debugging
 void fonsDrawDebug(FONScontext* s, float x, float y);
@@ -145,11 +214,33 @@ void fonsDrawDebug(FONScontext* s, float x, float y);
 
 #define FONS_NOTUSED(v)  (void)sizeof(v)
 
+#ifndef FONS_MALLOC
+#	define FONS_MALLOC(sz) malloc(sz)
+#	define FONS_REALLOC(p, sz) realloc(p, sz)
+#	define FONS_FREE(p) free(p)
+#endif
+
+// Fonts added from files are memory mapped and shared by all stashes of the process.
+// Define FONS_NO_SHARED_FONTS to read them into each stash instead, and FONS_NO_THREADS
+// when stashes are only used from one thread.
+#ifdef _WIN32
+#	define FONS_NO_SHARED_FONTS
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+#if !defined(FONS_NO_SHARED_FONTS) && !defined(FONS_NO_THREADS)
+#	include <pthread.h>
+#endif
+
 #ifdef FONS_USE_FREETYPE
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_ADVANCES_H
+#include FT_OUTLINE_H
 #include <math.h>
 
 struct FONSttFontImpl {
@@ -185,6 +276,33 @@ int fons__tt_loadFont(FONScontext *context, FONSttFontImpl *font, unsigned char
 	return ftError == 0;
 }
 
+// FreeType faces can not be used from several threads, each stash opens its own.
+int fons__tt_loadSharedFont(FONSttFontImpl *shared, unsigned char *data, int dataSize, int fontIndex)
+{
+	FONS_NOTUSED(dataSize);
+	FONS_NOTUSED(fontIndex);
+	shared->font = NULL;
+	return data != NULL;
+}
+
+int fons__tt_copyFont(FONScontext *context, FONSttFontImpl *font, const FONSttFontImpl *shared,
+					  unsigned char *data, int dataSize, int fontIndex)
+{
+	FONS_NOTUSED(shared);
+	return fons__tt_loadFont(context, font, data, dataSize, fontIndex);
+}
+
+void fons__tt_setScratch(FONSttFontImpl *font, void *scratch)
+{
+	FONS_NOTUSED(font);
+	FONS_NOTUSED(scratch);
+}
+
+void fons__tt_freeFont(FONSttFontImpl *font)
+{
+	FONS_NOTUSED(font);
+}
+
 void fons__tt_getFontVMetrics(FONSttFontImpl *font, int *ascent, int *descent, int *lineGap)
 {
 	*ascent = font->font->ascender;
@@ -245,6 +363,101 @@ void fons__tt_renderGlyphBitmap(FONSttFontImpl *font, unsigned char *output, int
 	}
 }
 
+int fons__tt_renderGlyphSDF(FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight, int outStride,
+							float scale, int padding, int glyph)
+{
+	// Not supported, the caller falls back to the coverage bitmap.
+	FONS_NOTUSED(font);
+	FONS_NOTUSED(output);
+	FONS_NOTUSED(outWidth);
+	FONS_NOTUSED(outHeight);
+	FONS_NOTUSED(outStride);
+	FONS_NOTUSED(scale);
+	FONS_NOTUSED(padding);
+	FONS_NOTUSED(glyph);
+	return 0;
+}
+
+struct FONSshapeBuilder {
+	FONSshapeVertex* verts;
+	int nverts;
+	int cverts;
+};
+typedef struct FONSshapeBuilder FONSshapeBuilder;
+
+static FONSshapeVertex* fons__ft_addVertex(FONSshapeBuilder* b, int type, const FT_Vector* to)
+{
+	FONSshapeVertex* v;
+	if (b->nverts+1 > b->cverts) {
+		int cverts = b->nverts+1 + b->cverts/2 + 16;
+		FONSshapeVertex* verts = (FONSshapeVertex*)FONS_REALLOC(b->verts, sizeof(FONSshapeVertex) * cverts);
+		if (verts == NULL) return NULL;
+		b->verts = verts;
+		b->cverts = cverts;
+	}
+	v = &b->verts[b->nverts++];
+	memset(v, 0, sizeof(*v));
+	v->type = type;
+	v->x = (float)to->x;
+	v->y = (float)to->y;
+	return v;
+}
+
+static int fons__ft_moveTo(const FT_Vector* to, void* user)
+{
+	return fons__ft_addVertex((FONSshapeBuilder*)user, FONS_SHAPE_MOVE, to) == NULL;
+}
+
+static int fons__ft_lineTo(const FT_Vector* to, void* user)
+{
+	return fons__ft_addVertex((FONSshapeBuilder*)user, FONS_SHAPE_LINE, to) == NULL;
+}
+
+static int fons__ft_conicTo(const FT_Vector* control, const FT_Vector* to, void* user)
+{
+	FONSshapeVertex* v = fons__ft_addVertex((FONSshapeBuilder*)user, FONS_SHAPE_QUAD, to);
+	if (v == NULL) return 1;
+	v->cx0 = (float)control->x;
+	v->cy0 = (float)control->y;
+	return 0;
+}
+
+static int fons__ft_cubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
+{
+	FONSshapeVertex* v = fons__ft_addVertex((FONSshapeBuilder*)user, FONS_SHAPE_CUBIC, to);
+	if (v == NULL) return 1;
+	v->cx0 = (float)control1->x;
+	v->cy0 = (float)control1->y;
+	v->cx1 = (float)control2->x;
+	v->cy1 = (float)control2->y;
+	return 0;
+}
+
+int fons__tt_getGlyphShape(FONSttFontImpl *font, int glyph, FONSshapeVertex** verts)
+{
+	FT_Outline_Funcs funcs;
+	FONSshapeBuilder b;
+
+	*verts = NULL;
+	if (FT_Load_Glyph(font->font, glyph, FT_LOAD_NO_SCALE | FT_LOAD_NO_BITMAP) != 0)
+		return 0;
+	if (font->font->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
+		return 0;
+
+	memset(&funcs, 0, sizeof(funcs));
+	funcs.move_to = fons__ft_moveTo;
+	funcs.line_to = fons__ft_lineTo;
+	funcs.conic_to = fons__ft_conicTo;
+	funcs.cubic_to = fons__ft_cubicTo;
+	memset(&b, 0, sizeof(b));
+	if (FT_Outline_Decompose(&font->font->glyph->outline, &funcs, &b) != 0) {
+		FONS_FREE(b.verts);
+		return 0;
+	}
+	*verts = b.verts;
+	return b.nverts;
+}
+
 int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 {
 	FT_Vector ftKerning;
@@ -261,8 +474,25 @@ static void fons__tmpfree(void* ptr, void* up);
 #define STBTT_free(x,u)      fons__tmpfree(x,u)
 #include "stb_truetype.h"
 
+// Bytes of parsed glyph outlines kept per font, glyphs past it are parsed again on each use.
+#ifndef FONS_SHAPE_CACHE_SIZE
+#	define FONS_SHAPE_CACHE_SIZE (2*1024*1024)
+#endif
+
+// Outline of a glyph as parsed from the font, so that rasterizing it at another size only scales it.
+struct FONSttShape {
+	stbtt_vertex* verts;
+	int nverts;
+	int box[4];
+	unsigned char hasBox;
+	unsigned char cached;
+};
+typedef struct FONSttShape FONSttShape;
+
 struct FONSttFontImpl {
 	stbtt_fontinfo font;
+	FONSttShape* shapes;	// Indexed by glyph, allocated on first use.
+	int shapeBytes;
 };
 typedef struct FONSttFontImpl FONSttFontImpl;
 
@@ -281,9 +511,9 @@ int fons__tt_done(FONScontext *context)
 int fons__tt_loadFont(FONScontext *context, FONSttFontImpl *font, unsigned char *data, int dataSize, int fontIndex)
 {
 	int offset, stbError;
+	FONS_NOTUSED(context);
 	FONS_NOTUSED(dataSize);
 
-	font->font.userdata = context;
 	offset = stbtt_GetFontOffsetForIndex(data, fontIndex);
 	if (offset == -1) {
 		stbError = 0;
@@ -293,6 +523,81 @@ int fons__tt_loadFont(FONScontext *context, FONSttFontImpl *font, unsigned char
 	return stbError;
 }
 
+// Finds the tables of a font shared by several stashes, done once per process.
+int fons__tt_loadSharedFont(FONSttFontImpl *shared, unsigned char *data, int dataSize, int fontIndex)
+{
+	memset(shared, 0, sizeof(FONSttFontImpl));
+	return fons__tt_loadFont(NULL, shared, data, dataSize, fontIndex);
+}
+
+// The parsed font info only refers to the read-only font data, each stash takes a copy
+// with its own scratch buffer and outline cache.
+int fons__tt_copyFont(FONScontext *context, FONSttFontImpl *font, const FONSttFontImpl *shared,
+					  unsigned char *data, int dataSize, int fontIndex)
+{
+	FONS_NOTUSED(context);
+	FONS_NOTUSED(data);
+	FONS_NOTUSED(dataSize);
+	FONS_NOTUSED(fontIndex);
+	font->font = shared->font;
+	font->shapes = NULL;
+	font->shapeBytes = 0;
+	return 1;
+}
+
+// Points the rasterizer's temporary allocations at a scratch buffer.
+void fons__tt_setScratch(FONSttFontImpl *font, void *scratch)
+{
+	font->font.userdata = scratch;
+}
+
+void fons__tt_freeFont(FONSttFontImpl *font)
+{
+	int i;
+	if (font->shapes == NULL) return;
+	for (i = 0; i < font->font.numGlyphs; i++)
+		if (font->shapes[i].verts) FONS_FREE(font->shapes[i].verts);
+	FONS_FREE(font->shapes);
+	font->shapes = NULL;
+}
+
+// Returns the cached outline of the glyph, parsing it on first use. Returns NULL when
+// the cache is full, the caller then parses the glyph itself. Only the calling thread
+// adds outlines, the rasterizer threads read them.
+static FONSttShape* fons__tt_getShape(FONSttFontImpl *font, int glyph)
+{
+	FONSttShape* shape;
+	stbtt_vertex* verts = NULL;
+	int n;
+
+	if (glyph < 0 || glyph >= font->font.numGlyphs)
+		return NULL;
+	if (font->shapes == NULL) {
+		font->shapes = (FONSttShape*)FONS_MALLOC(sizeof(FONSttShape) * font->font.numGlyphs);
+		if (font->shapes == NULL) return NULL;
+		memset(font->shapes, 0, sizeof(FONSttShape) * font->font.numGlyphs);
+	}
+	shape = &font->shapes[glyph];
+	if (shape->cached)
+		return shape;
+	if (font->shapeBytes >= FONS_SHAPE_CACHE_SIZE)
+		return NULL;
+
+	// The parser allocates from the scratch buffer, the outline is moved to the heap.
+	n = stbtt_GetGlyphShape(&font->font, glyph, &verts);
+	if (n > 0 && verts != NULL) {
+		shape->verts = (stbtt_vertex*)FONS_MALLOC(sizeof(stbtt_vertex) * n);
+		if (shape->verts == NULL) return NULL;
+		memcpy(shape->verts, verts, sizeof(stbtt_vertex) * n);
+		shape->nverts = n;
+		font->shapeBytes += (int)sizeof(stbtt_vertex) * n;
+	}
+	stbtt_FreeShape(&font->font, verts);
+	shape->hasBox = (unsigned char)stbtt_GetGlyphBox(&font->font, glyph, &shape->box[0], &shape->box[1], &shape->box[2], &shape->box[3]);
+	shape->cached = 1;
+	return shape;
+}
+
 void fons__tt_getFontVMetrics(FONSttFontImpl *font, int *ascent, int *descent, int *lineGap)
 {
 	stbtt_GetFontVMetrics(&font->font, ascent, descent, lineGap);
@@ -311,16 +616,92 @@ int fons__tt_getGlyphIndex(FONSttFontImpl *font, int codepoint)
 int fons__tt_buildGlyphBitmap(FONSttFontImpl *font, int glyph, float size, float scale,
 							  int *advance, int *lsb, int *x0, int *y0, int *x1, int *y1)
 {
+	FONSttShape* shape = fons__tt_getShape(font, glyph);
 	FONS_NOTUSED(size);
 	stbtt_GetGlyphHMetrics(&font->font, glyph, advance, lsb);
-	stbtt_GetGlyphBitmapBox(&font->font, glyph, scale, scale, x0, y0, x1, y1);
+	if (shape == NULL) {
+		stbtt_GetGlyphBitmapBox(&font->font, glyph, scale, scale, x0, y0, x1, y1);
+	} else if (!shape->hasBox) {
+		*x0 = *y0 = *x1 = *y1 = 0;
+	} else {
+		// Same as stbtt_GetGlyphBitmapBox(), without looking the glyph up again.
+		*x0 = (int)floorf(shape->box[0] * scale);
+		*y0 = (int)floorf(-shape->box[3] * scale);
+		*x1 = (int)ceilf(shape->box[2] * scale);
+		*y1 = (int)ceilf(-shape->box[1] * scale);
+	}
 	return 1;
 }
 
 void fons__tt_renderGlyphBitmap(FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight, int outStride,
 								float scaleX, float scaleY, int glyph)
 {
-	stbtt_MakeGlyphBitmap(&font->font, output, outWidth, outHeight, outStride, scaleX, scaleY, glyph);
+	FONSttShape* shape = font->shapes != NULL && glyph >= 0 && glyph < font->font.numGlyphs ? &font->shapes[glyph] : NULL;
+	stbtt__bitmap gbm;
+
+	if (shape == NULL || !shape->cached) {
+		stbtt_MakeGlyphBitmap(&font->font, output, outWidth, outHeight, outStride, scaleX, scaleY, glyph);
+		return;
+	}
+	// Only scan-convert the cached outline, as stbtt_MakeGlyphBitmap() does after parsing it.
+	gbm.pixels = output;
+	gbm.w = outWidth;
+	gbm.h = outHeight;
+	gbm.stride = outStride;
+	if (gbm.w && gbm.h && shape->nverts > 0) {
+		int ix0 = shape->hasBox ? (int)floorf(shape->box[0] * scaleX) : 0;
+		int iy0 = shape->hasBox ? (int)floorf(-shape->box[3] * scaleY) : 0;
+		stbtt_Rasterize(&gbm, 0.35f, shape->verts, shape->nverts, scaleX, scaleY, 0.0f, 0.0f, ix0, iy0, 1, font->font.userdata);
+	}
+}
+
+int fons__tt_renderGlyphSDF(FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight, int outStride,
+							float scale, int padding, int glyph)
+{
+	int y, w, h, xoff, yoff;
+	unsigned char* sdf = stbtt_GetGlyphSDF(&font->font, scale, glyph, padding, 128, 128.0f / padding, &w, &h, &xoff, &yoff);
+	if (sdf == NULL)
+		return 0;
+	// The field covers the glyph bitmap box grown by the padding, same as the atlas rect.
+	for (y = 0; y < h && y < outHeight; y++)
+		memcpy(&output[y * outStride], &sdf[y * w], w < outWidth ? w : outWidth);
+	stbtt_FreeSDF(sdf, font->font.userdata);
+	return 1;
+}
+
+int fons__tt_getGlyphShape(FONSttFontImpl *font, int glyph, FONSshapeVertex** verts)
+{
+	FONSttShape* cached = fons__tt_getShape(font, glyph);
+	stbtt_vertex* shape = NULL;
+	int i, n;
+
+	if (cached != NULL) {
+		shape = cached->verts;
+		n = cached->nverts;
+	} else {
+		n = stbtt_GetGlyphShape(&font->font, glyph, &shape);
+	}
+	*verts = NULL;
+	if (n <= 0 || shape == NULL)
+		return 0;
+	*verts = (FONSshapeVertex*)FONS_MALLOC(sizeof(FONSshapeVertex) * n);
+	if (*verts != NULL) {
+		for (i = 0; i < n; i++) {
+			FONSshapeVertex* v = &(*verts)[i];
+			v->x = shape[i].x;
+			v->y = shape[i].y;
+			v->cx0 = shape[i].cx;
+			v->cy0 = shape[i].cy;
+			v->cx1 = shape[i].cx1;
+			v->cy1 = shape[i].cy1;
+			v->type = shape[i].type == STBTT_vmove ? FONS_SHAPE_MOVE :
+					  shape[i].type == STBTT_vline ? FONS_SHAPE_LINE :
+					  shape[i].type == STBTT_vcurve ? FONS_SHAPE_QUAD : FONS_SHAPE_CUBIC;
+		}
+	}
+	if (cached == NULL)
+		stbtt_FreeShape(&font->font, shape);
+	return *verts != NULL ? n : 0;
 }
 
 int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
@@ -333,9 +714,18 @@ int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 #ifndef FONS_SCRATCH_BUF_SIZE
 #	define FONS_SCRATCH_BUF_SIZE 96000
 #endif
+// Number of threads that can rasterize deferred glyphs at once, each with its own scratch buffer.
+#ifndef FONS_MAX_SCRATCH
+#	define FONS_MAX_SCRATCH 16
+#endif
+// Initial size of the per-font glyph hash table, must be a power of two.
 #ifndef FONS_HASH_LUT_SIZE
 #	define FONS_HASH_LUT_SIZE 256
 #endif
+// Number of sizes per font with a direct lookup for codepoints below 128.
+#ifndef FONS_ASCII_SIZES
+#	define FONS_ASCII_SIZES 4
+#endif
 #ifndef FONS_INIT_FONTS
 #	define FONS_INIT_FONTS 4
 #endif
@@ -345,9 +735,33 @@ int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 #ifndef FONS_INIT_ATLAS_NODES
 #	define FONS_INIT_ATLAS_NODES 256
 #endif
+#ifndef FONS_ATLAS_BANDS
+#	define FONS_ATLAS_BANDS 8
+#endif
+#ifndef FONS_MAX_PAGES
+#	define FONS_MAX_PAGES 4
+#endif
+// Version of the atlas cache files, bump it when the glyph bitmaps or the file layout change.
+#ifndef FONS_CACHE_VERSION
+#	define FONS_CACHE_VERSION 1
+#endif
+// Reference size and distance range (in pixels at that size) of FONS_SDF glyphs.
+#ifndef FONS_SDF_SIZE
+#	define FONS_SDF_SIZE 32
+#endif
+#ifndef FONS_SDF_PAD
+#	define FONS_SDF_PAD 8
+#endif
 #ifndef FONS_VERTEX_COUNT
 #	define FONS_VERTEX_COUNT 1024
 #endif
+// Optional hooks around glyph rasterization (e.g. for profiling).
+#ifndef FONS_GLYPH_RASTER_BEGIN
+#	define FONS_GLYPH_RASTER_BEGIN(stash)
+#endif
+#ifndef FONS_GLYPH_RASTER_END
+#	define FONS_GLYPH_RASTER_END(stash)
+#endif
 #ifndef FONS_MAX_STATES
 #	define FONS_MAX_STATES 20
 #endif
@@ -380,13 +794,44 @@ struct FONSglyph
 {
 	unsigned int codepoint;
 	int index;
-	int next;
 	short size, blur;
+	short page;
 	short x0,y0,x1,y1;
 	short xadv,xoff,yoff;
 };
 typedef struct FONSglyph FONSglyph;
 
+// Glyph indices of the codepoints below 128 at one size and blur, -1 if not cached.
+struct FONSasciiGlyphs
+{
+	short size, blur;
+	int glyphs[128];
+};
+typedef struct FONSasciiGlyphs FONSasciiGlyphs;
+
+// Glyph of a codepoint resolved through a font and its fallbacks.
+struct FONScodepoint
+{
+	unsigned int codepoint;
+	int index;				// Glyph index in font, 0 if no font has the codepoint.
+	struct FONSfont* font;	// NULL marks an empty slot.
+};
+typedef struct FONScodepoint FONScodepoint;
+
+// Font file mapped once per process and shared by the stashes that added it.
+struct FONSface
+{
+	char* path;
+	int fontIndex;
+	unsigned char* data;
+	int dataSize;
+	int mapped;
+	int refs;
+	FONSttFontImpl font;
+	struct FONSface* next;
+};
+typedef struct FONSface FONSface;
+
 struct FONSfont
 {
 	FONSttFontImpl font;
@@ -394,13 +839,22 @@ struct FONSfont
 	unsigned char* data;
 	int dataSize;
 	unsigned char freeData;
+	FONSface* face;
+	int fontIndex;
+	unsigned long long hash;	// Of the font data, 0 until computed.
 	float ascender;
 	float descender;
 	float lineh;
 	FONSglyph* glyphs;
 	int cglyphs;
 	int nglyphs;
-	int lut[FONS_HASH_LUT_SIZE];
+	int* lut;		// Open addressing table of glyph indices, -1 marks an empty slot.
+	int clut;
+	FONSasciiGlyphs ascii[FONS_ASCII_SIZES];
+	int nascii;
+	FONScodepoint* cmap;	// Open addressing table of resolved codepoints.
+	int ncmap;
+	int ccmap;
 	int fallbacks[FONS_MAX_FALLBACKS];
 	int nfallbacks;
 };
@@ -422,31 +876,78 @@ struct FONSatlasNode {
 };
 typedef struct FONSatlasNode FONSatlasNode;
 
-struct FONSatlas
+// The atlas is split into horizontal bands, each packed by its own skyline,
+// so that space can be reclaimed one band at a time when the atlas is full.
+struct FONSatlasBand
 {
-	int width, height;
+	int y, height;
+	int lastUsed;
 	FONSatlasNode* nodes;
 	int nnodes;
 	int cnodes;
+	short failw, failh;	// A rect this size did not fit, nor does any that is not smaller.
+};
+typedef struct FONSatlasBand FONSatlasBand;
+
+struct FONSatlas
+{
+	int width, height;
+	int bandHeight;
+	FONSatlasBand* bands;
+	int nbands;
+	int cbands;
 };
 typedef struct FONSatlas FONSatlas;
 
+struct FONSpage
+{
+	unsigned char* texData;
+	int dirtyRect[4];
+	FONSatlas* atlas;
+};
+typedef struct FONSpage FONSpage;
+
+// Per-thread scratch memory for the rasterizer.
+struct FONSscratch
+{
+	struct FONScontext* stash;
+	unsigned char* data;
+	int n;
+};
+typedef struct FONSscratch FONSscratch;
+
+// Glyph bitmap waiting to be rasterized into its reserved atlas rect.
+struct FONSglyphJob
+{
+	FONSfont* font;		// Font that has the glyph, may be a fallback.
+	int index;
+	float scale;
+	short page;
+	short x, y, w, h;
+	short pad, blur;
+};
+typedef struct FONSglyphJob FONSglyphJob;
+
 struct FONScontext
 {
 	FONSparams params;
 	float itw,ith;
-	unsigned char* texData;
-	int dirtyRect[4];
+	FONSpage pages[FONS_MAX_PAGES];
+	int npages;
 	FONSfont** fonts;
-	FONSatlas* atlas;
 	int cfonts;
 	int nfonts;
 	float verts[FONS_VERTEX_COUNT*2];
 	float tcoords[FONS_VERTEX_COUNT*2];
 	unsigned int colors[FONS_VERTEX_COUNT];
 	int nverts;
-	unsigned char* scratch;
-	int nscratch;
+	FONSscratch scratch[FONS_MAX_SCRATCH];	// The first one is used by the calling thread.
+	FONSglyphJob* jobs;
+	int njobs;
+	int cjobs;
+	int nrasterized;
+	int frame;
+	int generation;
 	FONSstate states[FONS_MAX_STATES];
 	int nstates;
 	void (*handleError)(void* uptr, int error, int val);
@@ -458,18 +959,19 @@ struct FONScontext
 static void* fons__tmpalloc(size_t size, void* up)
 {
 	unsigned char* ptr;
-	FONScontext* stash = (FONScontext*)up;
+	FONSscratch* scratch = (FONSscratch*)up;
+	FONScontext* stash = scratch->stash;
 
 	// 16-byte align the returned pointer
 	size = (size + 0xf) & ~0xf;
 
-	if (stash->nscratch+(int)size > FONS_SCRATCH_BUF_SIZE) {
+	if (scratch->n+(int)size > FONS_SCRATCH_BUF_SIZE) {
 		if (stash->handleError)
-			stash->handleError(stash->errorUptr, FONS_SCRATCH_FULL, stash->nscratch+(int)size);
+			stash->handleError(stash->errorUptr, FONS_SCRATCH_FULL, scratch->n+(int)size);
 		return NULL;
 	}
-	ptr = stash->scratch + stash->nscratch;
-	stash->nscratch += (int)size;
+	ptr = scratch->data + scratch->n;
+	scratch->n += (int)size;
 	return ptr;
 }
 
@@ -525,35 +1027,83 @@ static unsigned int fons__decutf8(unsigned int* state, unsigned int* codep, unsi
 
 static void fons__deleteAtlas(FONSatlas* atlas)
 {
+	int i;
 	if (atlas == NULL) return;
-	if (atlas->nodes != NULL) free(atlas->nodes);
-	free(atlas);
+	for (i = 0; i < atlas->cbands; i++) {
+		if (atlas->bands[i].nodes != NULL) FONS_FREE(atlas->bands[i].nodes);
+	}
+	if (atlas->bands != NULL) FONS_FREE(atlas->bands);
+	FONS_FREE(atlas);
 }
 
-static FONSatlas* fons__allocAtlas(int w, int h, int nnodes)
+static void fons__atlasResetBand(FONSatlasBand* band, int w)
+{
+	// Init root node.
+	band->nodes[0].x = 0;
+	band->nodes[0].y = 0;
+	band->nodes[0].width = (short)w;
+	band->nnodes = 1;
+	band->lastUsed = -1;	// Never used, so it can be merged even in the first frame.
+	band->failw = 0x7fff;
+	band->failh = 0x7fff;
+}
+
+static int fons__atlasAddBands(FONSatlas* atlas)
+{
+	FONSatlasBand* band;
+	int y = 0;
+
+	// Grow the last band if it was cut short by the atlas height.
+	if (atlas->nbands > 0) {
+		band = &atlas->bands[atlas->nbands-1];
+		band->height = fons__mini(atlas->bandHeight, atlas->height - band->y);
+		band->failw = band->failh = 0x7fff;
+		y = band->y + band->height;
+	}
+
+	// Split the remaining space into new bands.
+	while (y < atlas->height) {
+		if (atlas->nbands+1 > atlas->cbands) {
+			int cbands = atlas->cbands == 0 ? FONS_ATLAS_BANDS : atlas->cbands * 2;
+			FONSatlasBand* bands = (FONSatlasBand*)FONS_REALLOC(atlas->bands, sizeof(FONSatlasBand) * cbands);
+			if (bands == NULL)
+				return 0;
+			memset(&bands[atlas->cbands], 0, sizeof(FONSatlasBand) * (cbands - atlas->cbands));
+			atlas->bands = bands;
+			atlas->cbands = cbands;
+		}
+		band = &atlas->bands[atlas->nbands];
+		if (band->nodes == NULL) {
+			band->nodes = (FONSatlasNode*)FONS_MALLOC(sizeof(FONSatlasNode) * FONS_INIT_ATLAS_NODES);
+			if (band->nodes == NULL)
+				return 0;
+			band->cnodes = FONS_INIT_ATLAS_NODES;
+		}
+		band->y = y;
+		band->height = fons__mini(atlas->bandHeight, atlas->height - y);
+		fons__atlasResetBand(band, atlas->width);
+		atlas->nbands++;
+		y += band->height;
+	}
+
+	return 1;
+}
+
+static FONSatlas* fons__allocAtlas(int w, int h)
 {
 	FONSatlas* atlas = NULL;
 
 	// Allocate memory for the font stash.
-	atlas = (FONSatlas*)malloc(sizeof(FONSatlas));
+	atlas = (FONSatlas*)FONS_MALLOC(sizeof(FONSatlas));
 	if (atlas == NULL) goto error;
 	memset(atlas, 0, sizeof(FONSatlas));
 
 	atlas->width = w;
 	atlas->height = h;
+	atlas->bandHeight = fons__maxi(1, h / FONS_ATLAS_BANDS);
 
-	// Allocate space for skyline nodes
-	atlas->nodes = (FONSatlasNode*)malloc(sizeof(FONSatlasNode) * nnodes);
-	if (atlas->nodes == NULL) goto error;
-	memset(atlas->nodes, 0, sizeof(FONSatlasNode) * nnodes);
-	atlas->nnodes = 0;
-	atlas->cnodes = nnodes;
-
-	// Init root node.
-	atlas->nodes[0].x = 0;
-	atlas->nodes[0].y = 0;
-	atlas->nodes[0].width = (short)w;
-	atlas->nnodes++;
+	// Allocate bands and their skyline nodes.
+	if (fons__atlasAddBands(atlas) == 0) goto error;
 
 	return atlas;
 
@@ -562,73 +1112,81 @@ error:
 	return NULL;
 }
 
-static int fons__atlasInsertNode(FONSatlas* atlas, int idx, int x, int y, int w)
+static int fons__atlasInsertNode(FONSatlasBand* band, int idx, int x, int y, int w)
 {
 	int i;
 	// Insert node
-	if (atlas->nnodes+1 > atlas->cnodes) {
-		atlas->cnodes = atlas->cnodes == 0 ? 8 : atlas->cnodes * 2;
-		atlas->nodes = (FONSatlasNode*)realloc(atlas->nodes, sizeof(FONSatlasNode) * atlas->cnodes);
-		if (atlas->nodes == NULL)
+	if (band->nnodes+1 > band->cnodes) {
+		band->cnodes = band->cnodes == 0 ? 8 : band->cnodes * 2;
+		band->nodes = (FONSatlasNode*)FONS_REALLOC(band->nodes, sizeof(FONSatlasNode) * band->cnodes);
+		if (band->nodes == NULL)
 			return 0;
 	}
-	for (i = atlas->nnodes; i > idx; i--)
-		atlas->nodes[i] = atlas->nodes[i-1];
-	atlas->nodes[idx].x = (short)x;
-	atlas->nodes[idx].y = (short)y;
-	atlas->nodes[idx].width = (short)w;
-	atlas->nnodes++;
+	for (i = band->nnodes; i > idx; i--)
+		band->nodes[i] = band->nodes[i-1];
+	band->nodes[idx].x = (short)x;
+	band->nodes[idx].y = (short)y;
+	band->nodes[idx].width = (short)w;
+	band->nnodes++;
 
 	return 1;
 }
 
-static void fons__atlasRemoveNode(FONSatlas* atlas, int idx)
+static void fons__atlasRemoveNode(FONSatlasBand* band, int idx)
 {
 	int i;
-	if (atlas->nnodes == 0) return;
-	for (i = idx; i < atlas->nnodes-1; i++)
-		atlas->nodes[i] = atlas->nodes[i+1];
-	atlas->nnodes--;
+	if (band->nnodes == 0) return;
+	for (i = idx; i < band->nnodes-1; i++)
+		band->nodes[i] = band->nodes[i+1];
+	band->nnodes--;
 }
 
 static void fons__atlasExpand(FONSatlas* atlas, int w, int h)
 {
+	int i;
 	// Insert node for empty space
-	if (w > atlas->width)
-		fons__atlasInsertNode(atlas, atlas->nnodes, atlas->width, 0, w - atlas->width);
+	if (w > atlas->width) {
+		for (i = 0; i < atlas->nbands; i++) {
+			FONSatlasBand* band = &atlas->bands[i];
+			FONSatlasNode* last = &band->nodes[band->nnodes-1];
+			// Keep same height neighbours merged, packing only merges next to new segments.
+			if (last->y == 0)
+				last->width = (short)(last->width + w - atlas->width);
+			else
+				fons__atlasInsertNode(band, band->nnodes, atlas->width, 0, w - atlas->width);
+			band->failw = band->failh = 0x7fff;
+		}
+	}
 	atlas->width = w;
 	atlas->height = h;
+	fons__atlasAddBands(atlas);
 }
 
-static void fons__atlasReset(FONSatlas* atlas, int w, int h)
+static int fons__atlasReset(FONSatlas* atlas, int w, int h)
 {
 	atlas->width = w;
 	atlas->height = h;
-	atlas->nnodes = 0;
-
-	// Init root node.
-	atlas->nodes[0].x = 0;
-	atlas->nodes[0].y = 0;
-	atlas->nodes[0].width = (short)w;
-	atlas->nnodes++;
+	atlas->bandHeight = fons__maxi(1, h / FONS_ATLAS_BANDS);
+	atlas->nbands = 0;
+	return fons__atlasAddBands(atlas);
 }
 
-static int fons__atlasAddSkylineLevel(FONSatlas* atlas, int idx, int x, int y, int w, int h)
+static int fons__atlasAddSkylineLevel(FONSatlasBand* band, int idx, int x, int y, int w, int h)
 {
 	int i;
 
 	// Insert new node
-	if (fons__atlasInsertNode(atlas, idx, x, y+h, w) == 0)
+	if (fons__atlasInsertNode(band, idx, x, y+h, w) == 0)
 		return 0;
 
 	// Delete skyline segments that fall under the shadow of the new segment.
-	for (i = idx+1; i < atlas->nnodes; i++) {
-		if (atlas->nodes[i].x < atlas->nodes[i-1].x + atlas->nodes[i-1].width) {
-			int shrink = atlas->nodes[i-1].x + atlas->nodes[i-1].width - atlas->nodes[i].x;
-			atlas->nodes[i].x += (short)shrink;
-			atlas->nodes[i].width -= (short)shrink;
-			if (atlas->nodes[i].width <= 0) {
-				fons__atlasRemoveNode(atlas, i);
+	for (i = idx+1; i < band->nnodes; i++) {
+		if (band->nodes[i].x < band->nodes[i-1].x + band->nodes[i-1].width) {
+			int shrink = band->nodes[i-1].x + band->nodes[i-1].width - band->nodes[i].x;
+			band->nodes[i].x += (short)shrink;
+			band->nodes[i].width -= (short)shrink;
+			if (band->nodes[i].width <= 0) {
+				fons__atlasRemoveNode(band, i);
 				i--;
 			} else {
 				break;
@@ -638,11 +1196,12 @@ static int fons__atlasAddSkylineLevel(FONSatlas* atlas, int idx, int x, int y, i
 		}
 	}
 
-	// Merge same height skyline segments that are next to each other.
-	for (i = 0; i < atlas->nnodes-1; i++) {
-		if (atlas->nodes[i].y == atlas->nodes[i+1].y) {
-			atlas->nodes[i].width += atlas->nodes[i+1].width;
-			fons__atlasRemoveNode(atlas, i+1);
+	// Merge same height skyline segments that are next to each other,
+	// only the new segment can have such neighbours.
+	for (i = fons__maxi(idx-1, 0); i <= idx && i < band->nnodes-1; i++) {
+		if (band->nodes[i].y == band->nodes[i+1].y) {
+			band->nodes[i].width += band->nodes[i+1].width;
+			fons__atlasRemoveNode(band, i+1);
 			i--;
 		}
 	}
@@ -650,22 +1209,22 @@ static int fons__atlasAddSkylineLevel(FONSatlas* atlas, int idx, int x, int y, i
 	return 1;
 }
 
-static int fons__atlasRectFits(FONSatlas* atlas, int i, int w, int h)
+static int fons__atlasRectFits(FONSatlas* atlas, FONSatlasBand* band, int i, int w, int h)
 {
 	// Checks if there is enough space at the location of skyline span 'i',
 	// and return the max height of all skyline spans under that at that location,
 	// (think tetris block being dropped at that position). Or -1 if no space found.
-	int x = atlas->nodes[i].x;
-	int y = atlas->nodes[i].y;
+	int x = band->nodes[i].x;
+	int y = band->nodes[i].y;
 	int spaceLeft;
 	if (x + w > atlas->width)
 		return -1;
 	spaceLeft = w;
 	while (spaceLeft > 0) {
-		if (i == atlas->nnodes) return -1;
-		y = fons__maxi(y, atlas->nodes[i].y);
-		if (y + h > atlas->height) return -1;
-		spaceLeft -= atlas->nodes[i].width;
+		if (i == band->nnodes) return -1;
+		y = fons__maxi(y, band->nodes[i].y);
+		if (y + h > band->height) return -1;
+		spaceLeft -= band->nodes[i].width;
 		++i;
 	}
 	return y;
@@ -673,71 +1232,245 @@ static int fons__atlasRectFits(FONSatlas* atlas, int i, int w, int h)
 
 static int fons__atlasAddRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry)
 {
+	FONSatlasBand* band = NULL;
 	int besth = atlas->height, bestw = atlas->width, besti = -1;
-	int bestx = -1, besty = -1, i;
-
-	// Bottom left fit heuristic.
-	for (i = 0; i < atlas->nnodes; i++) {
-		int y = fons__atlasRectFits(atlas, i, rw, rh);
-		if (y != -1) {
-			if (y + rh < besth || (y + rh == besth && atlas->nodes[i].width < bestw)) {
-				besti = i;
-				bestw = atlas->nodes[i].width;
-				besth = y + rh;
-				bestx = atlas->nodes[i].x;
-				besty = y;
+	int bestx = -1, besty = -1, i, j;
+
+	// Bottom left fit heuristic. Bands are stacked top to bottom, so any fit
+	// in a band beats every fit in the bands below it.
+	for (j = 0; j < atlas->nbands && besti == -1; j++) {
+		band = &atlas->bands[j];
+		if (rh > band->height)
+			continue;
+		// The skyline only rises, so a full band is skipped without scanning it.
+		if (rw >= band->failw && rh >= band->failh)
+			continue;
+		for (i = 0; i < band->nnodes; i++) {
+			int y = fons__atlasRectFits(atlas, band, i, rw, rh);
+			if (y != -1) {
+				if (y + rh < besth || (y + rh == besth && band->nodes[i].width < bestw)) {
+					besti = i;
+					bestw = band->nodes[i].width;
+					besth = y + rh;
+					bestx = band->nodes[i].x;
+					besty = y;
+				}
 			}
 		}
+		if (besti == -1 && rw * rh < band->failw * band->failh) {
+			band->failw = (short)rw;
+			band->failh = (short)rh;
+		}
 	}
 
 	if (besti == -1)
 		return 0;
 
 	// Perform the actual packing.
-	if (fons__atlasAddSkylineLevel(atlas, besti, bestx, besty, rw, rh) == 0)
+	if (fons__atlasAddSkylineLevel(band, besti, bestx, besty, rw, rh) == 0)
 		return 0;
 
 	*rx = bestx;
-	*ry = besty;
+	*ry = band->y + besty;
 
 	return 1;
 }
 
+static void fons__freePage(FONSpage* page)
+{
+	if (page->atlas) fons__deleteAtlas(page->atlas);
+	if (page->texData) FONS_FREE(page->texData);
+	memset(page, 0, sizeof(FONSpage));
+}
+
+static FONSpage* fons__addPage(FONScontext* stash)
+{
+	int maxPages = fons__mini(fons__maxi(stash->params.maxPages, 1), FONS_MAX_PAGES);
+	int w = stash->params.width, h = stash->params.height;
+	FONSpage* page;
+
+	if (stash->npages >= maxPages)
+		return NULL;
+	page = &stash->pages[stash->npages];
+
+	page->atlas = fons__allocAtlas(w, h);
+	if (page->atlas == NULL) goto error;
+	page->texData = (unsigned char*)FONS_MALLOC(w * h);
+	if (page->texData == NULL) goto error;
+	memset(page->texData, 0, w * h);
+
+	page->dirtyRect[0] = w;
+	page->dirtyRect[1] = h;
+	page->dirtyRect[2] = 0;
+	page->dirtyRect[3] = 0;
+
+	stash->npages++;
+	return page;
+
+error:
+	fons__freePage(page);
+	return NULL;
+}
+
 static void fons__addWhiteRect(FONScontext* stash, int w, int h)
 {
+	FONSpage* page = &stash->pages[0];
 	int x, y, gx, gy;
 	unsigned char* dst;
-	if (fons__atlasAddRect(stash->atlas, w, h, &gx, &gy) == 0)
+	if (fons__atlasAddRect(page->atlas, w, h, &gx, &gy) == 0)
 		return;
 
 	// Rasterize
-	dst = &stash->texData[gx + gy * stash->params.width];
+	dst = &page->texData[gx + gy * stash->params.width];
 	for (y = 0; y < h; y++) {
 		for (x = 0; x < w; x++)
 			dst[x] = 0xff;
 		dst += stash->params.width;
 	}
 
-	stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], gx);
-	stash->dirtyRect[1] = fons__mini(stash->dirtyRect[1], gy);
-	stash->dirtyRect[2] = fons__maxi(stash->dirtyRect[2], gx+w);
-	stash->dirtyRect[3] = fons__maxi(stash->dirtyRect[3], gy+h);
+	page->dirtyRect[0] = fons__mini(page->dirtyRect[0], gx);
+	page->dirtyRect[1] = fons__mini(page->dirtyRect[1], gy);
+	page->dirtyRect[2] = fons__maxi(page->dirtyRect[2], gx+w);
+	page->dirtyRect[3] = fons__maxi(page->dirtyRect[3], gy+h);
+}
+
+static FONSatlasBand* fons__atlasBandAt(FONSatlas* atlas, int y)
+{
+	// Bands are sorted top to bottom.
+	int lo = 0, hi = atlas->nbands-1;
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (atlas->bands[mid].y <= y)
+			lo = mid;
+		else
+			hi = mid-1;
+	}
+	return &atlas->bands[lo];
+}
+
+static void fons__touchGlyph(FONScontext* stash, FONSglyph* glyph)
+{
+	// Stamp the band holding the glyph so it is not evicted this frame.
+	fons__atlasBandAt(stash->pages[glyph->page].atlas, glyph->y0)->lastUsed = stash->frame;
+}
+
+static int fons__atlasEvict(FONScontext* stash, int h)
+{
+	FONSatlas* atlas;
+	FONSpage* page;
+	int i, j, p, y0, y1;
+	int best = -1, first = 0, count = 0, age = 0;
+
+	// Find the least recently used run of adjacent bands the rect fits in,
+	// usually a single band. Bands used during the current frame are skipped,
+	// pending draws still refer to them.
+	for (p = 0; p < stash->npages; p++) {
+		atlas = stash->pages[p].atlas;
+		for (i = 0; i < atlas->nbands; i++) {
+			int height = 0, lastUsed = -1;
+			for (j = i; j < atlas->nbands && height < h; j++) {
+				if (atlas->bands[j].lastUsed >= stash->frame)
+					break;
+				lastUsed = fons__maxi(lastUsed, atlas->bands[j].lastUsed);
+				height += atlas->bands[j].height;
+			}
+			if (height < h)
+				continue;
+			if (best == -1 || lastUsed < age || (lastUsed == age && j-i < count)) {
+				best = p;
+				first = i;
+				count = j-i;
+				age = lastUsed;
+			}
+		}
+	}
+	if (best == -1)
+		return -1;
+
+	page = &stash->pages[best];
+	atlas = page->atlas;
+	y0 = atlas->bands[first].y;
+	y1 = atlas->bands[first+count-1].y + atlas->bands[first+count-1].height;
+
+	// Drop the bitmaps of the glyphs in the run, they are rasterized again on next use.
+	stash->generation++;
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* font = stash->fonts[i];
+		for (j = 0; j < font->nglyphs; j++) {
+			FONSglyph* glyph = &font->glyphs[j];
+			if (glyph->page == best && glyph->y0 >= y0 && glyph->y0 < y1) {
+				glyph->x1 = (short)(glyph->x1 - glyph->x0 - 1);
+				glyph->y1 = (short)(glyph->y1 - glyph->y0 - 1);
+				glyph->x0 = -1;
+				glyph->y0 = -1;
+			}
+		}
+	}
+
+	// Clear the run, glyph padding relies on empty space around the bitmap.
+	memset(&page->texData[y0 * stash->params.width], 0, (y1 - y0) * stash->params.width);
+	page->dirtyRect[0] = 0;
+	page->dirtyRect[1] = fons__mini(page->dirtyRect[1], y0);
+	page->dirtyRect[2] = stash->params.width;
+	page->dirtyRect[3] = fons__maxi(page->dirtyRect[3], y1);
+
+	// Merge the run into its first band. The merged-away bands are parked
+	// past the end of the array so their nodes get reused.
+	for (i = 1; i < count; i++) {
+		FONSatlasBand band = atlas->bands[first+1];
+		for (j = first+1; j < atlas->nbands-1; j++)
+			atlas->bands[j] = atlas->bands[j+1];
+		atlas->bands[--atlas->nbands] = band;
+	}
+	atlas->bands[first].height = y1 - y0;
+	fons__atlasResetBand(&atlas->bands[first], atlas->width);
+
+	return best;
+}
+
+static int fons__allocRect(FONScontext* stash, int w, int h, int* page, int* x, int* y)
+{
+	int i;
+
+	if (w > stash->params.width || h > stash->params.height)
+		return 0;
+
+	// Try the existing pages first, then a new page, then evict old glyphs.
+	for (i = 0; i < stash->npages; i++) {
+		if (fons__atlasAddRect(stash->pages[i].atlas, w, h, x, y)) {
+			*page = i;
+			return 1;
+		}
+	}
+	if (fons__addPage(stash) != NULL) {
+		*page = stash->npages-1;
+		if (fons__atlasAddRect(stash->pages[*page].atlas, w, h, x, y))
+			return 1;
+		// Taller than a band, merge the empty bands of the new page.
+	}
+	*page = fons__atlasEvict(stash, h);
+	if (*page == -1)
+		return 0;
+	return fons__atlasAddRect(stash->pages[*page].atlas, w, h, x, y);
 }
 
 FONScontext* fonsCreateInternal(FONSparams* params)
 {
 	FONScontext* stash = NULL;
+	int i;
 
 	// Allocate memory for the font stash.
-	stash = (FONScontext*)malloc(sizeof(FONScontext));
+	stash = (FONScontext*)FONS_MALLOC(sizeof(FONScontext));
 	if (stash == NULL) goto error;
 	memset(stash, 0, sizeof(FONScontext));
 
 	stash->params = *params;
 
-	// Allocate scratch buffer.
-	stash->scratch = (unsigned char*)malloc(FONS_SCRATCH_BUF_SIZE);
-	if (stash->scratch == NULL) goto error;
+	// Allocate scratch buffer for the calling thread, the others are made on first use.
+	for (i = 0; i < FONS_MAX_SCRATCH; i++)
+		stash->scratch[i].stash = stash;
+	stash->scratch[0].data = (unsigned char*)FONS_MALLOC(FONS_SCRATCH_BUF_SIZE);
+	if (stash->scratch[0].data == NULL) goto error;
 
 	// Initialize implementation library
 	if (!fons__tt_init(stash)) goto error;
@@ -747,27 +1480,18 @@ FONScontext* fonsCreateInternal(FONSparams* params)
 			goto error;
 	}
 
-	stash->atlas = fons__allocAtlas(stash->params.width, stash->params.height, FONS_INIT_ATLAS_NODES);
-	if (stash->atlas == NULL) goto error;
 
 	// Allocate space for fonts.
-	stash->fonts = (FONSfont**)malloc(sizeof(FONSfont*) * FONS_INIT_FONTS);
+	stash->fonts = (FONSfont**)FONS_MALLOC(sizeof(FONSfont*) * FONS_INIT_FONTS);
 	if (stash->fonts == NULL) goto error;
 	memset(stash->fonts, 0, sizeof(FONSfont*) * FONS_INIT_FONTS);
 	stash->cfonts = FONS_INIT_FONTS;
 	stash->nfonts = 0;
 
-	// Create texture for the cache.
+	// Create the first page of the cache.
 	stash->itw = 1.0f/stash->params.width;
 	stash->ith = 1.0f/stash->params.height;
-	stash->texData = (unsigned char*)malloc(stash->params.width * stash->params.height);
-	if (stash->texData == NULL) goto error;
-	memset(stash->texData, 0, stash->params.width * stash->params.height);
-
-	stash->dirtyRect[0] = stash->params.width;
-	stash->dirtyRect[1] = stash->params.height;
-	stash->dirtyRect[2] = 0;
-	stash->dirtyRect[3] = 0;
+	if (fons__addPage(stash) == NULL) goto error;
 
 	// Add white rect at 0,0 for debug drawing.
 	fons__addWhiteRect(stash, 2,2);
@@ -787,11 +1511,171 @@ static FONSstate* fons__getState(FONScontext* stash)
 	return &stash->states[stash->nstates-1];
 }
 
+static unsigned int fons__hashGlyph(unsigned int codepoint, short isize, short iblur)
+{
+	return fons__hashint(codepoint ^ fons__hashint(((unsigned int)isize << 8) | (unsigned int)iblur));
+}
+
+static void fons__resetGlyphs(FONSfont* font)
+{
+	int i;
+	font->nglyphs = 0;
+	for (i = 0; i < font->clut; i++)
+		font->lut[i] = -1;
+	for (i = 0; i < FONS_ASCII_SIZES; i++)
+		font->ascii[i].size = 0;
+	font->nascii = 0;
+}
+
+static void fons__insertGlyph(FONSfont* font, int idx)
+{
+	FONSglyph* glyph = &font->glyphs[idx];
+	unsigned int mask = (unsigned int)font->clut-1;
+	unsigned int h = fons__hashGlyph(glyph->codepoint, glyph->size, glyph->blur) & mask;
+	while (font->lut[h] != -1)
+		h = (h+1) & mask;
+	font->lut[h] = idx;
+}
+
+// Keeps the hash table at most half full, so that probe runs stay short.
+static int fons__growGlyphLut(FONSfont* font)
+{
+	int i, clut;
+	int* lut;
+	if ((font->nglyphs+1)*2 <= font->clut) return 1;
+	clut = font->clut*2;
+	lut = (int*)FONS_MALLOC(sizeof(int) * clut);
+	if (lut == NULL) return 0;
+	FONS_FREE(font->lut);
+	font->lut = lut;
+	font->clut = clut;
+	for (i = 0; i < clut; i++)
+		lut[i] = -1;
+	for (i = 0; i < font->nglyphs; i++)
+		fons__insertGlyph(font, i);
+	return 1;
+}
+
+static int fons__findGlyph(FONSfont* font, unsigned int codepoint, short isize, short iblur)
+{
+	unsigned int mask = (unsigned int)font->clut-1;
+	unsigned int h = fons__hashGlyph(codepoint, isize, iblur) & mask;
+	int i;
+	while ((i = font->lut[h]) != -1) {
+		FONSglyph* glyph = &font->glyphs[i];
+		if (glyph->codepoint == codepoint && glyph->size == isize && glyph->blur == iblur)
+			return i;
+		h = (h+1) & mask;
+	}
+	return -1;
+}
+
+// Returns the direct lookup for codepoints below 128 at the size and blur,
+// reusing the oldest one when all are taken.
+static int* fons__asciiGlyphs(FONSfont* font, short isize, short iblur)
+{
+	FONSasciiGlyphs* ascii;
+	int i;
+	for (i = 0; i < FONS_ASCII_SIZES; i++) {
+		ascii = &font->ascii[i];
+		if (ascii->size == isize && ascii->blur == iblur)
+			return ascii->glyphs;
+	}
+	ascii = &font->ascii[font->nascii];
+	font->nascii = (font->nascii+1) % FONS_ASCII_SIZES;
+	ascii->size = isize;
+	ascii->blur = iblur;
+	for (i = 0; i < 128; i++)
+		ascii->glyphs[i] = -1;
+	return ascii->glyphs;
+}
+
+static void fons__resetCodepoints(FONSfont* font)
+{
+	int i;
+	font->ncmap = 0;
+	for (i = 0; i < font->ccmap; i++)
+		font->cmap[i].font = NULL;
+}
+
+static void fons__insertCodepoint(FONSfont* font, unsigned int codepoint, FONSfont* glyphFont, int index)
+{
+	unsigned int mask = (unsigned int)font->ccmap-1;
+	unsigned int h = fons__hashint(codepoint) & mask;
+	while (font->cmap[h].font != NULL)
+		h = (h+1) & mask;
+	font->cmap[h].codepoint = codepoint;
+	font->cmap[h].index = index;
+	font->cmap[h].font = glyphFont;
+	font->ncmap++;
+}
+
+static int fons__growCodepoints(FONSfont* font)
+{
+	FONScodepoint* old = font->cmap;
+	int i, n = font->ccmap;
+	font->cmap = (FONScodepoint*)FONS_MALLOC(sizeof(FONScodepoint) * n*2);
+	if (font->cmap == NULL) {
+		font->cmap = old;
+		return 0;
+	}
+	font->ccmap = n*2;
+	fons__resetCodepoints(font);
+	for (i = 0; i < n; i++) {
+		if (old[i].font != NULL)
+			fons__insertCodepoint(font, old[i].codepoint, old[i].font, old[i].index);
+	}
+	FONS_FREE(old);
+	return 1;
+}
+
+// Returns the glyph index of the codepoint and the font it was found in,
+// searching the fallback fonts when the font does not have it. Results are
+// remembered per font, including codepoints that no font has.
+static int fons__resolveCodepoint(FONScontext* stash, FONSfont* font, unsigned int codepoint, FONSfont** glyphFont)
+{
+	unsigned int mask = (unsigned int)font->ccmap-1;
+	unsigned int h = fons__hashint(codepoint) & mask;
+	int i, g;
+
+	while (font->cmap[h].font != NULL) {
+		if (font->cmap[h].codepoint == codepoint) {
+			*glyphFont = font->cmap[h].font;
+			return font->cmap[h].index;
+		}
+		h = (h+1) & mask;
+	}
+
+	*glyphFont = font;
+	g = fons__tt_getGlyphIndex(&font->font, codepoint);
+	// Try to find the glyph in fallback fonts.
+	if (g == 0) {
+		for (i = 0; i < font->nfallbacks; ++i) {
+			FONSfont* fallbackFont = stash->fonts[font->fallbacks[i]];
+			int fallbackIndex = fons__tt_getGlyphIndex(&fallbackFont->font, codepoint);
+			if (fallbackIndex != 0) {
+				g = fallbackIndex;
+				*glyphFont = fallbackFont;
+				break;
+			}
+		}
+		// It is possible that we did not find a fallback glyph.
+		// In that case the glyph index 'g' is 0, and the font's empty glyph is used.
+	}
+
+	// Keep the table at most half full.
+	if ((font->ncmap+1)*2 <= font->ccmap || fons__growCodepoints(font))
+		fons__insertCodepoint(font, codepoint, *glyphFont, g);
+	return g;
+}
+
 int fonsAddFallbackFont(FONScontext* stash, int base, int fallback)
 {
 	FONSfont* baseFont = stash->fonts[base];
 	if (baseFont->nfallbacks < FONS_MAX_FALLBACKS) {
 		baseFont->fallbacks[baseFont->nfallbacks++] = fallback;
+		fons__resetCodepoints(baseFont);
+		stash->generation++;
 		return 1;
 	}
 	return 0;
@@ -799,13 +1683,11 @@ int fonsAddFallbackFont(FONScontext* stash, int base, int fallback)
 
 void fonsResetFallbackFont(FONScontext* stash, int base)
 {
-	int i;
-
 	FONSfont* baseFont = stash->fonts[base];
 	baseFont->nfallbacks = 0;
-	baseFont->nglyphs = 0;
-	for (i = 0; i < FONS_HASH_LUT_SIZE; i++)
-		baseFont->lut[i] = -1;
+	fons__resetGlyphs(baseFont);
+	fons__resetCodepoints(baseFont);
+	stash->generation++;
 }
 
 void fonsSetSize(FONScontext* stash, float size)
@@ -871,12 +1753,162 @@ void fonsClearState(FONScontext* stash)
 	state->align = FONS_ALIGN_LEFT | FONS_ALIGN_BASELINE;
 }
 
+// Maps a file read-only, or reads it where it can not be mapped. Released with fons__unmapFile().
+static unsigned char* fons__mapFile(const char* path, int* dataSize, int* mapped)
+{
+#ifndef _WIN32
+	struct stat st;
+	unsigned char* data = NULL;
+	int fd = open(path, O_RDONLY);
+
+	*mapped = 0;
+	if (fd == -1) return NULL;
+	if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size < 0x7fffffff) {
+		*dataSize = (int)st.st_size;
+		data = (unsigned char*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != (unsigned char*)MAP_FAILED) {
+			*mapped = 1;
+		} else {
+			// Some file systems can not be mapped, read the file instead.
+			data = (unsigned char*)FONS_MALLOC(*dataSize);
+			if (data != NULL && read(fd, data, *dataSize) != (ssize_t)*dataSize) {
+				FONS_FREE(data);
+				data = NULL;
+			}
+		}
+	}
+	close(fd);
+	return data;
+#else
+	FILE* fp = fopen(path, "rb");
+	unsigned char* data = NULL;
+	long size;
+
+	*mapped = 0;
+	if (fp == NULL) return NULL;
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size > 0 && size < 0x7fffffff) {
+		*dataSize = (int)size;
+		data = (unsigned char*)FONS_MALLOC(*dataSize);
+		if (data != NULL && fread(data, 1, *dataSize, fp) != (size_t)*dataSize) {
+			FONS_FREE(data);
+			data = NULL;
+		}
+	}
+	fclose(fp);
+	return data;
+#endif
+}
+
+static void fons__unmapFile(unsigned char* data, int dataSize, int mapped)
+{
+#ifndef _WIN32
+	if (mapped) {
+		munmap(data, (size_t)dataSize);
+		return;
+	}
+#endif
+	FONS_NOTUSED(dataSize);
+	FONS_NOTUSED(mapped);
+	FONS_FREE(data);
+}
+
+#ifndef FONS_NO_SHARED_FONTS
+
+static FONSface* fons__faces = NULL;
+#ifndef FONS_NO_THREADS
+static pthread_mutex_t fons__facesLock = PTHREAD_MUTEX_INITIALIZER;
+#	define FONS_LOCK_FACES() pthread_mutex_lock(&fons__facesLock)
+#	define FONS_UNLOCK_FACES() pthread_mutex_unlock(&fons__facesLock)
+#else
+#	define FONS_LOCK_FACES()
+#	define FONS_UNLOCK_FACES()
+#endif
+
+// Returns the face of the font file with a reference added, mapping and parsing it
+// if no stash uses it yet.
+static FONSface* fons__acquireFace(const char* path, int fontIndex)
+{
+	FONSface* face;
+
+	FONS_LOCK_FACES();
+	for (face = fons__faces; face != NULL; face = face->next) {
+		if (face->fontIndex == fontIndex && strcmp(face->path, path) == 0) {
+			face->refs++;
+			FONS_UNLOCK_FACES();
+			return face;
+		}
+	}
+
+	face = (FONSface*)FONS_MALLOC(sizeof(FONSface));
+	if (face == NULL) goto error;
+	memset(face, 0, sizeof(FONSface));
+	face->path = (char*)FONS_MALLOC(strlen(path)+1);
+	if (face->path == NULL) goto error;
+	strcpy(face->path, path);
+	face->fontIndex = fontIndex;
+	face->data = fons__mapFile(path, &face->dataSize, &face->mapped);
+	if (face->data == NULL) goto error;
+	if (!fons__tt_loadSharedFont(&face->font, face->data, face->dataSize, fontIndex)) goto error;
+	face->refs = 1;
+	face->next = fons__faces;
+	fons__faces = face;
+	FONS_UNLOCK_FACES();
+	return face;
+
+error:
+	if (face != NULL) {
+		if (face->data != NULL) fons__unmapFile(face->data, face->dataSize, face->mapped);
+		if (face->path != NULL) FONS_FREE(face->path);
+		FONS_FREE(face);
+	}
+	FONS_UNLOCK_FACES();
+	return NULL;
+}
+
+static void fons__releaseFace(FONSface* face)
+{
+	FONSface** prev;
+
+	FONS_LOCK_FACES();
+	if (--face->refs > 0) {
+		FONS_UNLOCK_FACES();
+		return;
+	}
+	for (prev = &fons__faces; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == face) {
+			*prev = face->next;
+			break;
+		}
+	}
+	FONS_UNLOCK_FACES();
+
+	fons__unmapFile(face->data, face->dataSize, face->mapped);
+	FONS_FREE(face->path);
+	FONS_FREE(face);
+}
+
+#else
+
+static void fons__releaseFace(FONSface* face)
+{
+	FONS_NOTUSED(face);
+}
+
+#endif // FONS_NO_SHARED_FONTS
+
 static void fons__freeFont(FONSfont* font)
 {
 	if (font == NULL) return;
-	if (font->glyphs) free(font->glyphs);
-	if (font->freeData && font->data) free(font->data);
-	free(font);
+	if (font->glyphs) FONS_FREE(font->glyphs);
+	if (font->lut) FONS_FREE(font->lut);
+	if (font->cmap) FONS_FREE(font->cmap);
+	fons__tt_freeFont(&font->font);
+	if (font->freeData && font->data) FONS_FREE(font->data);
+	if (font->face) fons__releaseFace(font->face);
+	FONS_FREE(font);
 }
 
 static int fons__allocFont(FONScontext* stash)
@@ -884,19 +1916,29 @@ static int fons__allocFont(FONScontext* stash)
 	FONSfont* font = NULL;
 	if (stash->nfonts+1 > stash->cfonts) {
 		stash->cfonts = stash->cfonts == 0 ? 8 : stash->cfonts * 2;
-		stash->fonts = (FONSfont**)realloc(stash->fonts, sizeof(FONSfont*) * stash->cfonts);
+		stash->fonts = (FONSfont**)FONS_REALLOC(stash->fonts, sizeof(FONSfont*) * stash->cfonts);
 		if (stash->fonts == NULL)
 			return -1;
 	}
-	font = (FONSfont*)malloc(sizeof(FONSfont));
+	font = (FONSfont*)FONS_MALLOC(sizeof(FONSfont));
 	if (font == NULL) goto error;
 	memset(font, 0, sizeof(FONSfont));
 
-	font->glyphs = (FONSglyph*)malloc(sizeof(FONSglyph) * FONS_INIT_GLYPHS);
+	font->glyphs = (FONSglyph*)FONS_MALLOC(sizeof(FONSglyph) * FONS_INIT_GLYPHS);
 	if (font->glyphs == NULL) goto error;
 	font->cglyphs = FONS_INIT_GLYPHS;
 	font->nglyphs = 0;
 
+	font->lut = (int*)FONS_MALLOC(sizeof(int) * FONS_HASH_LUT_SIZE);
+	if (font->lut == NULL) goto error;
+	font->clut = FONS_HASH_LUT_SIZE;
+	fons__resetGlyphs(font);
+
+	font->cmap = (FONScodepoint*)FONS_MALLOC(sizeof(FONScodepoint) * FONS_HASH_LUT_SIZE);
+	if (font->cmap == NULL) goto error;
+	font->ccmap = FONS_HASH_LUT_SIZE;
+	fons__resetCodepoints(font);
+
 	stash->fonts[stash->nfonts++] = font;
 	return stash->nfonts-1;
 
@@ -906,8 +1948,17 @@ error:
 	return FONS_INVALID;
 }
 
+static int fons__addFont(FONScontext* stash, const char* name, unsigned char* data, int dataSize, int freeData,
+						 int fontIndex, FONSface* face);
+
 int fonsAddFont(FONScontext* stash, const char* name, const char* path, int fontIndex)
 {
+#ifndef FONS_NO_SHARED_FONTS
+	FONSface* face = fons__acquireFace(path, fontIndex);
+	if (face == NULL)
+		return FONS_INVALID;
+	return fons__addFont(stash, name, face->data, face->dataSize, 0, fontIndex, face);
+#else
 	FILE* fp = 0;
 	int dataSize = 0;
 	size_t readed;
@@ -919,7 +1970,7 @@ int fonsAddFont(FONScontext* stash, const char* name, const char* path, int font
 	fseek(fp,0,SEEK_END);
 	dataSize = (int)ftell(fp);
 	fseek(fp,0,SEEK_SET);
-	data = (unsigned char*)malloc(dataSize);
+	data = (unsigned char*)FONS_MALLOC(dataSize);
 	if (data == NULL) goto error;
 	readed = fread(data, 1, dataSize, fp);
 	fclose(fp);
@@ -929,37 +1980,49 @@ int fonsAddFont(FONScontext* stash, const char* name, const char* path, int font
 	return fonsAddFontMem(stash, name, data, dataSize, 1, fontIndex);
 
 error:
-	if (data) free(data);
+	if (data) FONS_FREE(data);
 	if (fp) fclose(fp);
 	return FONS_INVALID;
+#endif
 }
 
 int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, int dataSize, int freeData, int fontIndex)
 {
-	int i, ascent, descent, fh, lineGap;
+	return fons__addFont(stash, name, data, dataSize, freeData, fontIndex, NULL);
+}
+
+static int fons__addFont(FONScontext* stash, const char* name, unsigned char* data, int dataSize, int freeData,
+						 int fontIndex, FONSface* face)
+{
+	int ascent, descent, fh, lineGap;
 	FONSfont* font;
 
 	int idx = fons__allocFont(stash);
-	if (idx == FONS_INVALID)
+	if (idx == FONS_INVALID) {
+		if (face) fons__releaseFace(face);
 		return FONS_INVALID;
+	}
 
 	font = stash->fonts[idx];
+	font->face = face;
+	font->fontIndex = fontIndex;
 
 	strncpy(font->name, name, sizeof(font->name));
 	font->name[sizeof(font->name)-1] = '\0';
 
-	// Init hash lookup.
-	for (i = 0; i < FONS_HASH_LUT_SIZE; ++i)
-		font->lut[i] = -1;
-
 	// Read in the font data.
 	font->dataSize = dataSize;
 	font->data = data;
 	font->freeData = (unsigned char)freeData;
 
 	// Init font
-	stash->nscratch = 0;
-	if (!fons__tt_loadFont(stash, &font->font, data, dataSize, fontIndex)) goto error;
+	stash->scratch[0].n = 0;
+	if (face != NULL) {
+		if (!fons__tt_copyFont(stash, &font->font, &face->font, data, dataSize, fontIndex)) goto error;
+	} else {
+		if (!fons__tt_loadFont(stash, &font->font, data, dataSize, fontIndex)) goto error;
+	}
+	fons__tt_setScratch(&font->font, &stash->scratch[0]);
 
 	// Store normalized line height. The real line height is got
 	// by multiplying the lineh by font size.
@@ -993,7 +2056,7 @@ static FONSglyph* fons__allocGlyph(FONSfont* font)
 {
 	if (font->nglyphs+1 > font->cglyphs) {
 		font->cglyphs = font->cglyphs == 0 ? 8 : font->cglyphs * 2;
-		font->glyphs = (FONSglyph*)realloc(font->glyphs, sizeof(FONSglyph) * font->cglyphs);
+		font->glyphs = (FONSglyph*)FONS_REALLOC(font->glyphs, sizeof(FONSglyph) * font->cglyphs);
 		if (font->glyphs == NULL) return NULL;
 	}
 	font->nglyphs++;
@@ -1066,58 +2129,131 @@ static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int
 //	fons__blurcols(dst, w, h, dstStride, alpha);
 }
 
+static void fons__rasterizeGlyph(FONScontext* stash, FONSglyphJob* job, int worker)
+{
+	FONSttFontImpl font = job->font->font;
+	FONSscratch* scratch = &stash->scratch[worker];
+	int stride = stash->params.width, pad = job->pad, w = job->w, h = job->h, x, y;
+	unsigned char* dst = &stash->pages[job->page].texData[job->x + job->y * stride];
+
+	// Each thread allocates from its own scratch buffer.
+	fons__tt_setScratch(&font, scratch);
+	scratch->n = 0;
+
+	FONS_GLYPH_RASTER_BEGIN(stash)
+	if ((stash->params.flags & FONS_SDF) == 0 || !fons__tt_renderGlyphSDF(&font, dst, w,h, stride, job->scale, pad, job->index)) {
+		// Without a distance field, the coverage bitmap is used. Its half level makes a rough edge.
+		fons__tt_renderGlyphBitmap(&font, &dst[pad + pad * stride], w-pad*2,h-pad*2, stride, job->scale, job->scale, job->index);
+	}
+
+	// Make sure there is one pixel empty border.
+	for (y = 0; y < h; y++) {
+		dst[y*stride] = 0;
+		dst[w-1 + y*stride] = 0;
+	}
+	for (x = 0; x < w; x++) {
+		dst[x] = 0;
+		dst[x + (h-1)*stride] = 0;
+	}
+
+	// Debug code to color the glyph background
+/*	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			int a = (int)dst[x+y*stride] + 20;
+			if (a > 255) a = 255;
+			dst[x+y*stride] = a;
+		}
+	}*/
+
+	// Blur
+	if (job->blur > 0) {
+		scratch->n = 0;
+		fons__blur(stash, dst, w, h, stride, job->blur);
+	}
+	FONS_GLYPH_RASTER_END(stash)
+}
+
+static int fons__addGlyphJob(FONScontext* stash, FONSglyphJob* job)
+{
+#ifdef FONS_USE_FREETYPE
+	// FreeType renders the glyph loaded last, it can not be deferred.
+	FONS_NOTUSED(stash);
+	FONS_NOTUSED(job);
+	return 0;
+#else
+	if (stash->njobs+1 > stash->cjobs) {
+		int cjobs = stash->njobs+1 + stash->cjobs/2;
+		FONSglyphJob* jobs = (FONSglyphJob*)FONS_REALLOC(stash->jobs, sizeof(FONSglyphJob) * cjobs);
+		if (jobs == NULL) return 0;
+		stash->jobs = jobs;
+		stash->cjobs = cjobs;
+	}
+	stash->jobs[stash->njobs++] = *job;
+	return 1;
+#endif
+}
+
+static void fons__rasterizePendingGlyphs(FONScontext* stash)
+{
+	int i;
+	for (i = 0; i < stash->njobs; i++)
+		fons__rasterizeGlyph(stash, &stash->jobs[i], 0);
+	stash->njobs = 0;
+}
+
 static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
 								 short isize, short iblur, int bitmapOption)
 {
-	int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy, x, y;
-	float scale;
+	int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy;
+	float scale, size;
 	FONSglyph* glyph = NULL;
-	unsigned int h;
-	float size = isize/10.0f;
+	int* ascii = NULL;
+	int sdf = (stash->params.flags & FONS_SDF) != 0;
 	int pad, added;
-	unsigned char* bdst;
-	unsigned char* dst;
+	FONSglyphJob job;
 	FONSfont* renderFont = font;
+	FONSpage* page;
+	int gp = 0;
 
 	if (isize < 2) return NULL;
-	if (iblur > 20) iblur = 20;
-	pad = iblur+2;
-
-	// Reset allocator.
-	stash->nscratch = 0;
+	if (sdf) {
+		// One distance field serves every size and blur.
+		isize = FONS_SDF_SIZE*10;
+		iblur = 0;
+		pad = FONS_SDF_PAD;
+	} else {
+		if (iblur > 20) iblur = 20;
+		pad = iblur+2;
+	}
+	size = isize/10.0f;
 
 	// Find code point and size.
-	h = fons__hashint(codepoint) & (FONS_HASH_LUT_SIZE-1);
-	i = font->lut[h];
-	while (i != -1) {
-		if (font->glyphs[i].codepoint == codepoint && font->glyphs[i].size == isize && font->glyphs[i].blur == iblur) {
-			glyph = &font->glyphs[i];
-			if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL || (glyph->x0 >= 0 && glyph->y0 >= 0)) {
-			  return glyph;
-			}
-			// At this point, glyph exists but the bitmap data is not yet created.
-			break;
+	if (codepoint < 128) {
+		ascii = fons__asciiGlyphs(font, isize, iblur);
+		i = ascii[codepoint];
+		if (i == -1) {
+			i = fons__findGlyph(font, codepoint, isize, iblur);
+			ascii[codepoint] = i;
 		}
-		i = font->glyphs[i].next;
+	} else {
+		i = fons__findGlyph(font, codepoint, isize, iblur);
 	}
-
-	// Create a new glyph or rasterize bitmap data for a cached glyph.
-	g = fons__tt_getGlyphIndex(&font->font, codepoint);
-	// Try to find the glyph in fallback fonts.
-	if (g == 0) {
-		for (i = 0; i < font->nfallbacks; ++i) {
-			FONSfont* fallbackFont = stash->fonts[font->fallbacks[i]];
-			int fallbackIndex = fons__tt_getGlyphIndex(&fallbackFont->font, codepoint);
-			if (fallbackIndex != 0) {
-				g = fallbackIndex;
-				renderFont = fallbackFont;
-				break;
-			}
+	if (i != -1) {
+		glyph = &font->glyphs[i];
+		if (glyph->x0 >= 0 && glyph->y0 >= 0) {
+			if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED)
+				fons__touchGlyph(stash, glyph);
+			return glyph;
 		}
-		// It is possible that we did not find a fallback glyph.
-		// In that case the glyph index 'g' is 0, and we'll proceed below and cache empty glyph.
+		if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL)
+			return glyph;
+		// At this point, glyph exists but the bitmap data is not yet created.
 	}
+
+	// Create a new glyph or rasterize bitmap data for a cached glyph.
+	g = fons__resolveCodepoint(stash, font, codepoint, &renderFont);
 	scale = fons__tt_getPixelHeightScale(&renderFont->font, size);
+	stash->scratch[0].n = 0;
 	fons__tt_buildGlyphBitmap(&renderFont->font, g, size, scale, &advance, &lsb, &x0, &y0, &x1, &y1);
 	gw = x1-x0 + pad*2;
 	gh = y1-y0 + pad*2;
@@ -1125,11 +2261,11 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	// Determines the spot to draw glyph in the atlas.
 	if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED) {
 		// Find free spot for the rect in the atlas
-		added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
+		added = fons__allocRect(stash, gw, gh, &gp, &gx, &gy);
 		if (added == 0 && stash->handleError != NULL) {
 			// Atlas is full, let the user to resize the atlas (or not), and try again.
 			stash->handleError(stash->errorUptr, FONS_ATLAS_FULL, 0);
-			added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
+			added = fons__allocRect(stash, gw, gh, &gp, &gx, &gy);
 		}
 		if (added == 0) return NULL;
 	} else {
@@ -1140,17 +2276,20 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 
 	// Init glyph.
 	if (glyph == NULL) {
+		if (!fons__growGlyphLut(font)) return NULL;
 		glyph = fons__allocGlyph(font);
+		if (glyph == NULL) return NULL;
 		glyph->codepoint = codepoint;
 		glyph->size = isize;
 		glyph->blur = iblur;
-		glyph->next = 0;
 
 		// Insert char to hash lookup.
-		glyph->next = font->lut[h];
-		font->lut[h] = font->nglyphs-1;
+		fons__insertGlyph(font, font->nglyphs-1);
+		if (ascii != NULL)
+			ascii[codepoint] = font->nglyphs-1;
 	}
 	glyph->index = g;
+	glyph->page = (short)gp;
 	glyph->x0 = (short)gx;
 	glyph->y0 = (short)gy;
 	glyph->x1 = (short)(glyph->x0+gw);
@@ -1162,57 +2301,49 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL) {
 		return glyph;
 	}
-
-	// Rasterize
-	dst = &stash->texData[(glyph->x0+pad) + (glyph->y0+pad) * stash->params.width];
-	fons__tt_renderGlyphBitmap(&renderFont->font, dst, gw-pad*2,gh-pad*2, stash->params.width, scale, scale, g);
-
-	// Make sure there is one pixel empty border.
-	dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-	for (y = 0; y < gh; y++) {
-		dst[y*stash->params.width] = 0;
-		dst[gw-1 + y*stash->params.width] = 0;
-	}
-	for (x = 0; x < gw; x++) {
-		dst[x] = 0;
-		dst[x + (gh-1)*stash->params.width] = 0;
-	}
-
-	// Debug code to color the glyph background
-/*	unsigned char* fdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-	for (y = 0; y < gh; y++) {
-		for (x = 0; x < gw; x++) {
-			int a = (int)fdst[x+y*stash->params.width] + 20;
-			if (a > 255) a = 255;
-			fdst[x+y*stash->params.width] = a;
-		}
-	}*/
-
-	// Blur
-	if (iblur > 0) {
-		stash->nscratch = 0;
-		bdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-		fons__blur(stash, bdst, gw, gh, stash->params.width, iblur);
-	}
-
-	stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], glyph->x0);
-	stash->dirtyRect[1] = fons__mini(stash->dirtyRect[1], glyph->y0);
-	stash->dirtyRect[2] = fons__maxi(stash->dirtyRect[2], glyph->x1);
-	stash->dirtyRect[3] = fons__maxi(stash->dirtyRect[3], glyph->y1);
+	fons__touchGlyph(stash, glyph);
+
+	// Rasterize now, or leave it to the caller with FONS_DEFER_GLYPHS.
+	job.font = renderFont;
+	job.index = g;
+	job.scale = scale;
+	job.page = glyph->page;
+	job.x = glyph->x0;
+	job.y = glyph->y0;
+	job.w = (short)gw;
+	job.h = (short)gh;
+	job.pad = (short)pad;
+	job.blur = iblur;
+	if ((stash->params.flags & FONS_DEFER_GLYPHS) == 0 || !fons__addGlyphJob(stash, &job))
+		fons__rasterizeGlyph(stash, &job, 0);
+	stash->nrasterized++;
+
+	page = &stash->pages[glyph->page];
+	page->dirtyRect[0] = fons__mini(page->dirtyRect[0], glyph->x0);
+	page->dirtyRect[1] = fons__mini(page->dirtyRect[1], glyph->y0);
+	page->dirtyRect[2] = fons__maxi(page->dirtyRect[2], glyph->x1);
+	page->dirtyRect[3] = fons__maxi(page->dirtyRect[3], glyph->y1);
 
 	return glyph;
 }
 
+// Returns the kerning and letter spacing between the previous glyph and the glyph, in whole pixels.
+static float fons__kernAdvance(FONSfont* font, int prevGlyphIndex, FONSglyph* glyph, float scale, float spacing)
+{
+	float adv;
+	if (prevGlyphIndex == -1) return 0.0f;
+	adv = fons__tt_getGlyphKernAdvance(&font->font, prevGlyphIndex, glyph->index) * scale;
+	return (float)(int)(adv + spacing + 0.5f);
+}
+
 static void fons__getQuad(FONScontext* stash, FONSfont* font,
-						   int prevGlyphIndex, FONSglyph* glyph,
+						   int prevGlyphIndex, FONSglyph* glyph, short isize,
 						   float scale, float spacing, float* x, float* y, FONSquad* q)
 {
-	float rx,ry,xoff,yoff,x0,y0,x1,y1;
+	float rx,ry,xoff,yoff,x0,y0,x1,y1,gs = 1.0f;
+	int sdf = (stash->params.flags & FONS_SDF) != 0;
 
-	if (prevGlyphIndex != -1) {
-		float adv = fons__tt_getGlyphKernAdvance(&font->font, prevGlyphIndex, glyph->index) * scale;
-		*x += (int)(adv + spacing + 0.5f);
-	}
+	*x += fons__kernAdvance(font, prevGlyphIndex, glyph, scale, spacing);
 
 	// Each glyph has 2px border to allow good interpolation,
 	// one pixel to prevent leaking, and one to allow good interpolation for rendering.
@@ -1224,48 +2355,63 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 	x1 = (float)(glyph->x1-1);
 	y1 = (float)(glyph->y1-1);
 
+	// Distance field glyphs are stored at the reference size and are not snapped to pixels.
+	if (sdf) {
+		gs = isize / (FONS_SDF_SIZE*10.0f);
+		xoff *= gs;
+		yoff *= gs;
+	}
+
 	if (stash->params.flags & FONS_ZERO_TOPLEFT) {
-		rx = floorf(*x + xoff);
-		ry = floorf(*y + yoff);
+		rx = sdf ? *x + xoff : floorf(*x + xoff);
+		ry = sdf ? *y + yoff : floorf(*y + yoff);
 
 		q->x0 = rx;
 		q->y0 = ry;
-		q->x1 = rx + x1 - x0;
-		q->y1 = ry + y1 - y0;
+		q->x1 = rx + (x1 - x0) * gs;
+		q->y1 = ry + (y1 - y0) * gs;
 
 		q->s0 = x0 * stash->itw;
 		q->t0 = y0 * stash->ith;
 		q->s1 = x1 * stash->itw;
 		q->t1 = y1 * stash->ith;
 	} else {
-		rx = floorf(*x + xoff);
-		ry = floorf(*y - yoff);
+		rx = sdf ? *x + xoff : floorf(*x + xoff);
+		ry = sdf ? *y - yoff : floorf(*y - yoff);
 
 		q->x0 = rx;
 		q->y0 = ry;
-		q->x1 = rx + x1 - x0;
-		q->y1 = ry - y1 + y0;
+		q->x1 = rx + (x1 - x0) * gs;
+		q->y1 = ry - (y1 - y0) * gs;
 
 		q->s0 = x0 * stash->itw;
 		q->t0 = y0 * stash->ith;
 		q->s1 = x1 * stash->itw;
 		q->t1 = y1 * stash->ith;
 	}
+	q->page = glyph->page;
 
-	*x += (int)(glyph->xadv / 10.0f + 0.5f);
+	if (sdf)
+		*x += glyph->xadv / 10.0f * gs;
+	else
+		*x += (int)(glyph->xadv / 10.0f + 0.5f);
 }
 
 static void fons__flush(FONScontext* stash)
 {
+	FONSpage* page = &stash->pages[0];
+
+	fons__rasterizePendingGlyphs(stash);
+
 	// Flush texture
-	if (stash->dirtyRect[0] < stash->dirtyRect[2] && stash->dirtyRect[1] < stash->dirtyRect[3]) {
+	if (page->dirtyRect[0] < page->dirtyRect[2] && page->dirtyRect[1] < page->dirtyRect[3]) {
 		if (stash->params.renderUpdate != NULL)
-			stash->params.renderUpdate(stash->params.userPtr, stash->dirtyRect, stash->texData);
+			stash->params.renderUpdate(stash->params.userPtr, page->dirtyRect, page->texData);
 		// Reset dirty rect
-		stash->dirtyRect[0] = stash->params.width;
-		stash->dirtyRect[1] = stash->params.height;
-		stash->dirtyRect[2] = 0;
-		stash->dirtyRect[3] = 0;
+		page->dirtyRect[0] = stash->params.width;
+		page->dirtyRect[1] = stash->params.height;
+		page->dirtyRect[2] = 0;
+		page->dirtyRect[3] = 0;
 	}
 
 	// Flush triangles
@@ -1356,7 +2502,7 @@ float fonsDrawText(FONScontext* stash,
 			continue;
 		glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_REQUIRED);
 		if (glyph != NULL) {
-			fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q);
+			fons__getQuad(stash, font, prevGlyphIndex, glyph, isize, scale, state->spacing, &x, &y, &q);
 
 			if (stash->nverts+6 > FONS_VERTEX_COUNT)
 				fons__flush(stash);
@@ -1440,8 +2586,11 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad* quad)
 		iter->y = iter->nexty;
 		glyph = fons__getGlyph(stash, iter->font, iter->codepoint, iter->isize, iter->iblur, iter->bitmapOption);
 		// If the iterator was initialized with FONS_GLYPH_BITMAP_OPTIONAL, then the UV coordinates of the quad will be invalid.
-		if (glyph != NULL)
-			fons__getQuad(stash, iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad);
+		if (glyph != NULL) {
+			iter->nextx += fons__kernAdvance(iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing);
+			iter->glyphx = iter->nextx;
+			fons__getQuad(stash, iter->font, -1, glyph, iter->isize, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad);
+		}
 		iter->prevGlyphIndex = glyph != NULL ? glyph->index : -1;
 		break;
 	}
@@ -1450,9 +2599,43 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad* quad)
 	return 1;
 }
 
-void fonsDrawDebug(FONScontext* stash, float x, float y)
+int fonsTextIterGlyph(FONScontext* stash, FONStextIter* iter, int* glyph, float* scale)
 {
+	FONSfont* glyphFont = iter->font;
 	int i;
+
+	if (iter->prevGlyphIndex == -1) return FONS_INVALID;
+	// Resolved codepoints are cached, this finds the fallback font the glyph came from.
+	fons__resolveCodepoint(stash, iter->font, iter->codepoint, &glyphFont);
+	for (i = 0; i < stash->nfonts; i++) {
+		if (stash->fonts[i] == glyphFont) {
+			*glyph = iter->prevGlyphIndex;
+			*scale = fons__tt_getPixelHeightScale(&glyphFont->font, (float)iter->isize/10.0f);
+			return i;
+		}
+	}
+	return FONS_INVALID;
+}
+
+int fonsGetGlyphShape(FONScontext* stash, int font, int glyph, FONSshapeVertex** verts)
+{
+	*verts = NULL;
+	if (stash == NULL || font < 0 || font >= stash->nfonts || stash->fonts[font]->data == NULL)
+		return 0;
+	// The outline is parsed in the scratch memory of the calling thread.
+	stash->scratch[0].n = 0;
+	return fons__tt_getGlyphShape(&stash->fonts[font]->font, glyph, verts);
+}
+
+void fonsFreeGlyphShape(FONScontext* stash, FONSshapeVertex* verts)
+{
+	FONS_NOTUSED(stash);
+	FONS_FREE(verts);
+}
+
+void fonsDrawDebug(FONScontext* stash, float x, float y)
+{
+	int i, j;
 	int w = stash->params.width;
 	int h = stash->params.height;
 	float u = w == 0 ? 0 : (1.0f / w);
@@ -1480,19 +2663,23 @@ void fonsDrawDebug(FONScontext* stash, float x, float y)
 	fons__vertex(stash, x+w, y+h, 1, 1, 0xffffffff);
 
 	// Drawbug draw atlas
-	for (i = 0; i < stash->atlas->nnodes; i++) {
-		FONSatlasNode* n = &stash->atlas->nodes[i];
+	for (j = 0; j < stash->pages[0].atlas->nbands; j++) {
+		FONSatlasBand* band = &stash->pages[0].atlas->bands[j];
+		for (i = 0; i < band->nnodes; i++) {
+			FONSatlasNode* n = &band->nodes[i];
+			float ny = y + band->y + n->y;
 
-		if (stash->nverts+6 > FONS_VERTEX_COUNT)
-			fons__flush(stash);
+			if (stash->nverts+6 > FONS_VERTEX_COUNT)
+				fons__flush(stash);
 
-		fons__vertex(stash, x+n->x+0, y+n->y+0, u, v, 0xc00000ff);
-		fons__vertex(stash, x+n->x+n->width, y+n->y+1, u, v, 0xc00000ff);
-		fons__vertex(stash, x+n->x+n->width, y+n->y+0, u, v, 0xc00000ff);
+			fons__vertex(stash, x+n->x+0, ny+0, u, v, 0xc00000ff);
+			fons__vertex(stash, x+n->x+n->width, ny+1, u, v, 0xc00000ff);
+			fons__vertex(stash, x+n->x+n->width, ny+0, u, v, 0xc00000ff);
 
-		fons__vertex(stash, x+n->x+0, y+n->y+0, u, v, 0xc00000ff);
-		fons__vertex(stash, x+n->x+0, y+n->y+1, u, v, 0xc00000ff);
-		fons__vertex(stash, x+n->x+n->width, y+n->y+1, u, v, 0xc00000ff);
+			fons__vertex(stash, x+n->x+0, ny+0, u, v, 0xc00000ff);
+			fons__vertex(stash, x+n->x+0, ny+1, u, v, 0xc00000ff);
+			fons__vertex(stash, x+n->x+n->width, ny+1, u, v, 0xc00000ff);
+		}
 	}
 
 	fons__flush(stash);
@@ -1538,7 +2725,7 @@ float fonsTextBounds(FONScontext* stash,
 			continue;
 		glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_OPTIONAL);
 		if (glyph != NULL) {
-			fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q);
+			fons__getQuad(stash, font, prevGlyphIndex, glyph, isize, scale, state->spacing, &x, &y, &q);
 			if (q.x0 < minx) minx = q.x0;
 			if (q.x1 > maxx) maxx = q.x1;
 			if (stash->params.flags & FONS_ZERO_TOPLEFT) {
@@ -1620,31 +2807,95 @@ void fonsLineBounds(FONScontext* stash, float y, float* miny, float* maxy)
 }
 
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height)
+{
+	return fonsGetPageData(stash, 0, width, height);
+}
+
+int fonsValidateTexture(FONScontext* stash, int* dirty)
+{
+	return fonsValidatePage(stash, 0, dirty);
+}
+
+int fonsGetPageCount(FONScontext* stash)
+{
+	if (stash == NULL) return 0;
+	return stash->npages;
+}
+
+const unsigned char* fonsGetPageData(FONScontext* stash, int page, int* width, int* height)
 {
 	if (width != NULL)
 		*width = stash->params.width;
 	if (height != NULL)
 		*height = stash->params.height;
-	return stash->texData;
+	if (page < 0 || page >= stash->npages)
+		return NULL;
+	return stash->pages[page].texData;
 }
 
-int fonsValidateTexture(FONScontext* stash, int* dirty)
+int fonsValidatePage(FONScontext* stash, int page, int* dirty)
 {
-	if (stash->dirtyRect[0] < stash->dirtyRect[2] && stash->dirtyRect[1] < stash->dirtyRect[3]) {
-		dirty[0] = stash->dirtyRect[0];
-		dirty[1] = stash->dirtyRect[1];
-		dirty[2] = stash->dirtyRect[2];
-		dirty[3] = stash->dirtyRect[3];
+	FONSpage* p;
+	if (page < 0 || page >= stash->npages)
+		return 0;
+	p = &stash->pages[page];
+	if (p->dirtyRect[0] < p->dirtyRect[2] && p->dirtyRect[1] < p->dirtyRect[3]) {
+		dirty[0] = p->dirtyRect[0];
+		dirty[1] = p->dirtyRect[1];
+		dirty[2] = p->dirtyRect[2];
+		dirty[3] = p->dirtyRect[3];
 		// Reset dirty rect
-		stash->dirtyRect[0] = stash->params.width;
-		stash->dirtyRect[1] = stash->params.height;
-		stash->dirtyRect[2] = 0;
-		stash->dirtyRect[3] = 0;
+		p->dirtyRect[0] = stash->params.width;
+		p->dirtyRect[1] = stash->params.height;
+		p->dirtyRect[2] = 0;
+		p->dirtyRect[3] = 0;
 		return 1;
 	}
 	return 0;
 }
 
+int fonsGetPendingGlyphCount(FONScontext* stash)
+{
+	if (stash == NULL) return 0;
+	return stash->njobs;
+}
+
+void fonsRasterizePendingGlyph(FONScontext* stash, int glyph, int worker)
+{
+	FONSscratch* scratch;
+	if (stash == NULL || glyph < 0 || glyph >= stash->njobs || worker < 0 || worker >= FONS_MAX_SCRATCH)
+		return;
+	scratch = &stash->scratch[worker];
+	if (scratch->data == NULL) {
+		scratch->data = (unsigned char*)FONS_MALLOC(FONS_SCRATCH_BUF_SIZE);
+		if (scratch->data == NULL) return;
+	}
+	fons__rasterizeGlyph(stash, &stash->jobs[glyph], worker);
+}
+
+void fonsClearPendingGlyphs(FONScontext* stash)
+{
+	if (stash == NULL) return;
+	stash->njobs = 0;
+}
+
+int fonsPrewarmGlyph(FONScontext* stash, unsigned int codepoint)
+{
+	FONSstate* state = fons__getState(stash);
+	FONSfont* font;
+	FONSfont* glyphFont;
+	short isize = (short)(state->size*10.0f);
+	short iblur = (short)state->blur;
+	int n = stash->nrasterized;
+
+	if (state->font < 0 || state->font >= stash->nfonts) return 0;
+	font = stash->fonts[state->font];
+	if (isize < 2 || fons__resolveCodepoint(stash, font, codepoint, &glyphFont) == 0) return 0;
+	if (fons__getGlyph(stash, font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_REQUIRED) == NULL)
+		return -1;
+	return stash->nrasterized - n;
+}
+
 void fonsDeleteInternal(FONScontext* stash)
 {
 	int i;
@@ -1656,11 +2907,14 @@ void fonsDeleteInternal(FONScontext* stash)
 	for (i = 0; i < stash->nfonts; ++i)
 		fons__freeFont(stash->fonts[i]);
 
-	if (stash->atlas) fons__deleteAtlas(stash->atlas);
-	if (stash->fonts) free(stash->fonts);
-	if (stash->texData) free(stash->texData);
-	if (stash->scratch) free(stash->scratch);
-	free(stash);
+	for (i = 0; i < stash->npages; ++i)
+		fons__freePage(&stash->pages[i]);
+	if (stash->fonts) FONS_FREE(stash->fonts);
+	for (i = 0; i < FONS_MAX_SCRATCH; i++) {
+		if (stash->scratch[i].data) FONS_FREE(stash->scratch[i].data);
+	}
+	if (stash->jobs) FONS_FREE(stash->jobs);
+	FONS_FREE(stash);
 	fons__tt_done(stash);
 }
 
@@ -1671,6 +2925,32 @@ void fonsSetErrorCallback(FONScontext* stash, void (*callback)(void* uptr, int e
 	stash->errorUptr = uptr;
 }
 
+int fonsGetRasterizedGlyphCount(FONScontext* stash)
+{
+	if (stash == NULL) return 0;
+	return stash->nrasterized;
+}
+
+void fonsAdvanceFrame(FONScontext* stash)
+{
+	if (stash == NULL) return;
+	stash->frame++;
+}
+
+int fonsGetAtlasGeneration(FONScontext* stash)
+{
+	if (stash == NULL) return 0;
+	return stash->generation;
+}
+
+void fonsTouchQuad(FONScontext* stash, const FONSquad* q)
+{
+	int y;
+	if (stash == NULL || q->page < 0 || q->page >= stash->npages) return;
+	y = (int)((q->t0 < q->t1 ? q->t0 : q->t1) * stash->params.height);
+	fons__atlasBandAt(stash->pages[q->page].atlas, y)->lastUsed = stash->frame;
+}
+
 void fonsGetAtlasSize(FONScontext* stash, int* width, int* height)
 {
 	if (stash == NULL) return;
@@ -1680,7 +2960,7 @@ void fonsGetAtlasSize(FONScontext* stash, int* width, int* height)
 
 int fonsExpandAtlas(FONScontext* stash, int width, int height)
 {
-	int i, maxy = 0;
+	int i, j, p, maxy = 0;
 	unsigned char* data = NULL;
 	if (stash == NULL) return 0;
 
@@ -1698,34 +2978,44 @@ int fonsExpandAtlas(FONScontext* stash, int width, int height)
 		if (stash->params.renderResize(stash->params.userPtr, width, height) == 0)
 			return 0;
 	}
-	// Copy old texture data over.
-	data = (unsigned char*)malloc(width * height);
-	if (data == NULL)
-		return 0;
-	for (i = 0; i < stash->params.height; i++) {
-		unsigned char* dst = &data[i*width];
-		unsigned char* src = &stash->texData[i*stash->params.width];
-		memcpy(dst, src, stash->params.width);
-		if (width > stash->params.width)
-			memset(dst+stash->params.width, 0, width - stash->params.width);
-	}
-	if (height > stash->params.height)
-		memset(&data[stash->params.height * width], 0, (height - stash->params.height) * width);
-
-	free(stash->texData);
-	stash->texData = data;
-
-	// Increase atlas size
-	fons__atlasExpand(stash->atlas, width, height);
-
-	// Add existing data as dirty.
-	for (i = 0; i < stash->atlas->nnodes; i++)
-		maxy = fons__maxi(maxy, stash->atlas->nodes[i].y);
-	stash->dirtyRect[0] = 0;
-	stash->dirtyRect[1] = 0;
-	stash->dirtyRect[2] = stash->params.width;
-	stash->dirtyRect[3] = maxy;
+	for (p = 0; p < stash->npages; p++) {
+		FONSpage* page = &stash->pages[p];
+
+		// Copy old texture data over.
+		data = (unsigned char*)FONS_MALLOC(width * height);
+		if (data == NULL)
+			return 0;
+		for (i = 0; i < stash->params.height; i++) {
+			unsigned char* dst = &data[i*width];
+			unsigned char* src = &page->texData[i*stash->params.width];
+			memcpy(dst, src, stash->params.width);
+			if (width > stash->params.width)
+				memset(dst+stash->params.width, 0, width - stash->params.width);
+		}
+		if (height > stash->params.height)
+			memset(&data[stash->params.height * width], 0, (height - stash->params.height) * width);
+
+		FONS_FREE(page->texData);
+		page->texData = data;
 
+		// Increase atlas size
+		fons__atlasExpand(page->atlas, width, height);
+
+		// Add existing data as dirty.
+		maxy = 0;
+		for (i = 0; i < page->atlas->nbands; i++) {
+			FONSatlasBand* band = &page->atlas->bands[i];
+			for (j = 0; j < band->nnodes; j++)
+				maxy = fons__maxi(maxy, band->y + band->nodes[j].y);
+		}
+		page->dirtyRect[0] = 0;
+		page->dirtyRect[1] = 0;
+		page->dirtyRect[2] = stash->params.width;
+		page->dirtyRect[3] = maxy;
+	}
+
+	// Texture coordinates of all glyphs change.
+	stash->generation++;
 	stash->params.width = width;
 	stash->params.height = height;
 	stash->itw = 1.0f/stash->params.width;
@@ -1736,7 +3026,9 @@ int fonsExpandAtlas(FONScontext* stash, int width, int height)
 
 int fonsResetAtlas(FONScontext* stash, int width, int height)
 {
-	int i, j;
+	FONSpage* page;
+	unsigned char* data;
+	int i;
 	if (stash == NULL) return 0;
 
 	// Flush pending glyphs.
@@ -1748,27 +3040,32 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
 			return 0;
 	}
 
+	// Drop all but the first page.
+	while (stash->npages > 1)
+		fons__freePage(&stash->pages[--stash->npages]);
+	page = &stash->pages[0];
+
 	// Reset atlas
-	fons__atlasReset(stash->atlas, width, height);
+	if (fons__atlasReset(page->atlas, width, height) == 0)
+		return 0;
 
 	// Clear texture data.
-	stash->texData = (unsigned char*)realloc(stash->texData, width * height);
-	if (stash->texData == NULL) return 0;
-	memset(stash->texData, 0, width * height);
+	data = (unsigned char*)FONS_REALLOC(page->texData, width * height);
+	if (data == NULL) return 0;
+	page->texData = data;
+	memset(page->texData, 0, width * height);
 
 	// Reset dirty rect
-	stash->dirtyRect[0] = width;
-	stash->dirtyRect[1] = height;
-	stash->dirtyRect[2] = 0;
-	stash->dirtyRect[3] = 0;
+	page->dirtyRect[0] = width;
+	page->dirtyRect[1] = height;
+	page->dirtyRect[2] = 0;
+	page->dirtyRect[3] = 0;
 
 	// Reset cached glyphs
 	for (i = 0; i < stash->nfonts; i++) {
-		FONSfont* font = stash->fonts[i];
-		font->nglyphs = 0;
-		for (j = 0; j < FONS_HASH_LUT_SIZE; j++)
-			font->lut[j] = -1;
+		fons__resetGlyphs(stash->fonts[i]);
 	}
+	stash->generation++;
 
 	stash->params.width = width;
 	stash->params.height = height;
@@ -1781,5 +3078,272 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
 	return 1;
 }
 
+struct FONScacheHeader
+{
+	char magic[4];
+	int version;
+	int byteOrder;
+	int glyphSize;
+	int flags;
+	int sdfSize;
+	int width, height;
+	int npages;
+	int nfonts;
+};
+typedef struct FONScacheHeader FONScacheHeader;
+
+static unsigned long long fons__fontHash(FONSfont* font)
+{
+	const unsigned char* data = font->data;
+	unsigned long long h, k;
+	int i, n = font->dataSize;
+
+	if (font->hash != 0)
+		return font->hash;
+	// FNV-1a over 64-bit words, folded so that the high bits reach the low ones.
+	h = 0xcbf29ce484222325ULL ^ (unsigned long long)n;
+	for (i = 0; i+8 <= n; i += 8) {
+		memcpy(&k, &data[i], 8);
+		h = (h ^ k) * 0x100000001b3ULL;
+		h ^= h >> 32;
+	}
+	for (; i < n; i++)
+		h = (h ^ data[i]) * 0x100000001b3ULL;
+	h = (h ^ (unsigned long long)font->fontIndex) * 0x100000001b3ULL;
+	font->hash = h != 0 ? h : 1;
+	return font->hash;
+}
+
+// Cached glyphs of a font may come from its fallbacks, they have to match as well.
+static unsigned long long fons__cacheKey(FONScontext* stash, FONSfont* font)
+{
+	unsigned long long key = fons__fontHash(font);
+	int i;
+	for (i = 0; i < font->nfallbacks; i++)
+		key = (key ^ fons__fontHash(stash->fonts[font->fallbacks[i]])) * 0x100000001b3ULL;
+	return key;
+}
+
+static int fons__readCache(const unsigned char** ptr, const unsigned char* end, void* dst, size_t size)
+{
+	if ((size_t)(end - *ptr) < size)
+		return 0;
+	memcpy(dst, *ptr, size);
+	*ptr += size;
+	return 1;
+}
+
+static int fons__atlasRestore(FONSatlas* atlas, const unsigned char** ptr, const unsigned char* end)
+{
+	int i, j, nbands, x, y = 0;
+
+	if (!fons__readCache(ptr, end, &nbands, sizeof(int)) || nbands < 1 || nbands > atlas->height)
+		return 0;
+	if (nbands > atlas->cbands) {
+		FONSatlasBand* bands = (FONSatlasBand*)FONS_REALLOC(atlas->bands, sizeof(FONSatlasBand) * nbands);
+		if (bands == NULL)
+			return 0;
+		memset(&bands[atlas->cbands], 0, sizeof(FONSatlasBand) * (nbands - atlas->cbands));
+		atlas->bands = bands;
+		atlas->cbands = nbands;
+	}
+	// Bands past the restored ones stay parked with their nodes, as after merging.
+	for (i = 0; i < nbands; i++) {
+		FONSatlasBand* band = &atlas->bands[i];
+		int info[3];
+		if (!fons__readCache(ptr, end, info, sizeof(info)))
+			return 0;
+		if (info[0] != y || info[1] <= 0 || y + info[1] > atlas->height || info[2] < 1 || info[2] > atlas->width)
+			return 0;
+		if (info[2] > band->cnodes) {
+			FONSatlasNode* nodes = (FONSatlasNode*)FONS_REALLOC(band->nodes, sizeof(FONSatlasNode) * info[2]);
+			if (nodes == NULL)
+				return 0;
+			band->nodes = nodes;
+			band->cnodes = info[2];
+		}
+		if (!fons__readCache(ptr, end, band->nodes, sizeof(FONSatlasNode) * info[2]))
+			return 0;
+		// The skyline has to span the atlas width and stay inside the band, or glyphs are placed outside the texture.
+		for (j = 0, x = 0; j < info[2]; j++) {
+			FONSatlasNode* node = &band->nodes[j];
+			if (node->x != x || node->width <= 0 || node->y < 0 || node->y > info[1])
+				return 0;
+			x += node->width;
+		}
+		if (x != atlas->width)
+			return 0;
+		band->y = info[0];
+		band->height = info[1];
+		band->nnodes = info[2];
+		band->lastUsed = -1;
+		band->failw = band->failh = 0x7fff;
+		y += band->height;
+	}
+	atlas->nbands = nbands;
+	return y == atlas->height;
+}
+
+int fonsSaveCache(FONScontext* stash, const char* path)
+{
+	FONScacheHeader header;
+	FILE* fp = NULL;
+	char* tmp = NULL;
+	int i, j, ok = 1;
+
+	if (stash == NULL) return 0;
+
+	// The atlas has to hold the bitmaps of all glyphs in the table.
+	fons__rasterizePendingGlyphs(stash);
+
+	// Write next to the file and rename it, runs that map the old file keep reading it.
+	tmp = (char*)FONS_MALLOC(strlen(path) + 5);
+	if (tmp == NULL) goto error;
+	strcpy(tmp, path);
+	strcat(tmp, ".tmp");
+	fp = fopen(tmp, "wb");
+	if (fp == NULL) goto error;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "FONS", 4);
+	header.version = FONS_CACHE_VERSION;
+	header.byteOrder = 0x01020304;
+	header.glyphSize = (int)sizeof(FONSglyph);
+	header.flags = stash->params.flags & FONS_SDF;
+	header.sdfSize = FONS_SDF_SIZE;
+	header.width = stash->params.width;
+	header.height = stash->params.height;
+	header.npages = stash->npages;
+	header.nfonts = stash->nfonts;
+	ok &= fwrite(&header, sizeof(header), 1, fp) == 1;
+
+	for (i = 0; i < stash->npages; i++) {
+		FONSatlas* atlas = stash->pages[i].atlas;
+		ok &= fwrite(&atlas->nbands, sizeof(int), 1, fp) == 1;
+		for (j = 0; j < atlas->nbands; j++) {
+			FONSatlasBand* band = &atlas->bands[j];
+			int info[3];
+			info[0] = band->y;
+			info[1] = band->height;
+			info[2] = band->nnodes;
+			ok &= fwrite(info, sizeof(info), 1, fp) == 1;
+			ok &= fwrite(band->nodes, sizeof(FONSatlasNode), band->nnodes, fp) == (size_t)band->nnodes;
+		}
+		ok &= fwrite(stash->pages[i].texData, stash->params.width, stash->params.height, fp) == (size_t)stash->params.height;
+	}
+
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* font = stash->fonts[i];
+		unsigned long long key = fons__cacheKey(stash, font);
+		ok &= fwrite(&key, sizeof(key), 1, fp) == 1;
+		ok &= fwrite(&font->nglyphs, sizeof(int), 1, fp) == 1;
+		ok &= fwrite(font->glyphs, sizeof(FONSglyph), font->nglyphs, fp) == (size_t)font->nglyphs;
+	}
+
+	if (fclose(fp) != 0) ok = 0;
+	fp = NULL;
+	if (!ok) goto error;
+#ifdef _WIN32
+	remove(path);
+#endif
+	if (rename(tmp, path) != 0) goto error;
+	FONS_FREE(tmp);
+	return 1;
+
+error:
+	if (fp) fclose(fp);
+	if (tmp) {
+		remove(tmp);
+		FONS_FREE(tmp);
+	}
+	return 0;
+}
+
+int fonsLoadCache(FONScontext* stash, const char* path)
+{
+	FONScacheHeader header;
+	unsigned long long* keys = NULL;
+	unsigned char* data;
+	const unsigned char *ptr, *end;
+	int i, j, dataSize = 0, mapped = 0, nrestored = 0;
+
+	if (stash == NULL) return 0;
+	data = fons__mapFile(path, &dataSize, &mapped);
+	if (data == NULL) return 0;
+	ptr = data;
+	end = data + dataSize;
+
+	// A stale or foreign file leaves the atlas as it is.
+	if (!fons__readCache(&ptr, end, &header, sizeof(header))) goto error;
+	if (memcmp(header.magic, "FONS", 4) != 0 || header.version != FONS_CACHE_VERSION ||
+		header.byteOrder != 0x01020304 || header.glyphSize != (int)sizeof(FONSglyph) ||
+		header.flags != (stash->params.flags & FONS_SDF) || header.sdfSize != FONS_SDF_SIZE ||
+		header.width <= 0 || header.width > 0x7fff || header.height <= 0 || header.height > 0x7fff ||
+		header.npages < 1 || header.npages > FONS_MAX_PAGES || header.nfonts < 0)
+		goto error;
+	if (!fonsResetAtlas(stash, header.width, header.height)) goto error;
+
+	// From here on a damaged file leaves the atlas empty.
+	for (i = 0; i < header.npages; i++) {
+		FONSpage* page = i < stash->npages ? &stash->pages[i] : fons__addPage(stash);
+		if (page == NULL || !fons__atlasRestore(page->atlas, &ptr, end)) goto reset;
+		if (!fons__readCache(&ptr, end, page->texData, (size_t)header.width * header.height)) goto reset;
+		page->dirtyRect[0] = 0;
+		page->dirtyRect[1] = 0;
+		page->dirtyRect[2] = header.width;
+		page->dirtyRect[3] = header.height;
+	}
+
+	if (stash->nfonts > 0) {
+		keys = (unsigned long long*)FONS_MALLOC(sizeof(unsigned long long) * stash->nfonts);
+		if (keys == NULL) goto reset;
+		for (i = 0; i < stash->nfonts; i++)
+			keys[i] = fons__cacheKey(stash, stash->fonts[i]);
+	}
+	for (i = 0; i < header.nfonts; i++) {
+		FONSfont* font = NULL;
+		unsigned long long key;
+		int nglyphs;
+		if (!fons__readCache(&ptr, end, &key, sizeof(key)) || !fons__readCache(&ptr, end, &nglyphs, sizeof(int))) goto reset;
+		if (nglyphs < 0 || (size_t)(end - ptr) / sizeof(FONSglyph) < (size_t)nglyphs) goto reset;
+		// The glyphs of fonts that are gone keep their atlas space until it is evicted.
+		for (j = 0; j < stash->nfonts && font == NULL; j++) {
+			if (keys[j] == key && stash->fonts[j]->nglyphs == 0)
+				font = stash->fonts[j];
+		}
+		for (j = 0; j < nglyphs; j++) {
+			FONSglyph glyph, *dst;
+			fons__readCache(&ptr, end, &glyph, sizeof(glyph));
+			if (font == NULL)
+				continue;
+			if (glyph.x0 >= 0 || glyph.y0 >= 0) {
+				if (glyph.page < 0 || glyph.page >= stash->npages ||
+					glyph.x0 < 0 || glyph.x0 > glyph.x1 || glyph.x1 > header.width ||
+					glyph.y0 < 0 || glyph.y0 > glyph.y1 || glyph.y1 > header.height)
+					goto reset;
+			} else if (glyph.x0 != -1 || glyph.y0 != -1) {
+				goto reset;
+			}
+			if (!fons__growGlyphLut(font)) goto reset;
+			dst = fons__allocGlyph(font);
+			if (dst == NULL) goto reset;
+			*dst = glyph;
+			fons__insertGlyph(font, font->nglyphs-1);
+			nrestored++;
+		}
+	}
+
+	if (keys) FONS_FREE(keys);
+	fons__unmapFile(data, dataSize, mapped);
+	return nrestored;
+
+reset:
+	fonsResetAtlas(stash, header.width, header.height);
+error:
+	if (keys) FONS_FREE(keys);
+	fons__unmapFile(data, dataSize, mapped);
+	return 0;
+}
+
 
 #endif
@@ -21,6 +21,37 @@
 #include <math.h>
 #include <memory.h>
 
+#ifndef NVG_NO_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef NVG_PROFILE
+#include <time.h>
+static long long nvg__profileTicks(void);
+static void nvg__profileGlyphs(void* uptr, long long ticks);
+#define FONS_GLYPH_RASTER_BEGIN(stash) long long fonsRasterStart = nvg__profileTicks();
+#define FONS_GLYPH_RASTER_END(stash) nvg__profileGlyphs((stash)->params.userPtr, nvg__profileTicks() - fonsRasterStart);
+#endif
+
+// Memory allocation hooks, honoured by the core, fontstash and stb_image.
+// Define all three before compiling nanovg.c to plug in another allocator.
+// Font data passed to nvgCreateFontMem() with freeData set is released with NVG_FREE.
+#ifndef NVG_MALLOC
+#define NVG_MALLOC(sz) malloc(sz)
+#define NVG_REALLOC(p, sz) realloc(p, sz)
+#define NVG_FREE(p) free(p)
+#endif
+#define FONS_MALLOC(sz) NVG_MALLOC(sz)
+#define FONS_REALLOC(p, sz) NVG_REALLOC(p, sz)
+#define FONS_FREE(p) NVG_FREE(p)
+#ifdef NVG_NO_THREADS
+#define FONS_NO_THREADS
+#endif
+#define STBI_MALLOC(sz) NVG_MALLOC(sz)
+#define STBI_REALLOC(p, sz) NVG_REALLOC(p, sz)
+#define STBI_FREE(p) NVG_FREE(p)
+
 #include "nanovg.h"
 #define FONTSTASH_IMPLEMENTATION
 #include "fontstash.h"
@@ -37,14 +68,27 @@
 #define NVG_INIT_FONTIMAGE_SIZE  512
 #define NVG_MAX_FONTIMAGE_SIZE   2048
 #define NVG_MAX_FONTIMAGES       4
+#define NVG_MAX_RETIRED_FONTIMAGES (NVG_MAX_FONTIMAGES*4)
 
 #define NVG_INIT_COMMANDS_SIZE 256
 #define NVG_INIT_POINTS_SIZE 128
 #define NVG_INIT_PATHS_SIZE 16
 #define NVG_INIT_VERTS_SIZE 256
 #define NVG_MAX_STATES 32
-
-#define NVG_KAPPA90 0.5522847493f	// Length proportional to radius of a cubic bezier handle for 90deg arcs.
+#define NVG_RETAINED_MOVES 64	// Translations of retained geometry in place before it is flattened again.
+#define NVG_MAX_CURVE_SEGS 1024	// Upper limit of line segments per flattened curve.
+#define NVG_MAX_WORKERS 16		// Upper limit of threads used for threaded tessellation, including the caller.
+#define NVG_JOB_CHUNK 8			// Number of draw jobs a worker claims at a time.
+#define NVG_PARALLEL_GLYPHS 4	// Fewest pending glyphs worth waking the workers for.
+#define NVG_TEXT_RUNS 256		// Text runs whose glyph quads are kept between calls, must be a power of two.
+#define NVG_MAX_TEXT_RUN 256	// Longest string in bytes kept as a text run.
+#define NVG_GLYPH_OUTLINES 256	// Glyph outlines kept for text drawn as paths, must be a power of two.
+#ifndef NVG_OUTLINE_TEXT_SIZE
+#define NVG_OUTLINE_TEXT_SIZE 256.0f	// Default text size in device pixels above which glyphs are drawn as paths.
+#endif
+#ifndef NVG_SHRINK_FRAMES
+#define NVG_SHRINK_FRAMES 300	// Default number of frames after which oversized buffers are trimmed.
+#endif
 
 #define NVG_COUNTOF(arr) (sizeof(arr) / sizeof(0[arr]))
 
@@ -55,6 +99,8 @@ enum NVGcommands {
 	NVG_BEZIERTO = 2,
 	NVG_CLOSE = 3,
 	NVG_WINDING = 4,
+	NVG_QUADTO = 5,
+	NVG_ARCTO = 6,	// Elliptic arc c + u*cos(a) + v*sin(a): cx,cy, ux,uy, vx,vy, a0, da.
 };
 
 enum NVGpointFlags
@@ -106,29 +152,252 @@ struct NVGpathCache {
 	int nverts;
 	int cverts;
 	float bounds[4];
+	int peakPoints;		// Largest use since the buffers were last trimmed.
+	int peakPaths;
+	int peakVerts;
 };
 typedef struct NVGpathCache NVGpathCache;
 
+struct NVGretainedCache {
+	NVGpathCache* cache;
+	float xform[6];		// Transform the cached geometry was built with.
+	float tessTol;
+	float width;		// Parameters the cached vertices were expanded with.
+	float fringe;
+	int lineCap;
+	int lineJoin;
+	float miterLimit;
+	int flattened;
+	int expanded;
+	int moves;			// Translations applied in place since flattening.
+};
+typedef struct NVGretainedCache NVGretainedCache;
+
+struct NVGretainedPath {
+	float* commands;	// Untransformed, in the local space of the path.
+	int ncommands;
+	float bounds[4];	// Bounds of the commands in local space.
+	NVGretainedCache fill;
+	NVGretainedCache stroke;
+};
+typedef struct NVGretainedPath NVGretainedPath;
+
+enum NVGdrawJobType {
+	NVG_JOB_FILL,
+	NVG_JOB_STROKE,
+	NVG_JOB_TRIANGLES,
+	NVG_JOB_GLYPHS,
+};
+
+// Fill, stroke or triangles recorded for threaded tessellation. Text triangles and glyph instances
+// are recorded without it too, so that consecutive runs with the same state are drawn at once.
+struct NVGdrawJob {
+	int type;
+	NVGpaint paint;		// Global alpha already applied.
+	NVGcompositeOperationState compositeOperation;
+	NVGscissor scissor;
+	float fringe;		// Expansion fringe, 0 when antialiasing is off.
+	float strokeWidth;
+	int lineCap;
+	int lineJoin;
+	float miterLimit;
+	int first;			// Range of commands to tessellate, vertices of triangles or glyph instances.
+	int count;
+	int output;			// Index of the output holding the paths, -1 until tessellated.
+	int firstPath;
+	int npaths;
+	float bounds[4];
+};
+typedef struct NVGdrawJob NVGdrawJob;
+
+// Tessellated paths of one worker. Vertex pointers of the paths are stored as
+// offsets while the vertex array can still grow.
+struct NVGjobOutput {
+	NVGpathCache* cache;	// Scratch cache for tessellation.
+	NVGpath* paths;
+	int* offsets;			// Fill and stroke vertex offsets per path, -1 if none.
+	int npaths;
+	int cpaths;
+	NVGvertex* verts;
+	int nverts;
+	int cverts;
+	int peakPaths;
+	int peakVerts;
+};
+typedef struct NVGjobOutput NVGjobOutput;
+
+typedef void (*NVGworkerFunc)(NVGcontext* ctx, int worker);
+
+// Glyph quads of a string laid out with nvgText(), relative to the whole pixel of its origin.
+struct NVGtextRun {
+	unsigned int hash;
+	int generation;		// Atlas generation of the quads.
+	int font;
+	int align;
+	float size, spacing, blur;
+	float fx, fy;		// Fraction of the origin, glyphs are snapped to pixels.
+	float advance;
+	char* text;			// Copy of the string, the quads are stored after it.
+	int ntext;
+	FONSquad* quads;
+	int nquads;
+	int capacity;		// Bytes allocated for text and quads.
+};
+typedef struct NVGtextRun NVGtextRun;
+
+// Outline of a glyph as a retained path, in font units with y down.
+struct NVGglyphOutline {
+	int font;
+	int glyph;
+	NVGretainedPath* path;	// NULL if the slot is empty.
+};
+typedef struct NVGglyphOutline NVGglyphOutline;
+
+// Row of a text layout. Offsets are into the layout's copy of the string.
+struct NVGlayoutRow {
+	int start, end;
+	float width;
+	float minx, maxx;
+	int firstGlyph;
+	int nglyphs;
+};
+typedef struct NVGlayoutRow NVGlayoutRow;
+
+struct NVGtextLayout {
+	char* text;
+	int ntext;
+	float breakRowWidth;
+	// Text style and font scale the rows were broken with, font is FONS_INVALID until laid out.
+	int font;
+	int align;
+	float size, spacing, lineHeight, scale;
+	float lineh;			// Distance between rows.
+	float rminy, rmaxy;		// Vertical bounds of a row.
+	NVGlayoutRow* rows;
+	int nrows;
+	int crows;
+	NVGglyphPosition* glyphs;	// Positions relative to the start of their row.
+	int nglyphs;
+	int cglyphs;
+};
+typedef struct NVGtextLayout NVGtextLayout;
+
+// Stages timed when compiled with NVG_PROFILE. Glyphs are mostly rasterized at the end of the frame,
+// the few rasterized during text layout are not counted as layout.
+enum NVGprofileStage {
+	NVG_PROFILE_FLATTEN,
+	NVG_PROFILE_JOINS,
+	NVG_PROFILE_EXPAND,
+	NVG_PROFILE_TEXT,
+	NVG_PROFILE_GLYPHS,
+	NVG_PROFILE_STAGES
+};
+
+#ifdef NVG_PROFILE
+#define NVG_PROFILE_BEGIN(start) long long start = nvg__profileTicks()
+#define NVG_PROFILE_END(ctx, stage, start) nvg__profileAdd(ctx, stage, nvg__profileTicks() - (start))
+#else
+#define NVG_PROFILE_BEGIN(start)
+#define NVG_PROFILE_END(ctx, stage, start)
+#endif
+
+#ifndef NVG_NO_THREADS
+struct NVGworkerPool;
+
+struct NVGworkerArg {
+	struct NVGworkerPool* pool;
+	int index;
+};
+typedef struct NVGworkerArg NVGworkerArg;
+
+struct NVGworkerPool {
+	NVGcontext* ctx;
+	pthread_t threads[NVG_MAX_WORKERS];
+	NVGworkerArg args[NVG_MAX_WORKERS];
+	int nthreads;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	unsigned int generation;
+	int active;
+	int quit;
+	NVGworkerFunc func;
+};
+typedef struct NVGworkerPool NVGworkerPool;
+#endif
+
 struct NVGcontext {
 	NVGparams params;
 	float* commands;
 	int ccommands;
 	int ncommands;
+	int peakCommands;
 	float commandx, commandy;
+	float commandBounds[4];	// Bounds of the transformed commands, for culling.
+	float viewWidth, viewHeight;
 	NVGstate states[NVG_MAX_STATES];
 	int nstates;
 	NVGpathCache* cache;
+	NVGretainedPath** retainedPaths;
+	int nretainedPaths;
+	int cretainedPaths;
+	NVGtextLayout** textLayouts;
+	int ntextLayouts;
+	int ctextLayouts;
+	float* scratchCommands;
+	int cscratchCommands;
+	NVGdrawJob* jobs;
+	int njobs;
+	int cjobs;
+	int nextJob;
+	float* jobCommands;
+	int njobCommands;
+	int cjobCommands;
+	int pathJobCommands;	// Offset of the current path in jobCommands, -1 if not recorded yet.
+	NVGvertex* jobVerts;
+	int njobVerts;
+	int cjobVerts;
+	NVGglyphInstance* jobGlyphs;
+	int njobGlyphs;
+	int cjobGlyphs;
+	int peakJobs;
+	int peakJobCommands;
+	int peakJobVerts;
+	int peakJobGlyphs;
+	int shrinkFrames;		// Trim the per-frame buffers every this many frames, 0 to never trim.
+	int shrinkCounter;
+	NVGindex* fanIndices;	// Triangle fan as indexed triangles, shared by all fills.
+	int nfanVerts;
+	NVGjobOutput outputs[NVG_MAX_WORKERS];
+	int nworkers;
+#ifndef NVG_NO_THREADS
+	NVGworkerPool* pool;
+#endif
+#ifdef NVG_PROFILE
+	long long profileTime[NVG_PROFILE_STAGES];	// Nanoseconds spent per stage, summed over all threads.
+#endif
 	float tessTol;
 	float distTol;
 	float fringeWidth;
 	float devicePxRatio;
 	struct FONScontext* fs;
-	int fontImages[NVG_MAX_FONTIMAGES];
-	int fontImageIdx;
+	int nextGlyph;			// Next pending glyph claimed by a worker.
+	int fontImages[NVG_MAX_FONTIMAGES];	// One texture per font atlas page.
+	int retiredFontImages[NVG_MAX_RETIRED_FONTIMAGES];	// Replaced by a larger atlas, deleted at the end of the frame.
+	int nretiredFontImages;
 	int drawCallCount;
 	int fillTriCount;
 	int strokeTriCount;
 	int textTriCount;
+	int vertCount;
+	int commandCount;
+	int pointCount;
+	int glyphCount;			// Rasterized glyph count of the font stash at the start of the frame.
+	int atlasUploadBytes;
+	int culledCount;
+	NVGtextRun textRuns[NVG_TEXT_RUNS];
+	float outlineTextSize;
+	NVGglyphOutline glyphOutlines[NVG_GLYPH_OUTLINES];
 };
 
 static float nvg__sqrtf(float a) { return sqrtf(a); }
@@ -149,6 +418,20 @@ static float nvg__signf(float a) { return a >= 0.0f ? 1.0f : -1.0f; }
 static float nvg__clampf(float a, float mn, float mx) { return a < mn ? mn : (a > mx ? mx : a); }
 static float nvg__cross(float dx0, float dy0, float dx1, float dy1) { return dx1*dy0 - dx0*dy1; }
 
+static void nvg__clearBounds(float* bounds)
+{
+	bounds[0] = bounds[1] = 1e6f;
+	bounds[2] = bounds[3] = -1e6f;
+}
+
+static void nvg__addBounds(float* bounds, float minx, float miny, float maxx, float maxy)
+{
+	bounds[0] = nvg__minf(bounds[0], minx);
+	bounds[1] = nvg__minf(bounds[1], miny);
+	bounds[2] = nvg__maxf(bounds[2], maxx);
+	bounds[3] = nvg__maxf(bounds[3], maxy);
+}
+
 static float nvg__normalize(float *x, float* y)
 {
 	float d = nvg__sqrtf((*x)*(*x) + (*y)*(*y));
@@ -164,29 +447,47 @@ static float nvg__normalize(float *x, float* y)
 static void nvg__deletePathCache(NVGpathCache* c)
 {
 	if (c == NULL) return;
-	if (c->points != NULL) free(c->points);
-	if (c->paths != NULL) free(c->paths);
-	if (c->verts != NULL) free(c->verts);
-	free(c);
+	if (c->points != NULL) NVG_FREE(c->points);
+	if (c->paths != NULL) NVG_FREE(c->paths);
+	if (c->verts != NULL) NVG_FREE(c->verts);
+	NVG_FREE(c);
+}
+
+static void nvg__deleteRetainedPath(NVGretainedPath* path)
+{
+	if (path == NULL) return;
+	if (path->commands != NULL) NVG_FREE(path->commands);
+	nvg__deletePathCache(path->fill.cache);
+	nvg__deletePathCache(path->stroke.cache);
+	NVG_FREE(path);
+}
+
+static void nvg__deleteTextLayout(NVGtextLayout* layout)
+{
+	if (layout == NULL) return;
+	if (layout->text != NULL) NVG_FREE(layout->text);
+	if (layout->rows != NULL) NVG_FREE(layout->rows);
+	if (layout->glyphs != NULL) NVG_FREE(layout->glyphs);
+	NVG_FREE(layout);
 }
 
 static NVGpathCache* nvg__allocPathCache(void)
 {
-	NVGpathCache* c = (NVGpathCache*)malloc(sizeof(NVGpathCache));
+	NVGpathCache* c = (NVGpathCache*)NVG_MALLOC(sizeof(NVGpathCache));
 	if (c == NULL) goto error;
 	memset(c, 0, sizeof(NVGpathCache));
 
-	c->points = (NVGpoint*)malloc(sizeof(NVGpoint)*NVG_INIT_POINTS_SIZE);
+	c->points = (NVGpoint*)NVG_MALLOC(sizeof(NVGpoint)*NVG_INIT_POINTS_SIZE);
 	if (!c->points) goto error;
 	c->npoints = 0;
 	c->cpoints = NVG_INIT_POINTS_SIZE;
 
-	c->paths = (NVGpath*)malloc(sizeof(NVGpath)*NVG_INIT_PATHS_SIZE);
+	c->paths = (NVGpath*)NVG_MALLOC(sizeof(NVGpath)*NVG_INIT_PATHS_SIZE);
 	if (!c->paths) goto error;
 	c->npaths = 0;
 	c->cpaths = NVG_INIT_PATHS_SIZE;
 
-	c->verts = (NVGvertex*)malloc(sizeof(NVGvertex)*NVG_INIT_VERTS_SIZE);
+	c->verts = (NVGvertex*)NVG_MALLOC(sizeof(NVGvertex)*NVG_INIT_VERTS_SIZE);
 	if (!c->verts) goto error;
 	c->nverts = 0;
 	c->cverts = NVG_INIT_VERTS_SIZE;
@@ -283,10 +584,155 @@ static NVGstate* nvg__getState(NVGcontext* ctx)
 	return &ctx->states[ctx->nstates-1];
 }
 
+static void nvg__deleteJobOutput(NVGjobOutput* out)
+{
+	nvg__deletePathCache(out->cache);
+	if (out->paths != NULL) NVG_FREE(out->paths);
+	if (out->offsets != NULL) NVG_FREE(out->offsets);
+	if (out->verts != NULL) NVG_FREE(out->verts);
+	memset(out, 0, sizeof(*out));
+}
+
+// Worker pool
+#ifndef NVG_NO_THREADS
+static int nvg__atomicAdd(int* value, int n)
+{
+	return __atomic_fetch_add(value, n, __ATOMIC_RELAXED);
+}
+
+static void* nvg__workerMain(void* arg)
+{
+	NVGworkerArg* worker = (NVGworkerArg*)arg;
+	NVGworkerPool* pool = worker->pool;
+	unsigned int generation = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (pool->generation == generation && !pool->quit)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		if (pool->quit)
+			break;
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		pool->func(pool->ctx, worker->index);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->active == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+static void nvg__deleteWorkerPool(NVGworkerPool* pool)
+{
+	int i;
+	if (pool == NULL) return;
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->nthreads; i++)
+		pthread_join(pool->threads[i], NULL);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	NVG_FREE(pool);
+}
+
+// Starts one thread per CPU, minus the calling thread which works too.
+static NVGworkerPool* nvg__createWorkerPool(NVGcontext* ctx)
+{
+	NVGworkerPool* pool;
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	int i, nthreads = nvg__clampi((int)ncpu, 1, NVG_MAX_WORKERS) - 1;
+
+	if (nthreads <= 0) return NULL;
+
+	pool = (NVGworkerPool*)NVG_MALLOC(sizeof(NVGworkerPool));
+	if (pool == NULL) return NULL;
+	memset(pool, 0, sizeof(NVGworkerPool));
+	pool->ctx = ctx;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		pool->args[i].pool = pool;
+		pool->args[i].index = i+1;
+		if (pthread_create(&pool->threads[i], NULL, nvg__workerMain, &pool->args[i]) != 0)
+			break;
+		pool->nthreads++;
+	}
+	if (pool->nthreads == 0) {
+		nvg__deleteWorkerPool(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+#else
+static int nvg__atomicAdd(int* value, int n)
+{
+	int old = *value;
+	*value += n;
+	return old;
+}
+#endif
+
+#ifdef NVG_PROFILE
+static long long nvg__profileTicks(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void nvg__profileAdd(NVGcontext* ctx, int stage, long long ticks)
+{
+#ifndef NVG_NO_THREADS
+	__atomic_fetch_add(&ctx->profileTime[stage], ticks, __ATOMIC_RELAXED);
+#else
+	ctx->profileTime[stage] += ticks;
+#endif
+}
+
+static void nvg__profileGlyphs(void* uptr, long long ticks)
+{
+	nvg__profileAdd((NVGcontext*)uptr, NVG_PROFILE_GLYPHS, ticks);
+}
+#endif
+
+// Runs func on every worker, including the calling thread as worker 0, and waits until all are done.
+static void nvg__runWorkers(NVGcontext* ctx, NVGworkerFunc func)
+{
+#ifndef NVG_NO_THREADS
+	NVGworkerPool* pool = ctx->pool;
+	if (pool != NULL) {
+		pthread_mutex_lock(&pool->lock);
+		pool->func = func;
+		pool->active = pool->nthreads;
+		pool->generation++;
+		pthread_cond_broadcast(&pool->wake);
+		pthread_mutex_unlock(&pool->lock);
+
+		func(ctx, 0);
+
+		pthread_mutex_lock(&pool->lock);
+		while (pool->active > 0)
+			pthread_cond_wait(&pool->done, &pool->lock);
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+#endif
+	func(ctx, 0);
+}
+
 NVGcontext* nvgCreateInternal(NVGparams* params)
 {
 	FONSparams fontParams;
-	NVGcontext* ctx = (NVGcontext*)malloc(sizeof(NVGcontext));
+	NVGcontext* ctx = (NVGcontext*)NVG_MALLOC(sizeof(NVGcontext));
 	int i;
 	if (ctx == NULL) goto error;
 	memset(ctx, 0, sizeof(NVGcontext));
@@ -295,14 +741,27 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 	for (i = 0; i < NVG_MAX_FONTIMAGES; i++)
 		ctx->fontImages[i] = 0;
 
-	ctx->commands = (float*)malloc(sizeof(float)*NVG_INIT_COMMANDS_SIZE);
+	ctx->commands = (float*)NVG_MALLOC(sizeof(float)*NVG_INIT_COMMANDS_SIZE);
 	if (!ctx->commands) goto error;
 	ctx->ncommands = 0;
 	ctx->ccommands = NVG_INIT_COMMANDS_SIZE;
+	ctx->shrinkFrames = NVG_SHRINK_FRAMES;
+	ctx->outlineTextSize = NVG_OUTLINE_TEXT_SIZE;
+	nvg__clearBounds(ctx->commandBounds);
 
 	ctx->cache = nvg__allocPathCache();
 	if (ctx->cache == NULL) goto error;
 
+	ctx->nworkers = 1;
+	ctx->pathJobCommands = -1;
+#ifndef NVG_NO_THREADS
+	if (ctx->params.threadedTessellation) {
+		ctx->pool = nvg__createWorkerPool(ctx);
+		if (ctx->pool != NULL)
+			ctx->nworkers = ctx->pool->nthreads + 1;
+	}
+#endif
+
 	nvgSave(ctx);
 	nvgReset(ctx);
 
@@ -316,19 +775,19 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 	memset(&fontParams, 0, sizeof(fontParams));
 	fontParams.width = NVG_INIT_FONTIMAGE_SIZE;
 	fontParams.height = NVG_INIT_FONTIMAGE_SIZE;
-	fontParams.flags = FONS_ZERO_TOPLEFT;
+	fontParams.flags = FONS_ZERO_TOPLEFT | FONS_DEFER_GLYPHS | (ctx->params.sdfText ? FONS_SDF : 0);
+	fontParams.maxPages = NVG_MAX_FONTIMAGES;
 	fontParams.renderCreate = NULL;
 	fontParams.renderUpdate = NULL;
 	fontParams.renderDraw = NULL;
 	fontParams.renderDelete = NULL;
-	fontParams.userPtr = NULL;
+	fontParams.userPtr = ctx;
 	ctx->fs = fonsCreateInternal(&fontParams);
 	if (ctx->fs == NULL) goto error;
 
 	// Create font texture
-	ctx->fontImages[0] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, fontParams.width, fontParams.height, 0, NULL);
+	ctx->fontImages[0] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, fontParams.width, fontParams.height, ctx->params.sdfText ? NVG_IMAGE_SDF : 0, NULL);
 	if (ctx->fontImages[0] == 0) goto error;
-	ctx->fontImageIdx = 0;
 
 	return ctx;
 
@@ -346,9 +805,33 @@ void nvgDeleteInternal(NVGcontext* ctx)
 {
 	int i;
 	if (ctx == NULL) return;
-	if (ctx->commands != NULL) free(ctx->commands);
+	if (ctx->commands != NULL) NVG_FREE(ctx->commands);
 	if (ctx->cache != NULL) nvg__deletePathCache(ctx->cache);
 
+	for (i = 0; i < ctx->nretainedPaths; i++)
+		nvg__deleteRetainedPath(ctx->retainedPaths[i]);
+	if (ctx->retainedPaths != NULL) NVG_FREE(ctx->retainedPaths);
+	for (i = 0; i < ctx->ntextLayouts; i++)
+		nvg__deleteTextLayout(ctx->textLayouts[i]);
+	if (ctx->textLayouts != NULL) NVG_FREE(ctx->textLayouts);
+	if (ctx->scratchCommands != NULL) NVG_FREE(ctx->scratchCommands);
+
+#ifndef NVG_NO_THREADS
+	nvg__deleteWorkerPool(ctx->pool);
+#endif
+	for (i = 0; i < NVG_MAX_WORKERS; i++)
+		nvg__deleteJobOutput(&ctx->outputs[i]);
+	if (ctx->jobs != NULL) NVG_FREE(ctx->jobs);
+	if (ctx->jobCommands != NULL) NVG_FREE(ctx->jobCommands);
+	if (ctx->jobVerts != NULL) NVG_FREE(ctx->jobVerts);
+	if (ctx->jobGlyphs != NULL) NVG_FREE(ctx->jobGlyphs);
+	if (ctx->fanIndices != NULL) NVG_FREE(ctx->fanIndices);
+	for (i = 0; i < NVG_TEXT_RUNS; i++) {
+		if (ctx->textRuns[i].text != NULL) NVG_FREE(ctx->textRuns[i].text);
+	}
+	for (i = 0; i < NVG_GLYPH_OUTLINES; i++)
+		nvg__deleteRetainedPath(ctx->glyphOutlines[i].path);
+
 	if (ctx->fs)
 		fonsDeleteInternal(ctx->fs);
 
@@ -358,18 +841,23 @@ void nvgDeleteInternal(NVGcontext* ctx)
 			ctx->fontImages[i] = 0;
 		}
 	}
+	for (i = 0; i < ctx->nretiredFontImages; i++)
+		nvgDeleteImage(ctx, ctx->retiredFontImages[i]);
 
 	if (ctx->params.renderDelete != NULL)
 		ctx->params.renderDelete(ctx->params.userPtr);
 
-	free(ctx);
+	NVG_FREE(ctx);
 }
 
+static void nvg__shrinkBuffers(NVGcontext* ctx);
+
 void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float devicePixelRatio)
 {
-/*	printf("Tris: draws:%d  fill:%d  stroke:%d  text:%d  TOT:%d\n",
-		ctx->drawCallCount, ctx->fillTriCount, ctx->strokeTriCount, ctx->textTriCount,
-		ctx->fillTriCount+ctx->strokeTriCount+ctx->textTriCount);*/
+	if (ctx->shrinkFrames > 0 && ++ctx->shrinkCounter >= ctx->shrinkFrames) {
+		nvg__shrinkBuffers(ctx);
+		ctx->shrinkCounter = 0;
+	}
 
 	ctx->nstates = 0;
 	nvgSave(ctx);
@@ -378,46 +866,84 @@ void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float
 	nvg__setDevicePixelRatio(ctx, devicePixelRatio);
 
 	ctx->params.renderViewport(ctx->params.userPtr, windowWidth, windowHeight, devicePixelRatio);
+	ctx->viewWidth = windowWidth;
+	ctx->viewHeight = windowHeight;
+
+	// Glyphs used from here on are kept in the atlas until the frame is drawn.
+	fonsAdvanceFrame(ctx->fs);
 
 	ctx->drawCallCount = 0;
 	ctx->fillTriCount = 0;
 	ctx->strokeTriCount = 0;
 	ctx->textTriCount = 0;
+	ctx->vertCount = 0;
+	ctx->commandCount = 0;
+	ctx->pointCount = 0;
+	ctx->glyphCount = fonsGetRasterizedGlyphCount(ctx->fs);
+	ctx->atlasUploadBytes = 0;
+	ctx->culledCount = 0;
+#ifdef NVG_PROFILE
+	memset(ctx->profileTime, 0, sizeof(ctx->profileTime));
+#endif
+}
+
+void nvgGetFrameStats(NVGcontext* ctx, NVGframeStats* stats)
+{
+	int i;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->drawCalls = ctx->drawCallCount;
+	stats->fillTriangles = ctx->fillTriCount;
+	stats->strokeTriangles = ctx->strokeTriCount;
+	stats->textTriangles = ctx->textTriCount;
+	stats->vertexBytes = ctx->vertCount * (int)sizeof(NVGvertex);
+	stats->commands = ctx->commandCount;
+	stats->points = ctx->pointCount;
+	stats->glyphsRasterized = fonsGetRasterizedGlyphCount(ctx->fs) - ctx->glyphCount;
+	stats->atlasUploadBytes = ctx->atlasUploadBytes;
+	stats->culledDraws = ctx->culledCount;
+
+	// Current capacities, oversized buffers are trimmed after idle frames.
+	stats->commandsCapacity = ctx->ccommands;
+	stats->pointsCapacity = ctx->cache->cpoints;
+	stats->pathsCapacity = ctx->cache->cpaths;
+	stats->vertsCapacity = ctx->cache->cverts;
+	for (i = 0; i < ctx->nworkers; i++) {
+		NVGpathCache* cache = ctx->outputs[i].cache;
+		if (cache == NULL) continue;
+		stats->pointsCapacity = nvg__maxi(stats->pointsCapacity, cache->cpoints);
+		stats->pathsCapacity = nvg__maxi(stats->pathsCapacity, cache->cpaths);
+		stats->vertsCapacity = nvg__maxi(stats->vertsCapacity, cache->cverts);
+	}
+
+#ifdef NVG_PROFILE
+	stats->flattenTime = ctx->profileTime[NVG_PROFILE_FLATTEN] * 1e-9f;
+	stats->joinsTime = ctx->profileTime[NVG_PROFILE_JOINS] * 1e-9f;
+	stats->expandTime = ctx->profileTime[NVG_PROFILE_EXPAND] * 1e-9f;
+	stats->textTime = ctx->profileTime[NVG_PROFILE_TEXT] * 1e-9f;
+	stats->glyphTime = ctx->profileTime[NVG_PROFILE_GLYPHS] * 1e-9f;
+#endif
 }
 
+static void nvg__clearJobs(NVGcontext* ctx);
+static void nvg__flushJobs(NVGcontext* ctx);
+static void nvg__flushTextTexture(NVGcontext* ctx);
+
 void nvgCancelFrame(NVGcontext* ctx)
 {
+	nvg__clearJobs(ctx);
 	ctx->params.renderCancel(ctx->params.userPtr);
 }
 
 void nvgEndFrame(NVGcontext* ctx)
 {
+	// One upload per atlas page for all text of the frame.
+	nvg__flushTextTexture(ctx);
+	nvg__flushJobs(ctx);
 	ctx->params.renderFlush(ctx->params.userPtr);
-	if (ctx->fontImageIdx != 0) {
-		int fontImage = ctx->fontImages[ctx->fontImageIdx];
-		int i, j, iw, ih;
-		// delete images that smaller than current one
-		if (fontImage == 0)
-			return;
-		nvgImageSize(ctx, fontImage, &iw, &ih);
-		for (i = j = 0; i < ctx->fontImageIdx; i++) {
-			if (ctx->fontImages[i] != 0) {
-				int nw, nh;
-				nvgImageSize(ctx, ctx->fontImages[i], &nw, &nh);
-				if (nw < iw || nh < ih)
-					nvgDeleteImage(ctx, ctx->fontImages[i]);
-				else
-					ctx->fontImages[j++] = ctx->fontImages[i];
-			}
-		}
-		// make current font image to first
-		ctx->fontImages[j++] = ctx->fontImages[0];
-		ctx->fontImages[0] = fontImage;
-		ctx->fontImageIdx = 0;
-		// clear all images after j
-		for (i = j; i < NVG_MAX_FONTIMAGES; i++)
-			ctx->fontImages[i] = 0;
-	}
+	// delete font images the atlas has outgrown
+	while (ctx->nretiredFontImages > 0)
+		nvgDeleteImage(ctx, ctx->retiredFontImages[--ctx->nretiredFontImages]);
 }
 
 NVGcolor nvgRGB(unsigned char r, unsigned char g, unsigned char b)
@@ -1071,44 +1597,90 @@ static float nvg__distPtSeg(float x, float y, float px, float py, float qx, floa
 	return dx*dx + dy*dy;
 }
 
-static void nvg__appendCommands(NVGcontext* ctx, float* vals, int nvals)
+static void nvg__transformVector(float* dx, float* dy, const float* t, float sx, float sy)
 {
-	NVGstate* state = nvg__getState(ctx);
-	int i;
-
-	if (ctx->ncommands+nvals > ctx->ccommands) {
-		float* commands;
-		int ccommands = ctx->ncommands+nvals + ctx->ccommands/2;
-		commands = (float*)realloc(ctx->commands, sizeof(float)*ccommands);
-		if (commands == NULL) return;
-		ctx->commands = commands;
-		ctx->ccommands = ccommands;
-	}
-
-	if ((int)vals[0] != NVG_CLOSE && (int)vals[0] != NVG_WINDING) {
-		ctx->commandx = vals[nvals-2];
-		ctx->commandy = vals[nvals-1];
-	}
+	*dx = sx*t[0] + sy*t[2];
+	*dy = sx*t[1] + sy*t[3];
+}
 
-	// transform commands
-	i = 0;
-	while (i < nvals) {
-		int cmd = (int)vals[i];
+// Returns the number of commands transformed.
+static int nvg__transformCommands(float* dst, const float* src, int n, const float* xform)
+{
+	int i = 0, count = 0;
+	while (i < n) {
+		int cmd = (int)src[i];
+		dst[i] = src[i];
+		count++;
 		switch (cmd) {
 		case NVG_MOVETO:
-			nvgTransformPoint(&vals[i+1],&vals[i+2], state->xform, vals[i+1],vals[i+2]);
+		case NVG_LINETO:
+			nvgTransformPoint(&dst[i+1],&dst[i+2], xform, src[i+1],src[i+2]);
 			i += 3;
 			break;
+		case NVG_BEZIERTO:
+			nvgTransformPoint(&dst[i+1],&dst[i+2], xform, src[i+1],src[i+2]);
+			nvgTransformPoint(&dst[i+3],&dst[i+4], xform, src[i+3],src[i+4]);
+			nvgTransformPoint(&dst[i+5],&dst[i+6], xform, src[i+5],src[i+6]);
+			i += 7;
+			break;
+		case NVG_QUADTO:
+			nvgTransformPoint(&dst[i+1],&dst[i+2], xform, src[i+1],src[i+2]);
+			nvgTransformPoint(&dst[i+3],&dst[i+4], xform, src[i+3],src[i+4]);
+			i += 5;
+			break;
+		case NVG_ARCTO:
+			// Center is a point, the axes are vectors.
+			nvgTransformPoint(&dst[i+1],&dst[i+2], xform, src[i+1],src[i+2]);
+			nvg__transformVector(&dst[i+3],&dst[i+4], xform, src[i+3],src[i+4]);
+			nvg__transformVector(&dst[i+5],&dst[i+6], xform, src[i+5],src[i+6]);
+			dst[i+7] = src[i+7];
+			dst[i+8] = src[i+8];
+			i += 9;
+			break;
+		case NVG_CLOSE:
+			i++;
+			break;
+		case NVG_WINDING:
+			dst[i+1] = src[i+1];
+			i += 2;
+			break;
+		default:
+			i++;
+		}
+	}
+	return count;
+}
+
+// Grows the bounds to contain the commands. Curves are bounded by their control
+// points, and arcs by the bounds of the whole ellipse.
+static void nvg__commandBounds(float* bounds, const float* commands, int n)
+{
+	int i = 0, j;
+	while (i < n) {
+		int cmd = (int)commands[i];
+		switch (cmd) {
+		case NVG_MOVETO:
 		case NVG_LINETO:
-			nvgTransformPoint(&vals[i+1],&vals[i+2], state->xform, vals[i+1],vals[i+2]);
+			nvg__addBounds(bounds, commands[i+1], commands[i+2], commands[i+1], commands[i+2]);
 			i += 3;
 			break;
 		case NVG_BEZIERTO:
-			nvgTransformPoint(&vals[i+1],&vals[i+2], state->xform, vals[i+1],vals[i+2]);
-			nvgTransformPoint(&vals[i+3],&vals[i+4], state->xform, vals[i+3],vals[i+4]);
-			nvgTransformPoint(&vals[i+5],&vals[i+6], state->xform, vals[i+5],vals[i+6]);
+			for (j = 1; j < 7; j += 2)
+				nvg__addBounds(bounds, commands[i+j], commands[i+j+1], commands[i+j], commands[i+j+1]);
 			i += 7;
 			break;
+		case NVG_QUADTO:
+			for (j = 1; j < 5; j += 2)
+				nvg__addBounds(bounds, commands[i+j], commands[i+j+1], commands[i+j], commands[i+j+1]);
+			i += 5;
+			break;
+		case NVG_ARCTO: {
+			float ex = nvg__sqrtf(commands[i+3]*commands[i+3] + commands[i+5]*commands[i+5]);
+			float ey = nvg__sqrtf(commands[i+4]*commands[i+4] + commands[i+6]*commands[i+6]);
+			nvg__addBounds(bounds, commands[i+1]-ex, commands[i+2]-ey, commands[i+1]+ex, commands[i+2]+ey);
+			i += 9;
+			break;
+		}
 		case NVG_CLOSE:
 			i++;
 			break;
@@ -1119,10 +1691,68 @@ static void nvg__appendCommands(NVGcontext* ctx, float* vals, int nvals)
 			i++;
 		}
 	}
+}
+
+// Transforms the bounds and returns the axis aligned bounds of the result.
+static void nvg__transformBounds(float* dst, const float* src, const float* xform)
+{
+	float cx = (src[0] + src[2]) * 0.5f, cy = (src[1] + src[3]) * 0.5f;
+	float ex = (src[2] - src[0]) * 0.5f, ey = (src[3] - src[1]) * 0.5f;
+	float tex = ex*nvg__absf(xform[0]) + ey*nvg__absf(xform[2]);
+	float tey = ex*nvg__absf(xform[1]) + ey*nvg__absf(xform[3]);
+	nvgTransformPoint(&cx, &cy, xform, cx, cy);
+	dst[0] = cx - tex;
+	dst[1] = cy - tey;
+	dst[2] = cx + tex;
+	dst[3] = cy + tey;
+}
+
+// Returns 1 if the bounds in window space, grown by pad, overlap the viewport and the current scissor.
+static int nvg__boundsVisible(NVGcontext* ctx, const float* bounds, float pad)
+{
+	NVGscissor* scissor = &nvg__getState(ctx)->scissor;
+	float minx = bounds[0] - pad, miny = bounds[1] - pad;
+	float maxx = bounds[2] + pad, maxy = bounds[3] + pad;
+
+	if (maxx < 0.0f || maxy < 0.0f || minx > ctx->viewWidth || miny > ctx->viewHeight)
+		return 0;
+
+	if (scissor->extent[0] >= 0.0f) {
+		float ex = scissor->extent[0]*nvg__absf(scissor->xform[0]) + scissor->extent[1]*nvg__absf(scissor->xform[2]);
+		float ey = scissor->extent[0]*nvg__absf(scissor->xform[1]) + scissor->extent[1]*nvg__absf(scissor->xform[3]);
+		if (maxx < scissor->xform[4]-ex || maxy < scissor->xform[5]-ey ||
+			minx > scissor->xform[4]+ex || miny > scissor->xform[5]+ey)
+			return 0;
+	}
+
+	return 1;
+}
+
+static void nvg__appendCommands(NVGcontext* ctx, float* vals, int nvals)
+{
+	NVGstate* state = nvg__getState(ctx);
+
+	if (ctx->ncommands+nvals > ctx->ccommands) {
+		float* commands;
+		int ccommands = ctx->ncommands+nvals + ctx->ccommands/2;
+		commands = (float*)NVG_REALLOC(ctx->commands, sizeof(float)*ccommands);
+		if (commands == NULL) return;
+		ctx->commands = commands;
+		ctx->ccommands = ccommands;
+	}
 
-	memcpy(&ctx->commands[ctx->ncommands], vals, nvals*sizeof(float));
+	if ((int)vals[0] != NVG_CLOSE && (int)vals[0] != NVG_WINDING) {
+		ctx->commandx = vals[nvals-2];
+		ctx->commandy = vals[nvals-1];
+	}
+
+	// transform commands
+	ctx->commandCount += nvg__transformCommands(&ctx->commands[ctx->ncommands], vals, nvals, state->xform);
+	nvg__commandBounds(ctx->commandBounds, &ctx->commands[ctx->ncommands], nvals);
+	ctx->pathJobCommands = -1;
 
 	ctx->ncommands += nvals;
+	ctx->peakCommands = nvg__maxi(ctx->peakCommands, ctx->ncommands);
 }
 
 
@@ -1132,105 +1762,139 @@ static void nvg__clearPathCache(NVGcontext* ctx)
 	ctx->cache->npaths = 0;
 }
 
-static NVGpath* nvg__lastPath(NVGcontext* ctx)
+static NVGpath* nvg__lastPath(NVGpathCache* cache)
 {
-	if (ctx->cache->npaths > 0)
-		return &ctx->cache->paths[ctx->cache->npaths-1];
+	if (cache->npaths > 0)
+		return &cache->paths[cache->npaths-1];
 	return NULL;
 }
 
-static void nvg__addPath(NVGcontext* ctx)
+static void nvg__addPath(NVGpathCache* cache)
 {
 	NVGpath* path;
-	if (ctx->cache->npaths+1 > ctx->cache->cpaths) {
+	if (cache->npaths+1 > cache->cpaths) {
 		NVGpath* paths;
-		int cpaths = ctx->cache->npaths+1 + ctx->cache->cpaths/2;
-		paths = (NVGpath*)realloc(ctx->cache->paths, sizeof(NVGpath)*cpaths);
+		int cpaths = cache->npaths+1 + cache->cpaths/2;
+		paths = (NVGpath*)NVG_REALLOC(cache->paths, sizeof(NVGpath)*cpaths);
 		if (paths == NULL) return;
-		ctx->cache->paths = paths;
-		ctx->cache->cpaths = cpaths;
+		cache->paths = paths;
+		cache->cpaths = cpaths;
 	}
-	path = &ctx->cache->paths[ctx->cache->npaths];
+	path = &cache->paths[cache->npaths];
 	memset(path, 0, sizeof(*path));
-	path->first = ctx->cache->npoints;
+	path->first = cache->npoints;
 	path->winding = NVG_CCW;
 
-	ctx->cache->npaths++;
+	cache->npaths++;
 }
 
-static NVGpoint* nvg__lastPoint(NVGcontext* ctx)
+static NVGpoint* nvg__lastPoint(NVGpathCache* cache)
 {
-	if (ctx->cache->npoints > 0)
-		return &ctx->cache->points[ctx->cache->npoints-1];
+	if (cache->npoints > 0)
+		return &cache->points[cache->npoints-1];
 	return NULL;
 }
 
-static void nvg__addPoint(NVGcontext* ctx, float x, float y, int flags)
+static int nvg__reservePoints(NVGpathCache* cache, int n)
+{
+	if (cache->npoints+n > cache->cpoints) {
+		NVGpoint* points;
+		int cpoints = cache->npoints+n + cache->cpoints/2;
+		points = (NVGpoint*)NVG_REALLOC(cache->points, sizeof(NVGpoint)*cpoints);
+		if (points == NULL) return 0;
+		cache->points = points;
+		cache->cpoints = cpoints;
+	}
+	return 1;
+}
+
+// Appends n points, written past the end of the reserved point array, to the last path.
+// Points too close to their predecessor are merged like in nvg__addPoint().
+static void nvg__commitPoints(NVGcontext* ctx, NVGpathCache* cache, int n)
+{
+	NVGpath* path = nvg__lastPath(cache);
+	NVGpoint* pts = &cache->points[cache->npoints];
+	NVGpoint* last = NULL;
+	int i, count = 0;
+	if (path == NULL) return;
+
+	if (path->count > 0 && cache->npoints > 0)
+		last = &pts[-1];
+	for (i = 0; i < n; i++) {
+		if (last != NULL && nvg__ptEquals(last->x,last->y, pts[i].x,pts[i].y, ctx->distTol)) {
+			last->flags |= pts[i].flags;
+			continue;
+		}
+		last = &pts[count++];
+		last->x = pts[i].x;
+		last->y = pts[i].y;
+		last->flags = pts[i].flags;
+	}
+
+	cache->npoints += count;
+	path->count += count;
+}
+
+static void nvg__addPoint(NVGcontext* ctx, NVGpathCache* cache, float x, float y, int flags)
 {
-	NVGpath* path = nvg__lastPath(ctx);
+	NVGpath* path = nvg__lastPath(cache);
 	NVGpoint* pt;
 	if (path == NULL) return;
 
-	if (path->count > 0 && ctx->cache->npoints > 0) {
-		pt = nvg__lastPoint(ctx);
+	if (path->count > 0 && cache->npoints > 0) {
+		pt = nvg__lastPoint(cache);
 		if (nvg__ptEquals(pt->x,pt->y, x,y, ctx->distTol)) {
 			pt->flags |= flags;
 			return;
 		}
 	}
 
-	if (ctx->cache->npoints+1 > ctx->cache->cpoints) {
-		NVGpoint* points;
-		int cpoints = ctx->cache->npoints+1 + ctx->cache->cpoints/2;
-		points = (NVGpoint*)realloc(ctx->cache->points, sizeof(NVGpoint)*cpoints);
-		if (points == NULL) return;
-		ctx->cache->points = points;
-		ctx->cache->cpoints = cpoints;
-	}
+	if (!nvg__reservePoints(cache, 1)) return;
 
-	pt = &ctx->cache->points[ctx->cache->npoints];
+	pt = &cache->points[cache->npoints];
 	memset(pt, 0, sizeof(*pt));
 	pt->x = x;
 	pt->y = y;
 	pt->flags = (unsigned char)flags;
 
-	ctx->cache->npoints++;
+	cache->npoints++;
 	path->count++;
 }
 
-static void nvg__closePath(NVGcontext* ctx)
+static void nvg__closePath(NVGpathCache* cache)
 {
-	NVGpath* path = nvg__lastPath(ctx);
+	NVGpath* path = nvg__lastPath(cache);
 	if (path == NULL) return;
 	path->closed = 1;
 }
 
-static void nvg__pathWinding(NVGcontext* ctx, int winding)
+static void nvg__pathWinding(NVGpathCache* cache, int winding)
 {
-	NVGpath* path = nvg__lastPath(ctx);
+	NVGpath* path = nvg__lastPath(cache);
 	if (path == NULL) return;
 	path->winding = winding;
 }
 
-static float nvg__getAverageScale(float *t)
+static float nvg__getAverageScale(const float *t)
 {
 	float sx = sqrtf(t[0]*t[0] + t[2]*t[2]);
 	float sy = sqrtf(t[1]*t[1] + t[3]*t[3]);
 	return (sx + sy) * 0.5f;
 }
 
-static NVGvertex* nvg__allocTempVerts(NVGcontext* ctx, int nverts)
+static NVGvertex* nvg__allocTempVerts(NVGpathCache* cache, int nverts)
 {
-	if (nverts > ctx->cache->cverts) {
+	if (nverts > cache->cverts) {
 		NVGvertex* verts;
 		int cverts = (nverts + 0xff) & ~0xff; // Round up to prevent allocations when things change just slightly.
-		verts = (NVGvertex*)realloc(ctx->cache->verts, sizeof(NVGvertex)*cverts);
+		verts = (NVGvertex*)NVG_REALLOC(cache->verts, sizeof(NVGvertex)*cverts);
 		if (verts == NULL) return NULL;
-		ctx->cache->verts = verts;
-		ctx->cache->cverts = cverts;
+		cache->verts = verts;
+		cache->cverts = cverts;
 	}
+	cache->peakVerts = nvg__maxi(cache->peakVerts, nverts);
 
-	return ctx->cache->verts;
+	return cache->verts;
 }
 
 static float nvg__triarea2(float ax, float ay, float bx, float by, float cx, float cy)
@@ -1277,99 +1941,237 @@ static void nvg__vset(NVGvertex* vtx, float x, float y, float u, float v)
 	vtx->v = v;
 }
 
-static void nvg__tesselateBezier(NVGcontext* ctx,
+static int nvg__curveDivs(float r, float arc, float tol)
+{
+	float da = acosf(r / (r + tol)) * 2.0f;
+	return nvg__maxi(2, (int)ceilf(arc / da));
+}
+
+static void nvg__tesselateBezier(NVGcontext* ctx, NVGpathCache* cache,
 								 float x1, float y1, float x2, float y2,
 								 float x3, float y3, float x4, float y4,
-								 int level, int type)
+								 int type)
 {
-	float x12,y12,x23,y23,x34,y34,x123,y123,x234,y234,x1234,y1234;
-	float dx,dy,d2,d3;
+	NVGpoint* pt;
+	float ddx, ddy, dd, h, h2, h3;
+	float ax, ay, bx, by, cx, cy;
+	float fx, fy, dx1, dy1, dx2, dy2, dx3, dy3;
+	int i, n;
 
-	if (level > 10) return;
+	if (nvg__lastPath(cache) == NULL) return;
+
+	// Segment count from Wang's formula, n = sqrt(3/4 * M / tol), where M is the
+	// largest second difference of the control points.
+	ddx = x1 - 2*x2 + x3;
+	ddy = y1 - 2*y2 + y3;
+	dd = ddx*ddx + ddy*ddy;
+	ddx = x2 - 2*x3 + x4;
+	ddy = y2 - 2*y3 + y4;
+	dd = nvg__maxf(dd, ddx*ddx + ddy*ddy);
+	n = (int)ceilf(nvg__sqrtf(0.75f * nvg__sqrtf(dd) / ctx->tessTol));
+	n = nvg__clampi(n, 1, NVG_MAX_CURVE_SEGS);
+
+	if (!nvg__reservePoints(cache, n)) return;
+
+	// Polynomial coefficients, P(t) = a*t^3 + b*t^2 + c*t + P1.
+	ax = -x1 + 3*x2 - 3*x3 + x4;
+	ay = -y1 + 3*y2 - 3*y3 + y4;
+	bx = 3*x1 - 6*x2 + 3*x3;
+	by = 3*y1 - 6*y2 + 3*y3;
+	cx = 3*(x2 - x1);
+	cy = 3*(y2 - y1);
+
+	// Forward differences.
+	h = 1.0f / n;
+	h2 = h*h;
+	h3 = h2*h;
+	fx = x1;
+	fy = y1;
+	dx1 = ax*h3 + bx*h2 + cx*h;
+	dy1 = ay*h3 + by*h2 + cy*h;
+	dx2 = 6*ax*h3 + 2*bx*h2;
+	dy2 = 6*ay*h3 + 2*by*h2;
+	dx3 = 6*ax*h3;
+	dy3 = 6*ay*h3;
+
+	pt = &cache->points[cache->npoints];
+	for (i = 1; i < n; i++) {
+		fx += dx1;
+		fy += dy1;
+		dx1 += dx2;
+		dy1 += dy2;
+		dx2 += dx3;
+		dy2 += dy3;
+		pt->x = fx;
+		pt->y = fy;
+		pt->flags = 0;
+		pt++;
+	}
+	// Land exactly on the end point.
+	pt->x = x4;
+	pt->y = y4;
+	pt->flags = (unsigned char)type;
 
-	x12 = (x1+x2)*0.5f;
-	y12 = (y1+y2)*0.5f;
-	x23 = (x2+x3)*0.5f;
-	y23 = (y2+y3)*0.5f;
-	x34 = (x3+x4)*0.5f;
-	y34 = (y3+y4)*0.5f;
-	x123 = (x12+x23)*0.5f;
-	y123 = (y12+y23)*0.5f;
+	nvg__commitPoints(ctx, cache, n);
+}
 
-	dx = x4 - x1;
-	dy = y4 - y1;
-	d2 = nvg__absf(((x2 - x4) * dy - (y2 - y4) * dx));
-	d3 = nvg__absf(((x3 - x4) * dy - (y3 - y4) * dx));
+static void nvg__tesselateQuad(NVGcontext* ctx, NVGpathCache* cache,
+							   float x1, float y1, float x2, float y2, float x3, float y3,
+							   int type)
+{
+	NVGpoint* pt;
+	float ax, ay, bx, by, h, h2;
+	float fx, fy, dx1, dy1, dx2, dy2;
+	int i, n;
 
-	if ((d2 + d3)*(d2 + d3) < ctx->tessTol * (dx*dx + dy*dy)) {
-		nvg__addPoint(ctx, x4, y4, type);
-		return;
+	if (nvg__lastPath(cache) == NULL) return;
+
+	// Segment count from Wang's formula, n = sqrt(M / (4*tol)).
+	ax = x1 - 2*x2 + x3;
+	ay = y1 - 2*y2 + y3;
+	n = (int)ceilf(nvg__sqrtf(nvg__sqrtf(ax*ax + ay*ay) / (4.0f * ctx->tessTol)));
+	n = nvg__clampi(n, 1, NVG_MAX_CURVE_SEGS);
+
+	if (!nvg__reservePoints(cache, n)) return;
+
+	// P(t) = a*t^2 + b*t + P1, evaluated with forward differences.
+	bx = 2*(x2 - x1);
+	by = 2*(y2 - y1);
+	h = 1.0f / n;
+	h2 = h*h;
+	fx = x1;
+	fy = y1;
+	dx1 = ax*h2 + bx*h;
+	dy1 = ay*h2 + by*h;
+	dx2 = 2*ax*h2;
+	dy2 = 2*ay*h2;
+
+	pt = &cache->points[cache->npoints];
+	for (i = 1; i < n; i++) {
+		fx += dx1;
+		fy += dy1;
+		dx1 += dx2;
+		dy1 += dy2;
+		pt->x = fx;
+		pt->y = fy;
+		pt->flags = 0;
+		pt++;
 	}
+	pt->x = x3;
+	pt->y = y3;
+	pt->flags = (unsigned char)type;
 
-/*	if (nvg__absf(x1+x3-x2-x2) + nvg__absf(y1+y3-y2-y2) + nvg__absf(x2+x4-x3-x3) + nvg__absf(y2+y4-y3-y3) < ctx->tessTol) {
-		nvg__addPoint(ctx, x4, y4, type);
-		return;
-	}*/
+	nvg__commitPoints(ctx, cache, n);
+}
+
+static void nvg__tesselateArc(NVGcontext* ctx, NVGpathCache* cache, const float* arc, int type)
+{
+	NVGpoint* pt;
+	float cx = arc[0], cy = arc[1], ux = arc[2], uy = arc[3], vx = arc[4], vy = arc[5];
+	float a0 = arc[6], da = arc[7];
+	float uu, vv, det, r, cs, sn, cd, sd, t;
+	int i, n;
 
-	x234 = (x23+x34)*0.5f;
-	y234 = (y23+y34)*0.5f;
-	x1234 = (x123+x234)*0.5f;
-	y1234 = (y123+y234)*0.5f;
+	if (nvg__lastPath(cache) == NULL) return;
+
+	// Largest radius of the (possibly skewed) ellipse is the larger singular value of [u v].
+	uu = ux*ux + uy*uy;
+	vv = vx*vx + vy*vy;
+	det = ux*vy - uy*vx;
+	r = nvg__sqrtf(0.5f * (uu + vv + nvg__sqrtf(nvg__maxf(0.0f, (uu+vv)*(uu+vv) - 4*det*det))));
+	n = nvg__clampi(nvg__curveDivs(r, nvg__absf(da), ctx->tessTol), 1, NVG_MAX_CURVE_SEGS);
+
+	if (!nvg__reservePoints(cache, n)) return;
+
+	// Step the angle with a rotation recurrence instead of calling sin/cos per point.
+	cs = nvg__cosf(a0);
+	sn = nvg__sinf(a0);
+	cd = nvg__cosf(da / n);
+	sd = nvg__sinf(da / n);
+
+	pt = &cache->points[cache->npoints];
+	for (i = 1; i < n; i++) {
+		t = cs*cd - sn*sd;
+		sn = sn*cd + cs*sd;
+		cs = t;
+		pt->x = cx + ux*cs + vx*sn;
+		pt->y = cy + uy*cs + vy*sn;
+		pt->flags = 0;
+		pt++;
+	}
+	// Land exactly on the end point.
+	cs = nvg__cosf(a0 + da);
+	sn = nvg__sinf(a0 + da);
+	pt->x = cx + ux*cs + vx*sn;
+	pt->y = cy + uy*cs + vy*sn;
+	pt->flags = (unsigned char)type;
 
-	nvg__tesselateBezier(ctx, x1,y1, x12,y12, x123,y123, x1234,y1234, level+1, 0);
-	nvg__tesselateBezier(ctx, x1234,y1234, x234,y234, x34,y34, x4,y4, level+1, type);
+	nvg__commitPoints(ctx, cache, n);
 }
 
-static void nvg__flattenPaths(NVGcontext* ctx)
+static void nvg__flattenPaths(NVGcontext* ctx, NVGpathCache* cache, const float* commands, int ncommands)
 {
-	NVGpathCache* cache = ctx->cache;
-//	NVGstate* state = nvg__getState(ctx);
 	NVGpoint* last;
 	NVGpoint* p0;
 	NVGpoint* p1;
 	NVGpoint* pts;
 	NVGpath* path;
 	int i, j;
-	float* cp1;
-	float* cp2;
-	float* p;
+	const float* cp1;
+	const float* cp2;
+	const float* p;
 	float area;
 
 	if (cache->npaths > 0)
 		return;
 
+	NVG_PROFILE_BEGIN(start);
+
 	// Flatten
 	i = 0;
-	while (i < ctx->ncommands) {
-		int cmd = (int)ctx->commands[i];
+	while (i < ncommands) {
+		int cmd = (int)commands[i];
 		switch (cmd) {
 		case NVG_MOVETO:
-			nvg__addPath(ctx);
-			p = &ctx->commands[i+1];
-			nvg__addPoint(ctx, p[0], p[1], NVG_PT_CORNER);
+			nvg__addPath(cache);
+			p = &commands[i+1];
+			nvg__addPoint(ctx, cache, p[0], p[1], NVG_PT_CORNER);
 			i += 3;
 			break;
 		case NVG_LINETO:
-			p = &ctx->commands[i+1];
-			nvg__addPoint(ctx, p[0], p[1], NVG_PT_CORNER);
+			p = &commands[i+1];
+			nvg__addPoint(ctx, cache, p[0], p[1], NVG_PT_CORNER);
 			i += 3;
 			break;
 		case NVG_BEZIERTO:
-			last = nvg__lastPoint(ctx);
+			last = nvg__lastPoint(cache);
 			if (last != NULL) {
-				cp1 = &ctx->commands[i+1];
-				cp2 = &ctx->commands[i+3];
-				p = &ctx->commands[i+5];
-				nvg__tesselateBezier(ctx, last->x,last->y, cp1[0],cp1[1], cp2[0],cp2[1], p[0],p[1], 0, NVG_PT_CORNER);
+				cp1 = &commands[i+1];
+				cp2 = &commands[i+3];
+				p = &commands[i+5];
+				nvg__tesselateBezier(ctx, cache, last->x,last->y, cp1[0],cp1[1], cp2[0],cp2[1], p[0],p[1], NVG_PT_CORNER);
 			}
 			i += 7;
 			break;
-		case NVG_CLOSE:
-			nvg__closePath(ctx);
-			i++;
-			break;
+		case NVG_QUADTO:
+			last = nvg__lastPoint(cache);
+			if (last != NULL) {
+				cp1 = &commands[i+1];
+				p = &commands[i+3];
+				nvg__tesselateQuad(ctx, cache, last->x,last->y, cp1[0],cp1[1], p[0],p[1], NVG_PT_CORNER);
+			}
+			i += 5;
+			break;
+		case NVG_ARCTO:
+			nvg__tesselateArc(ctx, cache, &commands[i+1], NVG_PT_CORNER);
+			i += 9;
+			break;
+		case NVG_CLOSE:
+			nvg__closePath(cache);
+			i++;
+			break;
 		case NVG_WINDING:
-			nvg__pathWinding(ctx, (int)ctx->commands[i+1]);
+			nvg__pathWinding(cache, (int)commands[i+1]);
 			i += 2;
 			break;
 		default:
@@ -1417,12 +2219,11 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 			p0 = p1++;
 		}
 	}
-}
 
-static int nvg__curveDivs(float r, float arc, float tol)
-{
-	float da = acosf(r / (r + tol)) * 2.0f;
-	return nvg__maxi(2, (int)ceilf(arc / da));
+	cache->peakPoints = nvg__maxi(cache->peakPoints, cache->npoints);
+	cache->peakPaths = nvg__maxi(cache->peakPaths, cache->npaths);
+	nvg__atomicAdd(&ctx->pointCount, cache->npoints);
+	NVG_PROFILE_END(ctx, NVG_PROFILE_FLATTEN, start);
 }
 
 static void nvg__chooseBevel(int bevel, NVGpoint* p0, NVGpoint* p1, float w,
@@ -1649,9 +2450,8 @@ static NVGvertex* nvg__roundCapEnd(NVGvertex* dst, NVGpoint* p,
 }
 
 
-static void nvg__calculateJoins(NVGcontext* ctx, float w, int lineJoin, float miterLimit)
+static void nvg__calculateJoins(NVGpathCache* cache, float w, int lineJoin, float miterLimit)
 {
-	NVGpathCache* cache = ctx->cache;
 	int i, j;
 	float iw = 0.0f;
 
@@ -1719,9 +2519,8 @@ static void nvg__calculateJoins(NVGcontext* ctx, float w, int lineJoin, float mi
 }
 
 
-static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap, int lineJoin, float miterLimit)
+static int nvg__expandStroke(NVGcontext* ctx, NVGpathCache* cache, float w, float fringe, int lineCap, int lineJoin, float miterLimit)
 {
-	NVGpathCache* cache = ctx->cache;
 	NVGvertex* verts;
 	NVGvertex* dst;
 	int cverts, i, j;
@@ -1737,7 +2536,10 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 		u1 = 0.5f;
 	}
 
-	nvg__calculateJoins(ctx, w, lineJoin, miterLimit);
+	NVG_PROFILE_BEGIN(joinsStart);
+	nvg__calculateJoins(cache, w, lineJoin, miterLimit);
+	NVG_PROFILE_END(ctx, NVG_PROFILE_JOINS, joinsStart);
+	NVG_PROFILE_BEGIN(start);
 
 	// Calculate max vertex usage.
 	cverts = 0;
@@ -1758,7 +2560,7 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 		}
 	}
 
-	verts = nvg__allocTempVerts(ctx, cverts);
+	verts = nvg__allocTempVerts(cache, cverts);
 	if (verts == NULL) return 0;
 
 	for (i = 0; i < cache->npaths; i++) {
@@ -1840,19 +2642,22 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 		verts = dst;
 	}
 
+	NVG_PROFILE_END(ctx, NVG_PROFILE_EXPAND, start);
 	return 1;
 }
 
-static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLimit)
+static int nvg__expandFill(NVGcontext* ctx, NVGpathCache* cache, float w, int lineJoin, float miterLimit)
 {
-	NVGpathCache* cache = ctx->cache;
 	NVGvertex* verts;
 	NVGvertex* dst;
 	int cverts, convex, i, j;
 	float aa = ctx->fringeWidth;
 	int fringe = w > 0.0f;
 
-	nvg__calculateJoins(ctx, w, lineJoin, miterLimit);
+	NVG_PROFILE_BEGIN(joinsStart);
+	nvg__calculateJoins(cache, w, lineJoin, miterLimit);
+	NVG_PROFILE_END(ctx, NVG_PROFILE_JOINS, joinsStart);
+	NVG_PROFILE_BEGIN(start);
 
 	// Calculate max vertex usage.
 	cverts = 0;
@@ -1863,7 +2668,7 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 			cverts += (path->count + path->nbevel*5 + 1) * 2; // plus one for loop
 	}
 
-	verts = nvg__allocTempVerts(ctx, cverts);
+	verts = nvg__allocTempVerts(cache, cverts);
 	if (verts == NULL) return 0;
 
 	convex = cache->npaths == 1 && cache->paths[0].convex;
@@ -1960,6 +2765,7 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 		}
 	}
 
+	NVG_PROFILE_END(ctx, NVG_PROFILE_EXPAND, start);
 	return 1;
 }
 
@@ -1968,6 +2774,8 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 void nvgBeginPath(NVGcontext* ctx)
 {
 	ctx->ncommands = 0;
+	nvg__clearBounds(ctx->commandBounds);
+	ctx->pathJobCommands = -1;
 	nvg__clearPathCache(ctx);
 }
 
@@ -1991,13 +2799,8 @@ void nvgBezierTo(NVGcontext* ctx, float c1x, float c1y, float c2x, float c2y, fl
 
 void nvgQuadTo(NVGcontext* ctx, float cx, float cy, float x, float y)
 {
-    float x0 = ctx->commandx;
-    float y0 = ctx->commandy;
-    float vals[] = { NVG_BEZIERTO,
-        x0 + 2.0f/3.0f*(cx - x0), y0 + 2.0f/3.0f*(cy - y0),
-        x + 2.0f/3.0f*(cx - x), y + 2.0f/3.0f*(cy - y),
-        x, y };
-    nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
+	float vals[] = { NVG_QUADTO, cx, cy, x, y };
+	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 }
 
 void nvgArcTo(NVGcontext* ctx, float x1, float y1, float x2, float y2, float radius)
@@ -2070,11 +2873,7 @@ void nvgPathWinding(NVGcontext* ctx, int dir)
 
 void nvgArc(NVGcontext* ctx, float cx, float cy, float r, float a0, float a1, int dir)
 {
-	float a = 0, da = 0, hda = 0, kappa = 0;
-	float dx = 0, dy = 0, x = 0, y = 0, tanx = 0, tany = 0;
-	float px = 0, py = 0, ptanx = 0, ptany = 0;
-	float vals[3 + 5*7 + 100];
-	int i, ndivs, nvals;
+	float da = 0;
 	int move = ctx->ncommands > 0 ? NVG_LINETO : NVG_MOVETO;
 
 	// Clamp angles
@@ -2093,44 +2892,17 @@ void nvgArc(NVGcontext* ctx, float cx, float cy, float r, float a0, float a1, in
 		}
 	}
 
-	// Split arc into max 90 degree segments.
-	ndivs = nvg__maxi(1, nvg__mini((int)(nvg__absf(da) / (NVG_PI*0.5f) + 0.5f), 5));
-	hda = (da / (float)ndivs) / 2.0f;
-	kappa = nvg__absf(4.0f / 3.0f * (1.0f - nvg__cosf(hda)) / nvg__sinf(hda));
-
-	if (dir == NVG_CCW)
-		kappa = -kappa;
-
-	nvals = 0;
-	for (i = 0; i <= ndivs; i++) {
-		a = a0 + da * (i/(float)ndivs);
-		dx = nvg__cosf(a);
-		dy = nvg__sinf(a);
-		x = cx + dx*r;
-		y = cy + dy*r;
-		tanx = -dy*r*kappa;
-		tany = dx*r*kappa;
-
-		if (i == 0) {
-			vals[nvals++] = (float)move;
-			vals[nvals++] = x;
-			vals[nvals++] = y;
-		} else {
-			vals[nvals++] = NVG_BEZIERTO;
-			vals[nvals++] = px+ptanx;
-			vals[nvals++] = py+ptany;
-			vals[nvals++] = x-tanx;
-			vals[nvals++] = y-tany;
-			vals[nvals++] = x;
-			vals[nvals++] = y;
-		}
-		px = x;
-		py = y;
-		ptanx = tanx;
-		ptany = tany;
+	{
+		float vals[] = {
+			(float)move, cx + nvg__cosf(a0)*r, cy + nvg__sinf(a0)*r,
+			NVG_ARCTO, cx, cy, r, 0.0f, 0.0f, r, a0, da
+		};
+		nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 	}
 
-	nvg__appendCommands(ctx, vals, nvals);
+	// The arc command does not end with its end point, set it explicitly.
+	ctx->commandx = cx + nvg__cosf(a0 + da)*r;
+	ctx->commandy = cy + nvg__sinf(a0 + da)*r;
 }
 
 void nvgRect(NVGcontext* ctx, float x, float y, float w, float h)
@@ -2165,13 +2937,13 @@ void nvgRoundedRectVarying(NVGcontext* ctx, float x, float y, float w, float h,
 		float vals[] = {
 			NVG_MOVETO, x, y + ryTL,
 			NVG_LINETO, x, y + h - ryBL,
-			NVG_BEZIERTO, x, y + h - ryBL*(1 - NVG_KAPPA90), x + rxBL*(1 - NVG_KAPPA90), y + h, x + rxBL, y + h,
+			NVG_ARCTO, x + rxBL, y + h - ryBL, rxBL, 0, 0, ryBL, NVG_PI, -NVG_PI*0.5f,
 			NVG_LINETO, x + w - rxBR, y + h,
-			NVG_BEZIERTO, x + w - rxBR*(1 - NVG_KAPPA90), y + h, x + w, y + h - ryBR*(1 - NVG_KAPPA90), x + w, y + h - ryBR,
+			NVG_ARCTO, x + w - rxBR, y + h - ryBR, rxBR, 0, 0, ryBR, NVG_PI*0.5f, -NVG_PI*0.5f,
 			NVG_LINETO, x + w, y + ryTR,
-			NVG_BEZIERTO, x + w, y + ryTR*(1 - NVG_KAPPA90), x + w - rxTR*(1 - NVG_KAPPA90), y, x + w - rxTR, y,
+			NVG_ARCTO, x + w - rxTR, y + ryTR, rxTR, 0, 0, ryTR, 0, -NVG_PI*0.5f,
 			NVG_LINETO, x + rxTL, y,
-			NVG_BEZIERTO, x + rxTL*(1 - NVG_KAPPA90), y, x, y + ryTL*(1 - NVG_KAPPA90), x, y + ryTL,
+			NVG_ARCTO, x + rxTL, y + ryTL, rxTL, 0, 0, ryTL, -NVG_PI*0.5f, -NVG_PI*0.5f,
 			NVG_CLOSE
 		};
 		nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
@@ -2182,10 +2954,7 @@ void nvgEllipse(NVGcontext* ctx, float cx, float cy, float rx, float ry)
 {
 	float vals[] = {
 		NVG_MOVETO, cx-rx, cy,
-		NVG_BEZIERTO, cx-rx, cy+ry*NVG_KAPPA90, cx-rx*NVG_KAPPA90, cy+ry, cx, cy+ry,
-		NVG_BEZIERTO, cx+rx*NVG_KAPPA90, cy+ry, cx+rx, cy+ry*NVG_KAPPA90, cx+rx, cy,
-		NVG_BEZIERTO, cx+rx, cy-ry*NVG_KAPPA90, cx+rx*NVG_KAPPA90, cy-ry, cx, cy-ry,
-		NVG_BEZIERTO, cx-rx*NVG_KAPPA90, cy-ry, cx-rx, cy-ry*NVG_KAPPA90, cx-rx, cy,
+		NVG_ARCTO, cx, cy, rx, 0, 0, ry, NVG_PI, -NVG_PI*2,
 		NVG_CLOSE
 	};
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
@@ -2218,306 +2987,1453 @@ void nvgDebugDumpPathCache(NVGcontext* ctx)
 	}
 }
 
-void nvgFill(NVGcontext* ctx)
+// Fill vertices are triangle fans. For back-ends which draw indexed fills, point every
+// fill at one shared index list which turns a fan into a triangle list.
+static void nvg__fillIndices(NVGcontext* ctx, NVGpath* paths, int npaths)
 {
-	NVGstate* state = nvg__getState(ctx);
-	const NVGpath* path;
-	NVGpaint fillPaint = state->fill;
-	int i;
+	int maxIndexedVerts = sizeof(NVGindex) < sizeof(int) ? (1 << (8*sizeof(NVGindex))) : 0x7fffffff;
+	int i, j, nverts = 0;
 
-	nvg__flattenPaths(ctx);
-	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
-		nvg__expandFill(ctx, ctx->fringeWidth, NVG_MITER, 2.4f);
-	else
-		nvg__expandFill(ctx, 0.0f, NVG_MITER, 2.4f);
+	if (!ctx->params.indexedFills) return;
 
-	// Apply global alpha
-	fillPaint.innerColor.a *= state->alpha;
-	fillPaint.outerColor.a *= state->alpha;
+	for (i = 0; i < npaths; i++) {
+		if (paths[i].nfill <= maxIndexedVerts)
+			nverts = nvg__maxi(nverts, paths[i].nfill);
+	}
 
-	ctx->params.renderFill(ctx->params.userPtr, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
-						   ctx->cache->bounds, ctx->cache->paths, ctx->cache->npaths);
+	if (nverts >= 3 && nverts > ctx->nfanVerts) {
+		int cverts = nvg__mini(nverts + ctx->nfanVerts/2, maxIndexedVerts);
+		NVGindex* indices = (NVGindex*)NVG_REALLOC(ctx->fanIndices, sizeof(NVGindex)*(cverts-2)*3);
+		if (indices != NULL) {
+			for (j = nvg__maxi(ctx->nfanVerts-2, 0); j < cverts-2; j++) {
+				indices[j*3+0] = 0;
+				indices[j*3+1] = (NVGindex)(j+1);
+				indices[j*3+2] = (NVGindex)(j+2);
+			}
+			ctx->fanIndices = indices;
+			ctx->nfanVerts = cverts;
+		}
+	}
 
-	// Count triangles
-	for (i = 0; i < ctx->cache->npaths; i++) {
-		path = &ctx->cache->paths[i];
-		ctx->fillTriCount += path->nfill-2;
-		ctx->fillTriCount += path->nstroke-2;
-		ctx->drawCallCount += 2;
+	for (i = 0; i < npaths; i++) {
+		NVGpath* path = &paths[i];
+		if (path->nfill >= 3 && path->nfill <= ctx->nfanVerts) {
+			path->fillIndices = ctx->fanIndices;
+			path->nfillIndices = (path->nfill-2)*3;
+		} else {
+			path->fillIndices = NULL;
+			path->nfillIndices = 0;
+		}
 	}
 }
 
-void nvgStroke(NVGcontext* ctx)
+// Threaded tessellation
+static int nvg__deferred(NVGcontext* ctx)
+{
+	return ctx->params.threadedTessellation;
+}
+
+static NVGdrawJob* nvg__allocJob(NVGcontext* ctx, int type, const NVGpaint* paint)
 {
 	NVGstate* state = nvg__getState(ctx);
-	float scale = nvg__getAverageScale(state->xform);
-	float strokeWidth = nvg__clampf(state->strokeWidth * scale, 0.0f, 200.0f);
-	NVGpaint strokePaint = state->stroke;
-	const NVGpath* path;
-	int i;
+	NVGdrawJob* job;
+	if (ctx->njobs+1 > ctx->cjobs) {
+		NVGdrawJob* jobs;
+		int cjobs = ctx->njobs+1 + ctx->cjobs/2;
+		jobs = (NVGdrawJob*)NVG_REALLOC(ctx->jobs, sizeof(NVGdrawJob)*cjobs);
+		if (jobs == NULL) return NULL;
+		ctx->jobs = jobs;
+		ctx->cjobs = cjobs;
+	}
+	job = &ctx->jobs[ctx->njobs++];
+	memset(job, 0, sizeof(*job));
+	job->type = type;
+	job->paint = *paint;
+	job->compositeOperation = state->compositeOperation;
+	job->scissor = state->scissor;
+	job->output = -1;
+	return job;
+}
+
+// Copies the commands of the current path for the job. Filling and stroking the same path shares one copy.
+static int nvg__recordJobCommands(NVGcontext* ctx, NVGdrawJob* job)
+{
+	if (ctx->pathJobCommands < 0) {
+		if (ctx->njobCommands+ctx->ncommands > ctx->cjobCommands) {
+			float* commands;
+			int ccommands = ctx->njobCommands+ctx->ncommands + ctx->cjobCommands/2;
+			commands = (float*)NVG_REALLOC(ctx->jobCommands, sizeof(float)*ccommands);
+			if (commands == NULL) return 0;
+			ctx->jobCommands = commands;
+			ctx->cjobCommands = ccommands;
+		}
+		memcpy(&ctx->jobCommands[ctx->njobCommands], ctx->commands, sizeof(float)*ctx->ncommands);
+		ctx->pathJobCommands = ctx->njobCommands;
+		ctx->njobCommands += ctx->ncommands;
+	}
+	job->first = ctx->pathJobCommands;
+	job->count = ctx->ncommands;
+	return 1;
+}
 
+// Appends the expanded paths of the cache to the output.
+static int nvg__storeJobGeometry(NVGjobOutput* out, NVGdrawJob* job, NVGpathCache* cache)
+{
+	int i, nverts = 0;
 
-	if (strokeWidth < ctx->fringeWidth) {
-		// If the stroke width is less than pixel size, use alpha to emulate coverage.
-		// Since coverage is area, scale by alpha*alpha.
-		float alpha = nvg__clampf(strokeWidth / ctx->fringeWidth, 0.0f, 1.0f);
-		strokePaint.innerColor.a *= alpha*alpha;
-		strokePaint.outerColor.a *= alpha*alpha;
-		strokeWidth = ctx->fringeWidth;
+	for (i = 0; i < cache->npaths; i++) {
+		const NVGpath* path = &cache->paths[i];
+		if (path->fill != NULL)
+			nverts = nvg__maxi(nverts, (int)(path->fill - cache->verts) + path->nfill);
+		if (path->stroke != NULL)
+			nverts = nvg__maxi(nverts, (int)(path->stroke - cache->verts) + path->nstroke);
 	}
 
-	// Apply global alpha
-	strokePaint.innerColor.a *= state->alpha;
-	strokePaint.outerColor.a *= state->alpha;
-
-	nvg__flattenPaths(ctx);
+	if (out->npaths+cache->npaths > out->cpaths) {
+		NVGpath* paths;
+		int* offsets;
+		int cpaths = out->npaths+cache->npaths + out->cpaths/2;
+		paths = (NVGpath*)NVG_REALLOC(out->paths, sizeof(NVGpath)*cpaths);
+		if (paths == NULL) return 0;
+		out->paths = paths;
+		offsets = (int*)NVG_REALLOC(out->offsets, sizeof(int)*2*cpaths);
+		if (offsets == NULL) return 0;
+		out->offsets = offsets;
+		out->cpaths = cpaths;
+	}
+	if (out->nverts+nverts > out->cverts) {
+		NVGvertex* verts;
+		int cverts = out->nverts+nverts + out->cverts/2;
+		verts = (NVGvertex*)NVG_REALLOC(out->verts, sizeof(NVGvertex)*cverts);
+		if (verts == NULL) return 0;
+		out->verts = verts;
+		out->cverts = cverts;
+	}
 
-	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
-		nvg__expandStroke(ctx, strokeWidth*0.5f, ctx->fringeWidth, state->lineCap, state->lineJoin, state->miterLimit);
-	else
-		nvg__expandStroke(ctx, strokeWidth*0.5f, 0.0f, state->lineCap, state->lineJoin, state->miterLimit);
+	memcpy(&out->verts[out->nverts], cache->verts, sizeof(NVGvertex)*nverts);
+	memcpy(&out->paths[out->npaths], cache->paths, sizeof(NVGpath)*cache->npaths);
+	for (i = 0; i < cache->npaths; i++) {
+		const NVGpath* path = &cache->paths[i];
+		int* offset = &out->offsets[(out->npaths+i)*2];
+		offset[0] = path->fill != NULL ? out->nverts + (int)(path->fill - cache->verts) : -1;
+		offset[1] = path->stroke != NULL ? out->nverts + (int)(path->stroke - cache->verts) : -1;
+	}
 
-	ctx->params.renderStroke(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
-							 strokeWidth, ctx->cache->paths, ctx->cache->npaths);
+	job->firstPath = out->npaths;
+	job->npaths = cache->npaths;
+	memcpy(job->bounds, cache->bounds, sizeof(float)*4);
 
-	// Count triangles
-	for (i = 0; i < ctx->cache->npaths; i++) {
-		path = &ctx->cache->paths[i];
-		ctx->strokeTriCount += path->nstroke-2;
-		ctx->drawCallCount++;
-	}
+	out->npaths += cache->npaths;
+	out->nverts += nverts;
+	return 1;
 }
 
-// Add fonts
-int nvgCreateFont(NVGcontext* ctx, const char* name, const char* filename)
+static void nvg__deferGeometry(NVGcontext* ctx, int type, const NVGpaint* paint, float strokeWidth, NVGpathCache* cache)
 {
-	return fonsAddFont(ctx->fs, name, filename, 0);
+	NVGdrawJob* job = nvg__allocJob(ctx, type, paint);
+	if (job == NULL) return;
+	job->strokeWidth = strokeWidth;
+	if (nvg__storeJobGeometry(&ctx->outputs[0], job, cache))
+		job->output = 0;
+	else
+		ctx->njobs--;
 }
 
-int nvgCreateFontAtIndex(NVGcontext* ctx, const char* name, const char* filename, const int fontIndex)
+static void nvg__tessellateJob(NVGcontext* ctx, int worker, NVGdrawJob* job)
 {
-	return fonsAddFont(ctx->fs, name, filename, fontIndex);
+	NVGjobOutput* out = &ctx->outputs[worker];
+	NVGpathCache* cache;
+
+	if (out->cache == NULL) {
+		out->cache = nvg__allocPathCache();
+		if (out->cache == NULL) return;
+	}
+	cache = out->cache;
+
+	cache->npoints = 0;
+	cache->npaths = 0;
+	nvg__flattenPaths(ctx, cache, &ctx->jobCommands[job->first], job->count);
+	if (job->type == NVG_JOB_FILL) {
+		if (!nvg__expandFill(ctx, cache, job->fringe, NVG_MITER, 2.4f)) return;
+	} else {
+		if (!nvg__expandStroke(ctx, cache, job->strokeWidth*0.5f, job->fringe, job->lineCap, job->lineJoin, job->miterLimit)) return;
+	}
+
+	if (nvg__storeJobGeometry(out, job, cache))
+		job->output = worker;
 }
 
-int nvgCreateFontMem(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData)
+static void nvg__runJobs(NVGcontext* ctx, int worker)
 {
-	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, 0);
+	NVGjobOutput* out = &ctx->outputs[worker];
+	int i, j;
+
+	for (;;) {
+		int first = nvg__atomicAdd(&ctx->nextJob, NVG_JOB_CHUNK);
+		if (first >= ctx->njobs) break;
+		for (i = first; i < ctx->njobs && i < first+NVG_JOB_CHUNK; i++) {
+			NVGdrawJob* job = &ctx->jobs[i];
+			// Triangles, glyphs and retained paths are ready when recorded.
+			if (job->type == NVG_JOB_TRIANGLES || job->type == NVG_JOB_GLYPHS || job->output >= 0) continue;
+			nvg__tessellateJob(ctx, worker, job);
+		}
+	}
+
+	// The vertex array does not move anymore, resolve vertex pointers.
+	for (i = 0; i < out->npaths; i++) {
+		NVGpath* path = &out->paths[i];
+		j = out->offsets[i*2];
+		path->fill = j >= 0 ? &out->verts[j] : NULL;
+		j = out->offsets[i*2+1];
+		path->stroke = j >= 0 ? &out->verts[j] : NULL;
+	}
 }
 
-int nvgCreateFontMemAtIndex(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData, const int fontIndex)
+static void nvg__clearJobs(NVGcontext* ctx)
 {
-	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, fontIndex);
+	int i;
+	for (i = 0; i < ctx->nworkers; i++) {
+		NVGjobOutput* out = &ctx->outputs[i];
+		out->peakPaths = nvg__maxi(out->peakPaths, out->npaths);
+		out->peakVerts = nvg__maxi(out->peakVerts, out->nverts);
+		out->npaths = 0;
+		out->nverts = 0;
+	}
+	ctx->peakJobs = nvg__maxi(ctx->peakJobs, ctx->njobs);
+	ctx->peakJobCommands = nvg__maxi(ctx->peakJobCommands, ctx->njobCommands);
+	ctx->peakJobVerts = nvg__maxi(ctx->peakJobVerts, ctx->njobVerts);
+	ctx->peakJobGlyphs = nvg__maxi(ctx->peakJobGlyphs, ctx->njobGlyphs);
+	ctx->njobs = 0;
+	ctx->njobCommands = 0;
+	ctx->njobVerts = 0;
+	ctx->njobGlyphs = 0;
+	ctx->pathJobCommands = -1;
+}
+
+// Reallocates a buffer smaller if it is more than twice the size its peak use needs.
+// Returns the buffer, which is unchanged if it was not oversized.
+static void* nvg__shrinkBuffer(void* ptr, int* capacity, int peak, int minCapacity, int elemSize)
+{
+	int target = nvg__maxi(peak + peak/2, minCapacity);
+	void* p;
+	if (ptr == NULL || *capacity <= target*2) return ptr;
+	if (target == 0) {
+		NVG_FREE(ptr);
+		*capacity = 0;
+		return NULL;
+	}
+	p = NVG_REALLOC(ptr, (size_t)target*elemSize);
+	if (p == NULL) return ptr;
+	*capacity = target;
+	return p;
 }
 
-int nvgFindFont(NVGcontext* ctx, const char* name)
+static void nvg__shrinkPathCache(NVGpathCache* cache)
 {
-	if (name == NULL) return -1;
-	return fonsGetFontByName(ctx->fs, name);
+	if (cache == NULL) return;
+	// The paths point into the vertex buffer, drop them and flatten again on next use.
+	cache->npoints = 0;
+	cache->npaths = 0;
+	cache->nverts = 0;
+	cache->points = (NVGpoint*)nvg__shrinkBuffer(cache->points, &cache->cpoints, cache->peakPoints, NVG_INIT_POINTS_SIZE, sizeof(NVGpoint));
+	cache->paths = (NVGpath*)nvg__shrinkBuffer(cache->paths, &cache->cpaths, cache->peakPaths, NVG_INIT_PATHS_SIZE, sizeof(NVGpath));
+	cache->verts = (NVGvertex*)nvg__shrinkBuffer(cache->verts, &cache->cverts, cache->peakVerts, NVG_INIT_VERTS_SIZE, sizeof(NVGvertex));
+	cache->peakPoints = 0;
+	cache->peakPaths = 0;
+	cache->peakVerts = 0;
 }
 
-
-int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont)
+// Trims the per-frame buffers to what the frames since the last trim needed,
+// so that one heavy frame does not keep its memory for the rest of the process.
+static void nvg__shrinkBuffers(NVGcontext* ctx)
 {
-	if(baseFont == -1 || fallbackFont == -1) return 0;
-	return fonsAddFallbackFont(ctx->fs, baseFont, fallbackFont);
+	int i;
+
+	ctx->commands = (float*)nvg__shrinkBuffer(ctx->commands, &ctx->ccommands, nvg__maxi(ctx->peakCommands, ctx->ncommands),
+											  NVG_INIT_COMMANDS_SIZE, sizeof(float));
+	ctx->peakCommands = 0;
+	nvg__shrinkPathCache(ctx->cache);
+
+	ctx->jobs = (NVGdrawJob*)nvg__shrinkBuffer(ctx->jobs, &ctx->cjobs, ctx->peakJobs, 0, sizeof(NVGdrawJob));
+	ctx->jobCommands = (float*)nvg__shrinkBuffer(ctx->jobCommands, &ctx->cjobCommands, ctx->peakJobCommands, 0, sizeof(float));
+	ctx->jobVerts = (NVGvertex*)nvg__shrinkBuffer(ctx->jobVerts, &ctx->cjobVerts, ctx->peakJobVerts, 0, sizeof(NVGvertex));
+	ctx->peakJobs = 0;
+	ctx->peakJobCommands = 0;
+	ctx->jobGlyphs = (NVGglyphInstance*)nvg__shrinkBuffer(ctx->jobGlyphs, &ctx->cjobGlyphs, ctx->peakJobGlyphs, 0, sizeof(NVGglyphInstance));
+	ctx->peakJobVerts = 0;
+	ctx->peakJobGlyphs = 0;
+
+	for (i = 0; i < ctx->nworkers; i++) {
+		NVGjobOutput* out = &ctx->outputs[i];
+		int cpaths = out->cpaths;
+		nvg__shrinkPathCache(out->cache);
+		out->paths = (NVGpath*)nvg__shrinkBuffer(out->paths, &cpaths, out->peakPaths, 0, sizeof(NVGpath));
+		if (cpaths != out->cpaths) {
+			if (cpaths == 0) {
+				NVG_FREE(out->offsets);
+				out->offsets = NULL;
+			} else {
+				int* offsets = (int*)NVG_REALLOC(out->offsets, sizeof(int)*2*cpaths);
+				if (offsets != NULL) out->offsets = offsets;
+			}
+			out->cpaths = cpaths;
+		}
+		out->verts = (NVGvertex*)nvg__shrinkBuffer(out->verts, &out->cverts, out->peakVerts, 0, sizeof(NVGvertex));
+		out->peakPaths = 0;
+		out->peakVerts = 0;
+	}
 }
 
-int nvgAddFallbackFont(NVGcontext* ctx, const char* baseFont, const char* fallbackFont)
+void nvgBufferShrinkFrames(NVGcontext* ctx, int frames)
 {
-	return nvgAddFallbackFontId(ctx, nvgFindFont(ctx, baseFont), nvgFindFont(ctx, fallbackFont));
+	ctx->shrinkFrames = nvg__maxi(frames, 0);
+	ctx->shrinkCounter = 0;
 }
 
-void nvgResetFallbackFontsId(NVGcontext* ctx, int baseFont)
+static void nvg__flushJobs(NVGcontext* ctx)
 {
-	fonsResetFallbackFont(ctx->fs, baseFont);
+	int i, j;
+
+	if (ctx->njobs == 0) return;
+
+	// Not worth waking up the workers for a few jobs.
+	ctx->nextJob = 0;
+	if (ctx->njobs > NVG_JOB_CHUNK)
+		nvg__runWorkers(ctx, nvg__runJobs);
+	else
+		nvg__runJobs(ctx, 0);
+
+	// Submit in recording order.
+	for (i = 0; i < ctx->njobs; i++) {
+		NVGdrawJob* job = &ctx->jobs[i];
+		NVGpath* paths;
+
+		if (job->type == NVG_JOB_TRIANGLES) {
+			ctx->params.renderTriangles(ctx->params.userPtr, &job->paint, job->compositeOperation, &job->scissor,
+										&ctx->jobVerts[job->first], job->count, ctx->fringeWidth);
+			ctx->drawCallCount++;
+			ctx->textTriCount += job->count/3;
+			ctx->vertCount += job->count;
+			continue;
+		}
+		if (job->type == NVG_JOB_GLYPHS) {
+			ctx->params.renderGlyphs(ctx->params.userPtr, &job->paint, job->compositeOperation, &job->scissor,
+									 &ctx->jobGlyphs[job->first], job->count, ctx->fringeWidth);
+			ctx->drawCallCount++;
+			ctx->textTriCount += job->count*2;
+			ctx->vertCount += job->count;
+			continue;
+		}
+
+		if (job->output < 0) continue;
+		paths = &ctx->outputs[job->output].paths[job->firstPath];
+
+		if (job->type == NVG_JOB_FILL) {
+			nvg__fillIndices(ctx, paths, job->npaths);
+			ctx->params.renderFill(ctx->params.userPtr, &job->paint, job->compositeOperation, &job->scissor, ctx->fringeWidth,
+								   job->bounds, paths, job->npaths);
+			for (j = 0; j < job->npaths; j++) {
+				ctx->fillTriCount += paths[j].nfill-2;
+				ctx->fillTriCount += paths[j].nstroke-2;
+				ctx->vertCount += paths[j].nfill + paths[j].nstroke;
+				ctx->drawCallCount += 2;
+			}
+		} else {
+			ctx->params.renderStroke(ctx->params.userPtr, &job->paint, job->compositeOperation, &job->scissor, ctx->fringeWidth,
+									 job->strokeWidth, paths, job->npaths);
+			for (j = 0; j < job->npaths; j++) {
+				ctx->strokeTriCount += paths[j].nstroke-2;
+				ctx->vertCount += paths[j].nstroke;
+				ctx->drawCallCount++;
+			}
+		}
+	}
+
+	nvg__clearJobs(ctx);
 }
 
-void nvgResetFallbackFonts(NVGcontext* ctx, const char* baseFont)
+static void nvg__fillPaint(NVGcontext* ctx, NVGpaint* fillPaint)
 {
-	nvgResetFallbackFontsId(ctx, nvgFindFont(ctx, baseFont));
+	NVGstate* state = nvg__getState(ctx);
+	*fillPaint = state->fill;
+
+	// Apply global alpha
+	fillPaint->innerColor.a *= state->alpha;
+	fillPaint->outerColor.a *= state->alpha;
 }
 
-// State setting
-void nvgFontSize(NVGcontext* ctx, float size)
+static void nvg__renderFill(NVGcontext* ctx, NVGpathCache* cache)
 {
 	NVGstate* state = nvg__getState(ctx);
-	state->fontSize = size;
+	const NVGpath* path;
+	NVGpaint fillPaint;
+	int i;
+
+	nvg__flushJobs(ctx);
+	nvg__fillPaint(ctx, &fillPaint);
+	nvg__fillIndices(ctx, cache->paths, cache->npaths);
+
+	ctx->params.renderFill(ctx->params.userPtr, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+						   cache->bounds, cache->paths, cache->npaths);
+
+	// Count triangles
+	for (i = 0; i < cache->npaths; i++) {
+		path = &cache->paths[i];
+		ctx->fillTriCount += path->nfill-2;
+		ctx->fillTriCount += path->nstroke-2;
+		ctx->vertCount += path->nfill + path->nstroke;
+		ctx->drawCallCount += 2;
+	}
 }
 
-void nvgFontBlur(NVGcontext* ctx, float blur)
+static float nvg__strokeWidth(NVGcontext* ctx, const float* xform, NVGpaint* strokePaint)
 {
 	NVGstate* state = nvg__getState(ctx);
-	state->fontBlur = blur;
+	float scale = nvg__getAverageScale(xform);
+	float strokeWidth = nvg__clampf(state->strokeWidth * scale, 0.0f, 200.0f);
+
+	*strokePaint = state->stroke;
+
+	if (strokeWidth < ctx->fringeWidth) {
+		// If the stroke width is less than pixel size, use alpha to emulate coverage.
+		// Since coverage is area, scale by alpha*alpha.
+		float alpha = nvg__clampf(strokeWidth / ctx->fringeWidth, 0.0f, 1.0f);
+		strokePaint->innerColor.a *= alpha*alpha;
+		strokePaint->outerColor.a *= alpha*alpha;
+		strokeWidth = ctx->fringeWidth;
+	}
+
+	// Apply global alpha
+	strokePaint->innerColor.a *= state->alpha;
+	strokePaint->outerColor.a *= state->alpha;
+
+	return strokeWidth;
 }
 
-void nvgTextLetterSpacing(NVGcontext* ctx, float spacing)
+static void nvg__renderStroke(NVGcontext* ctx, NVGpathCache* cache, NVGpaint* strokePaint, float strokeWidth)
 {
 	NVGstate* state = nvg__getState(ctx);
-	state->letterSpacing = spacing;
+	const NVGpath* path;
+	int i;
+
+	nvg__flushJobs(ctx);
+	ctx->params.renderStroke(ctx->params.userPtr, strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+							 strokeWidth, cache->paths, cache->npaths);
+
+	// Count triangles
+	for (i = 0; i < cache->npaths; i++) {
+		path = &cache->paths[i];
+		ctx->strokeTriCount += path->nstroke-2;
+		ctx->vertCount += path->nstroke;
+		ctx->drawCallCount++;
+	}
 }
 
-void nvgTextLineHeight(NVGcontext* ctx, float lineHeight)
+// Padding around the path bounds covered by a stroke, in window space.
+static float nvg__strokePadding(NVGcontext* ctx, float strokeWidth)
 {
 	NVGstate* state = nvg__getState(ctx);
-	state->lineHeight = lineHeight;
+	// Square caps reach sqrt(2) half widths from the end point, miters up to the miter limit.
+	float reach = state->lineJoin == NVG_MITER ? nvg__maxf(state->miterLimit, 1.5f) : 1.5f;
+	return strokeWidth*0.5f*reach + ctx->fringeWidth;
 }
 
-void nvgTextAlign(NVGcontext* ctx, int align)
+int nvgIsRectVisible(NVGcontext* ctx, float x, float y, float w, float h)
 {
 	NVGstate* state = nvg__getState(ctx);
-	state->textAlign = align;
+	float rect[4] = { x, y, x+w, y+h }, bounds[4];
+	nvg__transformBounds(bounds, rect, state->xform);
+	return nvg__boundsVisible(ctx, bounds, 0.0f);
 }
 
-void nvgFontFaceId(NVGcontext* ctx, int font)
+void nvgFill(NVGcontext* ctx)
 {
 	NVGstate* state = nvg__getState(ctx);
-	state->fontId = font;
+
+	if (!nvg__boundsVisible(ctx, ctx->commandBounds, ctx->fringeWidth)) {
+		ctx->culledCount++;
+		return;
+	}
+
+	if (nvg__deferred(ctx)) {
+		NVGpaint fillPaint;
+		NVGdrawJob* job;
+		nvg__fillPaint(ctx, &fillPaint);
+		job = nvg__allocJob(ctx, NVG_JOB_FILL, &fillPaint);
+		if (job == NULL) return;
+		job->fringe = (ctx->params.edgeAntiAlias && state->shapeAntiAlias) ? ctx->fringeWidth : 0.0f;
+		if (!nvg__recordJobCommands(ctx, job))
+			ctx->njobs--;
+		return;
+	}
+
+	nvg__flattenPaths(ctx, ctx->cache, ctx->commands, ctx->ncommands);
+	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
+		nvg__expandFill(ctx, ctx->cache, ctx->fringeWidth, NVG_MITER, 2.4f);
+	else
+		nvg__expandFill(ctx, ctx->cache, 0.0f, NVG_MITER, 2.4f);
+
+	nvg__renderFill(ctx, ctx->cache);
 }
 
-void nvgFontFace(NVGcontext* ctx, const char* font)
+void nvgStroke(NVGcontext* ctx)
 {
 	NVGstate* state = nvg__getState(ctx);
-	state->fontId = fonsGetFontByName(ctx->fs, font);
+	NVGpaint strokePaint;
+	float strokeWidth = nvg__strokeWidth(ctx, state->xform, &strokePaint);
+
+	if (!nvg__boundsVisible(ctx, ctx->commandBounds, nvg__strokePadding(ctx, strokeWidth))) {
+		ctx->culledCount++;
+		return;
+	}
+
+	if (nvg__deferred(ctx)) {
+		NVGdrawJob* job = nvg__allocJob(ctx, NVG_JOB_STROKE, &strokePaint);
+		if (job == NULL) return;
+		job->fringe = (ctx->params.edgeAntiAlias && state->shapeAntiAlias) ? ctx->fringeWidth : 0.0f;
+		job->strokeWidth = strokeWidth;
+		job->lineCap = state->lineCap;
+		job->lineJoin = state->lineJoin;
+		job->miterLimit = state->miterLimit;
+		if (!nvg__recordJobCommands(ctx, job))
+			ctx->njobs--;
+		return;
+	}
+
+	nvg__flattenPaths(ctx, ctx->cache, ctx->commands, ctx->ncommands);
+
+	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
+		nvg__expandStroke(ctx, ctx->cache, strokeWidth*0.5f, ctx->fringeWidth, state->lineCap, state->lineJoin, state->miterLimit);
+	else
+		nvg__expandStroke(ctx, ctx->cache, strokeWidth*0.5f, 0.0f, state->lineCap, state->lineJoin, state->miterLimit);
+
+	nvg__renderStroke(ctx, ctx->cache, &strokePaint, strokeWidth);
 }
 
-static float nvg__quantize(float a, float d)
+// Retained paths
+static NVGretainedPath* nvg__getRetainedPath(NVGcontext* ctx, int handle)
 {
-	return ((int)(a / d + 0.5f)) * d;
+	if (handle < 1 || handle > ctx->nretainedPaths)
+		return NULL;
+	return ctx->retainedPaths[handle-1];
 }
 
-static float nvg__getFontScale(NVGstate* state)
+static void nvg__translateVerts(NVGvertex* verts, int nverts, float dx, float dy)
 {
-	return nvg__minf(nvg__quantize(nvg__getAverageScale(state->xform), 0.01f), 4.0f);
+	int i;
+	for (i = 0; i < nverts; i++) {
+		verts[i].x += dx;
+		verts[i].y += dy;
+	}
 }
 
-static void nvg__flushTextTexture(NVGcontext* ctx)
+// Makes sure the flattened points of the retained cache match the transform.
+// Returns 0 if the geometry could not be built.
+static int nvg__updateRetainedCache(NVGcontext* ctx, NVGretainedPath* path, NVGretainedCache* rc, const float* xform)
 {
-	int dirty[4];
-
-	if (fonsValidateTexture(ctx->fs, dirty)) {
-		int fontImage = ctx->fontImages[ctx->fontImageIdx];
-		// Update texture
-		if (fontImage != 0) {
-			int iw, ih;
-			const unsigned char* data = fonsGetTextureData(ctx->fs, &iw, &ih);
-			int x = dirty[0];
-			int y = dirty[1];
-			int w = dirty[2] - dirty[0];
-			int h = dirty[3] - dirty[1];
-			ctx->params.renderUpdateTexture(ctx->params.userPtr, fontImage, x,y, w,h, data);
+	NVGpathCache* cache;
+	float dx, dy;
+	int i;
+
+	if (rc->cache == NULL) {
+		rc->cache = nvg__allocPathCache();
+		if (rc->cache == NULL) return 0;
+	}
+	cache = rc->cache;
+
+	dx = xform[4] - rc->xform[4];
+	dy = xform[5] - rc->xform[5];
+
+	// Moving the geometry in place accumulates rounding error, so it is rebuilt every so often.
+	if (!rc->flattened || rc->tessTol != ctx->tessTol ||
+		((dx != 0.0f || dy != 0.0f) && rc->moves >= NVG_RETAINED_MOVES) ||
+		rc->xform[0] != xform[0] || rc->xform[1] != xform[1] ||
+		rc->xform[2] != xform[2] || rc->xform[3] != xform[3]) {
+		// Scale, rotation or tolerance changed, the path needs to be flattened again.
+		if (path->ncommands > ctx->cscratchCommands) {
+			float* commands = (float*)NVG_REALLOC(ctx->scratchCommands, sizeof(float)*path->ncommands);
+			if (commands == NULL) return 0;
+			ctx->scratchCommands = commands;
+			ctx->cscratchCommands = path->ncommands;
 		}
+		nvg__transformCommands(ctx->scratchCommands, path->commands, path->ncommands, xform);
+
+		cache->npoints = 0;
+		cache->npaths = 0;
+		nvg__flattenPaths(ctx, cache, ctx->scratchCommands, path->ncommands);
+
+		memcpy(rc->xform, xform, sizeof(float)*6);
+		rc->tessTol = ctx->tessTol;
+		rc->flattened = 1;
+		rc->expanded = 0;
+		rc->moves = 0;
+		return 1;
 	}
-}
 
-static int nvg__allocTextAtlas(NVGcontext* ctx)
-{
-	int iw, ih;
-	nvg__flushTextTexture(ctx);
-	if (ctx->fontImageIdx >= NVG_MAX_FONTIMAGES-1)
-		return 0;
-	// if next fontImage already have a texture
-	if (ctx->fontImages[ctx->fontImageIdx+1] != 0)
-		nvgImageSize(ctx, ctx->fontImages[ctx->fontImageIdx+1], &iw, &ih);
-	else { // calculate the new font image size and create it.
-		nvgImageSize(ctx, ctx->fontImages[ctx->fontImageIdx], &iw, &ih);
-		if (iw > ih)
-			ih *= 2;
-		else
-			iw *= 2;
-		if (iw > NVG_MAX_FONTIMAGE_SIZE || ih > NVG_MAX_FONTIMAGE_SIZE)
-			iw = ih = NVG_MAX_FONTIMAGE_SIZE;
-		ctx->fontImages[ctx->fontImageIdx+1] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, iw, ih, 0, NULL);
+	// Pure translation, move the cached geometry in place.
+	if (dx != 0.0f || dy != 0.0f) {
+		for (i = 0; i < cache->npoints; i++) {
+			cache->points[i].x += dx;
+			cache->points[i].y += dy;
+		}
+		cache->bounds[0] += dx;
+		cache->bounds[1] += dy;
+		cache->bounds[2] += dx;
+		cache->bounds[3] += dy;
+		if (rc->expanded) {
+			for (i = 0; i < cache->npaths; i++) {
+				NVGpath* p = &cache->paths[i];
+				nvg__translateVerts(p->fill, p->nfill, dx, dy);
+				nvg__translateVerts(p->stroke, p->nstroke, dx, dy);
+			}
+		}
+		rc->xform[4] = xform[4];
+		rc->xform[5] = xform[5];
+		rc->moves++;
 	}
-	++ctx->fontImageIdx;
-	fonsResetAtlas(ctx->fs, iw, ih);
+
 	return 1;
 }
 
-static void nvg__renderText(NVGcontext* ctx, NVGvertex* verts, int nverts)
+static void nvg__fillRetainedPath(NVGcontext* ctx, NVGretainedPath* path, const float* xform)
 {
 	NVGstate* state = nvg__getState(ctx);
-	NVGpaint paint = state->fill;
+	NVGretainedCache* rc = &path->fill;
+	float fringe = (ctx->params.edgeAntiAlias && state->shapeAntiAlias) ? ctx->fringeWidth : 0.0f;
+	float bounds[4];
 
-	// Render triangles.
-	paint.image = ctx->fontImages[ctx->fontImageIdx];
+	nvg__transformBounds(bounds, path->bounds, xform);
+	if (!nvg__boundsVisible(ctx, bounds, ctx->fringeWidth)) {
+		ctx->culledCount++;
+		return;
+	}
 
-	// Apply global alpha
-	paint.innerColor.a *= state->alpha;
-	paint.outerColor.a *= state->alpha;
+	if (!nvg__updateRetainedCache(ctx, path, rc, xform)) return;
+
+	if (!rc->expanded || rc->fringe != fringe) {
+		if (!nvg__expandFill(ctx, rc->cache, fringe, NVG_MITER, 2.4f)) {
+			rc->expanded = 0;
+			return;
+		}
+		rc->fringe = fringe;
+		rc->expanded = 1;
+	}
 
-	ctx->params.renderTriangles(ctx->params.userPtr, &paint, state->compositeOperation, &state->scissor, verts, nverts, ctx->fringeWidth);
+	if (nvg__deferred(ctx)) {
+		NVGpaint fillPaint;
+		nvg__fillPaint(ctx, &fillPaint);
+		nvg__deferGeometry(ctx, NVG_JOB_FILL, &fillPaint, 0.0f, rc->cache);
+		return;
+	}
 
-	ctx->drawCallCount++;
-	ctx->textTriCount += nverts/3;
+	nvg__renderFill(ctx, rc->cache);
 }
 
-float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end)
+static void nvg__strokeRetainedPath(NVGcontext* ctx, NVGretainedPath* path, const float* xform)
 {
 	NVGstate* state = nvg__getState(ctx);
-	FONStextIter iter, prevIter;
-	FONSquad q;
-	NVGvertex* verts;
-	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
-	float invscale = 1.0f / scale;
-	int cverts = 0;
-	int nverts = 0;
+	NVGretainedCache* rc = &path->stroke;
+	NVGpaint strokePaint;
+	float strokeWidth = nvg__strokeWidth(ctx, xform, &strokePaint);
+	float fringe = (ctx->params.edgeAntiAlias && state->shapeAntiAlias) ? ctx->fringeWidth : 0.0f;
+	float bounds[4];
 
-	if (end == NULL)
-		end = string + strlen(string);
+	nvg__transformBounds(bounds, path->bounds, xform);
+	if (!nvg__boundsVisible(ctx, bounds, nvg__strokePadding(ctx, strokeWidth))) {
+		ctx->culledCount++;
+		return;
+	}
+
+	if (!nvg__updateRetainedCache(ctx, path, rc, xform)) return;
+
+	if (!rc->expanded || rc->width != strokeWidth || rc->fringe != fringe ||
+		rc->lineCap != state->lineCap || rc->lineJoin != state->lineJoin || rc->miterLimit != state->miterLimit) {
+		if (!nvg__expandStroke(ctx, rc->cache, strokeWidth*0.5f, fringe, state->lineCap, state->lineJoin, state->miterLimit)) {
+			rc->expanded = 0;
+			return;
+		}
+		rc->width = strokeWidth;
+		rc->fringe = fringe;
+		rc->lineCap = state->lineCap;
+		rc->lineJoin = state->lineJoin;
+		rc->miterLimit = state->miterLimit;
+		rc->expanded = 1;
+	}
+
+	if (nvg__deferred(ctx)) {
+		nvg__deferGeometry(ctx, NVG_JOB_STROKE, &strokePaint, strokeWidth, rc->cache);
+		return;
+	}
+
+	nvg__renderStroke(ctx, rc->cache, &strokePaint, strokeWidth);
+}
+
+int nvgCreatePath(NVGcontext* ctx)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGretainedPath* path = NULL;
+	float inv[6];
+	int i;
+
+	if (ctx->ncommands == 0) return 0;
+	if (!nvgTransformInverse(inv, state->xform)) return 0;
+
+	path = (NVGretainedPath*)NVG_MALLOC(sizeof(NVGretainedPath));
+	if (path == NULL) goto error;
+	memset(path, 0, sizeof(NVGretainedPath));
+
+	// Commands are stored transformed, bring them back to the local space.
+	path->commands = (float*)NVG_MALLOC(sizeof(float)*ctx->ncommands);
+	if (path->commands == NULL) goto error;
+	nvg__transformCommands(path->commands, ctx->commands, ctx->ncommands, inv);
+	path->ncommands = ctx->ncommands;
+	nvg__clearBounds(path->bounds);
+	nvg__commandBounds(path->bounds, path->commands, path->ncommands);
+
+	// Reuse free slot if possible.
+	for (i = 0; i < ctx->nretainedPaths; i++) {
+		if (ctx->retainedPaths[i] == NULL)
+			break;
+	}
+	if (i == ctx->nretainedPaths) {
+		if (ctx->nretainedPaths+1 > ctx->cretainedPaths) {
+			NVGretainedPath** paths;
+			int cpaths = ctx->nretainedPaths+1 + ctx->cretainedPaths/2;
+			paths = (NVGretainedPath**)NVG_REALLOC(ctx->retainedPaths, sizeof(NVGretainedPath*)*cpaths);
+			if (paths == NULL) goto error;
+			ctx->retainedPaths = paths;
+			ctx->cretainedPaths = cpaths;
+		}
+		ctx->nretainedPaths++;
+	}
+	ctx->retainedPaths[i] = path;
+
+	return i+1;
+
+error:
+	nvg__deleteRetainedPath(path);
+	return 0;
+}
+
+void nvgFillPath(NVGcontext* ctx, int handle)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGretainedPath* path = nvg__getRetainedPath(ctx, handle);
+	if (path == NULL) return;
+	nvg__fillRetainedPath(ctx, path, state->xform);
+}
+
+void nvgStrokePath(NVGcontext* ctx, int handle)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGretainedPath* path = nvg__getRetainedPath(ctx, handle);
+	if (path == NULL) return;
+	nvg__strokeRetainedPath(ctx, path, state->xform);
+}
+
+void nvgDeletePath(NVGcontext* ctx, int handle)
+{
+	NVGretainedPath* path = nvg__getRetainedPath(ctx, handle);
+	if (path == NULL) return;
+	nvg__deleteRetainedPath(path);
+	ctx->retainedPaths[handle-1] = NULL;
+}
+
+// Add fonts
+int nvgCreateFont(NVGcontext* ctx, const char* name, const char* filename)
+{
+	return fonsAddFont(ctx->fs, name, filename, 0);
+}
+
+int nvgCreateFontAtIndex(NVGcontext* ctx, const char* name, const char* filename, const int fontIndex)
+{
+	return fonsAddFont(ctx->fs, name, filename, fontIndex);
+}
+
+int nvgCreateFontMem(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData)
+{
+	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, 0);
+}
+
+int nvgCreateFontMemAtIndex(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData, const int fontIndex)
+{
+	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, fontIndex);
+}
+
+int nvgFindFont(NVGcontext* ctx, const char* name)
+{
+	if (name == NULL) return -1;
+	return fonsGetFontByName(ctx->fs, name);
+}
+
+
+int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont)
+{
+	if(baseFont == -1 || fallbackFont == -1) return 0;
+	return fonsAddFallbackFont(ctx->fs, baseFont, fallbackFont);
+}
+
+int nvgAddFallbackFont(NVGcontext* ctx, const char* baseFont, const char* fallbackFont)
+{
+	return nvgAddFallbackFontId(ctx, nvgFindFont(ctx, baseFont), nvgFindFont(ctx, fallbackFont));
+}
+
+void nvgResetFallbackFontsId(NVGcontext* ctx, int baseFont)
+{
+	fonsResetFallbackFont(ctx->fs, baseFont);
+}
+
+void nvgResetFallbackFonts(NVGcontext* ctx, const char* baseFont)
+{
+	nvgResetFallbackFontsId(ctx, nvgFindFont(ctx, baseFont));
+}
+
+// State setting
+void nvgFontSize(NVGcontext* ctx, float size)
+{
+	NVGstate* state = nvg__getState(ctx);
+	state->fontSize = size;
+}
+
+void nvgFontBlur(NVGcontext* ctx, float blur)
+{
+	NVGstate* state = nvg__getState(ctx);
+	state->fontBlur = blur;
+}
+
+void nvgTextLetterSpacing(NVGcontext* ctx, float spacing)
+{
+	NVGstate* state = nvg__getState(ctx);
+	state->letterSpacing = spacing;
+}
+
+void nvgTextOutlineSize(NVGcontext* ctx, float size)
+{
+	ctx->outlineTextSize = nvg__maxf(size, 0.0f);
+}
+
+void nvgTextLineHeight(NVGcontext* ctx, float lineHeight)
+{
+	NVGstate* state = nvg__getState(ctx);
+	state->lineHeight = lineHeight;
+}
+
+void nvgTextAlign(NVGcontext* ctx, int align)
+{
+	NVGstate* state = nvg__getState(ctx);
+	state->textAlign = align;
+}
+
+void nvgFontFaceId(NVGcontext* ctx, int font)
+{
+	NVGstate* state = nvg__getState(ctx);
+	state->fontId = font;
+}
+
+void nvgFontFace(NVGcontext* ctx, const char* font)
+{
+	NVGstate* state = nvg__getState(ctx);
+	state->fontId = fonsGetFontByName(ctx->fs, font);
+}
+
+static float nvg__quantize(float a, float d)
+{
+	return ((int)(a / d + 0.5f)) * d;
+}
+
+static float nvg__getFontScale(NVGstate* state)
+{
+	return nvg__minf(nvg__quantize(nvg__getAverageScale(state->xform), 0.01f), 4.0f);
+}
+
+static int nvg__fontImage(NVGcontext* ctx, int page)
+{
+	// Pages added by the font stash get their texture on first use.
+	if (ctx->fontImages[page] == 0) {
+		int iw, ih;
+		fonsGetPageData(ctx->fs, page, &iw, &ih);
+		ctx->fontImages[page] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, iw, ih, ctx->params.sdfText ? NVG_IMAGE_SDF : 0, NULL);
+	}
+	return ctx->fontImages[page];
+}
+
+static void nvg__glyphWorker(NVGcontext* ctx, int worker)
+{
+	int i, n = fonsGetPendingGlyphCount(ctx->fs);
+	if (worker >= FONS_MAX_SCRATCH) return;
+	while ((i = nvg__atomicAdd(&ctx->nextGlyph, 1)) < n)
+		fonsRasterizePendingGlyph(ctx->fs, i, worker);
+}
+
+// Rasterizes the glyphs placed in the atlas since the last flush, in parallel when there are enough of them.
+static void nvg__rasterizeGlyphs(NVGcontext* ctx)
+{
+	int n = fonsGetPendingGlyphCount(ctx->fs);
+	if (n == 0) return;
+	ctx->nextGlyph = 0;
+	if (n >= NVG_PARALLEL_GLYPHS)
+		nvg__runWorkers(ctx, nvg__glyphWorker);
+	else
+		nvg__glyphWorker(ctx, 0);
+	fonsClearPendingGlyphs(ctx->fs);
+}
+
+static void nvg__flushTextTexture(NVGcontext* ctx)
+{
+	int i, dirty[4];
+	int npages;
+
+	nvg__rasterizeGlyphs(ctx);
+	npages = nvg__mini(fonsGetPageCount(ctx->fs), NVG_MAX_FONTIMAGES);
+
+	for (i = 0; i < npages; i++) {
+		if (fonsValidatePage(ctx->fs, i, dirty)) {
+			const unsigned char* data = fonsGetPageData(ctx->fs, i, NULL, NULL);
+			// Update texture
+			if (nvg__fontImage(ctx, i) != 0) {
+				int x = dirty[0];
+				int y = dirty[1];
+				int w = dirty[2] - dirty[0];
+				int h = dirty[3] - dirty[1];
+				ctx->params.renderUpdateTexture(ctx->params.userPtr, ctx->fontImages[i], x,y, w,h, data);
+				ctx->atlasUploadBytes += w*h;
+			}
+		}
+	}
+}
+
+// Text drawn so far samples the old textures, keep them until the frame ends.
+static void nvg__retireFontImages(NVGcontext* ctx)
+{
+	int i;
+	for (i = 0; i < NVG_MAX_FONTIMAGES; i++) {
+		if (ctx->fontImages[i] != 0) {
+			ctx->retiredFontImages[ctx->nretiredFontImages++] = ctx->fontImages[i];
+			ctx->fontImages[i] = 0;
+		}
+	}
+}
+
+static int nvg__allocTextAtlas(NVGcontext* ctx)
+{
+	int iw = 0, ih = 0;
+	nvg__flushTextTexture(ctx);
+	if (ctx->nretiredFontImages + NVG_MAX_FONTIMAGES > NVG_MAX_RETIRED_FONTIMAGES)
+		return 0;
+	// calculate the new atlas size and grow every page to it.
+	fonsGetAtlasSize(ctx->fs, &iw, &ih);
+	if (iw >= NVG_MAX_FONTIMAGE_SIZE && ih >= NVG_MAX_FONTIMAGE_SIZE)
+		return 0;
+	if (iw > ih)
+		ih *= 2;
+	else
+		iw *= 2;
+	if (iw > NVG_MAX_FONTIMAGE_SIZE || ih > NVG_MAX_FONTIMAGE_SIZE)
+		iw = ih = NVG_MAX_FONTIMAGE_SIZE;
+	if (!fonsExpandAtlas(ctx->fs, iw, ih))
+		return 0;
+	nvg__retireFontImages(ctx);
+	return 1;
+}
+
+// Text is drawn as glyph instances when the back-end takes them and the glyphs stay axis aligned.
+// Mirrored glyphs keep going through renderTriangles(), which culls them as back faces.
+static int nvg__glyphInstances(NVGcontext* ctx, NVGstate* state)
+{
+	return ctx->params.renderGlyphs != NULL && state->xform[1] == 0.0f && state->xform[2] == 0.0f &&
+		state->xform[0]*state->xform[3] > 0.0f;
+}
+
+// Records nquads glyphs, either six vertices or one glyph instance per glyph.
+static void nvg__renderText(NVGcontext* ctx, const void* quads, int nquads, int page, int glyphs)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGpaint paint = state->fill;
+	NVGdrawJob* job = ctx->njobs > 0 ? &ctx->jobs[ctx->njobs-1] : NULL;
+	int type = glyphs ? NVG_JOB_GLYPHS : NVG_JOB_TRIANGLES;
+	int count = glyphs ? nquads : nquads*6;
+	int* n;
+
+	// Render triangles.
+	paint.image = nvg__fontImage(ctx, page);
+
+	if (ctx->params.sdfText) {
+		// The field falls from 0.5 to 0 over FONS_SDF_PAD pixels of a FONS_SDF_SIZE glyph.
+		float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+		float step = 0.5f / FONS_SDF_PAD * FONS_SDF_SIZE / nvg__maxf(state->fontSize*scale, 1.0f);
+		paint.radius = step;
+		paint.feather = state->fontBlur*scale * step;
+	}
+
+	// Apply global alpha
+	paint.innerColor.a *= state->alpha;
+	paint.outerColor.a *= state->alpha;
+
+	// Text is submitted with the next fill or stroke or at the end of the frame.
+	if (glyphs) {
+		if (ctx->njobGlyphs+count > ctx->cjobGlyphs) {
+			NVGglyphInstance* jglyphs;
+			int cglyphs = ctx->njobGlyphs+count + ctx->cjobGlyphs/2;
+			jglyphs = (NVGglyphInstance*)NVG_REALLOC(ctx->jobGlyphs, sizeof(NVGglyphInstance)*cglyphs);
+			if (jglyphs == NULL) return;
+			ctx->jobGlyphs = jglyphs;
+			ctx->cjobGlyphs = cglyphs;
+		}
+		n = &ctx->njobGlyphs;
+	} else {
+		if (ctx->njobVerts+count > ctx->cjobVerts) {
+			NVGvertex* jverts;
+			int cverts = ctx->njobVerts+count + ctx->cjobVerts/2;
+			jverts = (NVGvertex*)NVG_REALLOC(ctx->jobVerts, sizeof(NVGvertex)*cverts);
+			if (jverts == NULL) return;
+			ctx->jobVerts = jverts;
+			ctx->cjobVerts = cverts;
+		}
+		n = &ctx->njobVerts;
+	}
+	// Extend the previous text draw when nothing else came in between and the state matches.
+	if (job == NULL || job->type != type || job->first+job->count != *n ||
+		memcmp(&job->paint, &paint, sizeof(paint)) != 0 ||
+		memcmp(&job->compositeOperation, &state->compositeOperation, sizeof(state->compositeOperation)) != 0 ||
+		memcmp(&job->scissor, &state->scissor, sizeof(state->scissor)) != 0) {
+		job = nvg__allocJob(ctx, type, &paint);
+		if (job == NULL) return;
+		job->first = *n;
+	}
+	if (glyphs)
+		memcpy(&ctx->jobGlyphs[*n], quads, sizeof(NVGglyphInstance)*count);
+	else
+		memcpy(&ctx->jobVerts[*n], quads, sizeof(NVGvertex)*count);
+	job->count += count;
+	*n += count;
+}
+
+static void nvg__renderTextPages(NVGcontext* ctx, unsigned char* quads, int nquads, const unsigned char* pages, unsigned char* sorted, int glyphs)
+{
+	// Issue one draw per atlas page the glyph quads are on.
+	unsigned int used = 0;
+	int size = glyphs ? (int)sizeof(NVGglyphInstance) : (int)sizeof(NVGvertex)*6;
+	int i, n, page;
+
+	for (i = 0; i < nquads; i++)
+		used |= 1u << pages[i];
+	if ((used & (used-1)) == 0) {
+		nvg__renderText(ctx, quads, nquads, nquads > 0 ? pages[0] : 0, glyphs);
+		return;
+	}
+	for (page = 0; page < NVG_MAX_FONTIMAGES; page++) {
+		if ((used & (1u << page)) == 0)
+			continue;
+		for (i = n = 0; i < nquads; i++) {
+			if (pages[i] == page) {
+				memcpy(&sorted[n*size], &quads[i*size], size);
+				n++;
+			}
+		}
+		nvg__renderText(ctx, sorted, n, page, glyphs);
+	}
+}
+
+static unsigned int nvg__hashTextRun(const char* string, int n, int font, int align, float size)
+{
+	// FNV-1a of the string, the font, alignment and size.
+	unsigned int h = 2166136261u;
+	int i;
+	for (i = 0; i < n; i++)
+		h = (h ^ (unsigned char)string[i]) * 16777619u;
+	h = (h ^ (unsigned int)font) * 16777619u;
+	h = (h ^ (unsigned int)align) * 16777619u;
+	h = (h ^ (unsigned int)(size*10.0f)) * 16777619u;
+	return h;
+}
+
+static int nvg__matchTextRun(NVGtextRun* run, const NVGtextRun* key, const char* string)
+{
+	return run->hash == key->hash && run->font == key->font && run->align == key->align &&
+		run->size == key->size && run->spacing == key->spacing && run->blur == key->blur &&
+		run->fx == key->fx && run->fy == key->fy &&
+		run->ntext == key->ntext && memcmp(run->text, string, key->ntext) == 0;
+}
+
+// Makes room for the string and up to one quad per byte of it.
+static int nvg__reserveTextRun(NVGtextRun* run, const char* string, int n)
+{
+	int offset = (n + (int)sizeof(float)-1) & ~((int)sizeof(float)-1);
+	int capacity = offset + n*(int)sizeof(FONSquad);
+	if (capacity > run->capacity) {
+		char* text = (char*)NVG_REALLOC(run->text, capacity);
+		if (text == NULL) return 0;
+		run->text = text;
+		run->capacity = capacity;
+	}
+	memcpy(run->text, string, n);
+	run->quads = (FONSquad*)&run->text[offset];
+	return 1;
+}
+
+static void nvg__textQuad(NVGvertex* verts, const float* xform, const FONSquad* q, float invscale)
+{
+	float c[4*2];
+	// Transform corners.
+	nvgTransformPoint(&c[0],&c[1], xform, q->x0*invscale, q->y0*invscale);
+	nvgTransformPoint(&c[2],&c[3], xform, q->x1*invscale, q->y0*invscale);
+	nvgTransformPoint(&c[4],&c[5], xform, q->x1*invscale, q->y1*invscale);
+	nvgTransformPoint(&c[6],&c[7], xform, q->x0*invscale, q->y1*invscale);
+	// Create triangles
+	nvg__vset(&verts[0], c[0], c[1], q->s0, q->t0);
+	nvg__vset(&verts[1], c[4], c[5], q->s1, q->t1);
+	nvg__vset(&verts[2], c[2], c[3], q->s1, q->t0);
+	nvg__vset(&verts[3], c[0], c[1], q->s0, q->t0);
+	nvg__vset(&verts[4], c[6], c[7], q->s0, q->t1);
+	nvg__vset(&verts[5], c[4], c[5], q->s1, q->t1);
+}
+
+static void nvg__textGlyph(NVGglyphInstance* glyph, const float* xform, const FONSquad* q, float invscale)
+{
+	// The transform has no rotation or skew, the corners move independently in x and y.
+	glyph->x = xform[0]*q->x0*invscale + xform[4];
+	glyph->y = xform[3]*q->y0*invscale + xform[5];
+	glyph->w = xform[0]*q->x1*invscale + xform[4] - glyph->x;
+	glyph->h = xform[3]*q->y1*invscale + xform[5] - glyph->y;
+	glyph->s0 = q->s0;
+	glyph->t0 = q->t0;
+	glyph->s1 = q->s1;
+	glyph->t1 = q->t1;
+	glyph->page = q->page;
+}
+
+// Writes glyph i of the text temp buffer.
+static void nvg__textOutput(unsigned char* quads, int i, int glyphs, const float* xform, const FONSquad* q, float invscale)
+{
+	if (glyphs)
+		nvg__textGlyph(&((NVGglyphInstance*)quads)[i], xform, q, invscale);
+	else
+		nvg__textQuad(&((NVGvertex*)quads)[i*6], xform, q, invscale);
+}
+
+// Converts the glyph shape to path commands, marking each contour solid or hole by its direction.
+static int nvg__glyphCommands(float* commands, const FONSshapeVertex* verts, int nverts)
+{
+	int i, n = 0, contour = -1;
+	float area = 0.0f, sx = 0.0f, sy = 0.0f, px = 0.0f, py = 0.0f;
+
+	for (i = 0; i <= nverts; i++) {
+		const FONSshapeVertex* v = i < nverts ? &verts[i] : NULL;
+		if ((v == NULL || v->type == FONS_SHAPE_MOVE) && contour >= 0) {
+			area += px*sy - sx*py;
+			commands[n++] = NVG_CLOSE;
+			commands[n++] = NVG_WINDING;
+			commands[n++] = (float)(area > 0.0f ? NVG_CCW : NVG_CW);
+		}
+		if (v == NULL) break;
+		if (v->type == FONS_SHAPE_MOVE) {
+			contour = n;
+			area = 0.0f;
+			sx = px = v->x;
+			sy = py = -v->y;
+			commands[n++] = NVG_MOVETO;
+			commands[n++] = px;
+			commands[n++] = py;
+			continue;
+		}
+		if (contour < 0) continue;
+		// Direction of the contour from the area of its control polygon.
+		if (v->type == FONS_SHAPE_LINE) {
+			commands[n++] = NVG_LINETO;
+		} else if (v->type == FONS_SHAPE_QUAD) {
+			area += px*-v->cy0 - v->cx0*py;
+			px = v->cx0; py = -v->cy0;
+			commands[n++] = NVG_QUADTO;
+			commands[n++] = px;
+			commands[n++] = py;
+		} else {
+			area += px*-v->cy0 - v->cx0*py;
+			area += v->cx0*-v->cy1 - v->cx1*-v->cy0;
+			px = v->cx1; py = -v->cy1;
+			commands[n++] = NVG_BEZIERTO;
+			commands[n++] = v->cx0;
+			commands[n++] = -v->cy0;
+			commands[n++] = px;
+			commands[n++] = py;
+		}
+		area += px*-v->y - v->x*py;
+		px = v->x; py = -v->y;
+		commands[n++] = px;
+		commands[n++] = py;
+	}
+	return n;
+}
+
+// Returns the outline of the glyph as a retained path, built on first use.
+static NVGretainedPath* nvg__glyphOutline(NVGcontext* ctx, int font, int glyph)
+{
+	NVGglyphOutline* outline;
+	NVGretainedPath* path;
+	FONSshapeVertex* verts = NULL;
+	unsigned int h = ((unsigned int)font * 16777619u) ^ ((unsigned int)glyph * 2654435761u);
+	int nverts;
+
+	outline = &ctx->glyphOutlines[(h ^ (h >> 16)) & (NVG_GLYPH_OUTLINES-1)];
+	if (outline->path != NULL && outline->font == font && outline->glyph == glyph)
+		return outline->path;
+
+	nvg__deleteRetainedPath(outline->path);
+	outline->path = NULL;
+
+	path = (NVGretainedPath*)NVG_MALLOC(sizeof(NVGretainedPath));
+	if (path == NULL) return NULL;
+	memset(path, 0, sizeof(NVGretainedPath));
+	nvg__clearBounds(path->bounds);
+
+	// Glyphs without an outline, such as spaces, keep an empty path.
+	nverts = fonsGetGlyphShape(ctx->fs, font, glyph, &verts);
+	if (nverts > 0) {
+		// At most a move, close and winding per vertex, or a curve.
+		path->commands = (float*)NVG_MALLOC(sizeof(float)*nverts*7 + sizeof(float)*3);
+		if (path->commands == NULL) {
+			fonsFreeGlyphShape(ctx->fs, verts);
+			NVG_FREE(path);
+			return NULL;
+		}
+		path->ncommands = nvg__glyphCommands(path->commands, verts, nverts);
+		nvg__commandBounds(path->bounds, path->commands, path->ncommands);
+	}
+	fonsFreeGlyphShape(ctx->fs, verts);
+
+	outline->font = font;
+	outline->glyph = glyph;
+	outline->path = path;
+	return path;
+}
+
+// Draws the rest of the iterated text as filled glyph outlines. Large glyphs take no atlas space
+// and cannot fail to rasterize this way, but the font blur does not apply to them.
+static void nvg__textOutlines(NVGcontext* ctx, FONStextIter* iter, float invscale)
+{
+	NVGstate* state = nvg__getState(ctx);
+	FONSquad q;
+	float xform[6];
+	float unitScale;
+	int font, glyph;
+
+	iter->bitmapOption = FONS_GLYPH_BITMAP_OPTIONAL;
+	while (fonsTextIterNext(ctx->fs, iter, &q)) {
+		NVGretainedPath* path;
+		font = fonsTextIterGlyph(ctx->fs, iter, &glyph, &unitScale);
+		if (font == FONS_INVALID) continue;
+		path = nvg__glyphOutline(ctx, font, glyph);
+		if (path == NULL || path->ncommands == 0) continue;
+		// Font units to the local space of the text, at the pen position of the glyph.
+		nvgTransformScale(xform, unitScale*invscale, unitScale*invscale);
+		xform[4] = iter->glyphx*invscale;
+		xform[5] = iter->y*invscale;
+		nvgTransformMultiply(xform, state->xform);
+		nvg__fillRetainedPath(ctx, path, xform);
+	}
+}
+
+static float nvg__text(NVGcontext* ctx, float x, float y, const char* string, const char* end)
+{
+	NVGstate* state = nvg__getState(ctx);
+	FONStextIter iter, prevIter;
+	FONSquad q;
+	unsigned char* quads;
+	unsigned char* sorted;
+	NVGtextRun key;
+	NVGtextRun* run = NULL;
+	unsigned char* pages;
+	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+	float invscale = 1.0f / scale;
+	float ix = floorf(x*scale), iy = floorf(y*scale);
+	int generation = fonsGetAtlasGeneration(ctx->fs);
+	int glyphs = nvg__glyphInstances(ctx, state);
+	int i, cquads = 0;
+	int nquads = 0;
+
+	if (end == NULL)
+		end = string + strlen(string);
 
 	if (state->fontId == FONS_INVALID) return x;
 
+	// Text too large for the atlas is drawn as paths.
+	if (ctx->outlineTextSize > 0.0f && state->fontSize*scale > ctx->outlineTextSize) {
+		fonsSetSize(ctx->fs, state->fontSize*scale);
+		fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
+		fonsSetBlur(ctx->fs, state->fontBlur*scale);
+		fonsSetAlign(ctx->fs, state->textAlign);
+		fonsSetFont(ctx->fs, state->fontId);
+		fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_OPTIONAL);
+		nvg__textOutlines(ctx, &iter, invscale);
+		return iter.nextx / scale;
+	}
+
+	// Repeated strings reuse the glyph quads laid out last time, moved by whole pixels.
+	memset(&key, 0, sizeof(key));
+	key.ntext = (int)(end - string);
+	key.font = state->fontId;
+	key.align = state->textAlign;
+	key.size = state->fontSize*scale;
+	key.spacing = state->letterSpacing*scale;
+	key.blur = state->fontBlur*scale;
+	key.fx = x*scale - ix;
+	key.fy = y*scale - iy;
+	if (key.ntext > 0 && key.ntext <= NVG_MAX_TEXT_RUN) {
+		key.hash = nvg__hashTextRun(string, key.ntext, key.font, key.align, key.size);
+		run = &ctx->textRuns[key.hash & (NVG_TEXT_RUNS-1)];
+		if (run->generation == generation && nvg__matchTextRun(run, &key, string)) {
+			quads = (unsigned char*)nvg__allocTempVerts(ctx->cache, run->nquads*6*2 + (run->nquads + sizeof(NVGvertex)-1) / sizeof(NVGvertex));
+			if (quads == NULL) return x;
+			sorted = quads + run->nquads*6*sizeof(NVGvertex);
+			pages = sorted + run->nquads*6*sizeof(NVGvertex);
+			for (i = 0; i < run->nquads; i++) {
+				q = run->quads[i];
+				fonsTouchQuad(ctx->fs, &q);
+				q.x0 += ix; q.x1 += ix;
+				q.y0 += iy; q.y1 += iy;
+				pages[i] = (unsigned char)q.page;
+				nvg__textOutput(quads, i, glyphs, state->xform, &q, invscale);
+			}
+			nvg__renderTextPages(ctx, quads, run->nquads, pages, sorted, glyphs);
+			return (run->advance + ix) / scale;
+		}
+		run->hash = 0;
+		if (!nvg__reserveTextRun(run, string, key.ntext))
+			run = NULL;
+	}
+
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
 	fonsSetBlur(ctx->fs, state->fontBlur*scale);
 	fonsSetAlign(ctx->fs, state->textAlign);
 	fonsSetFont(ctx->fs, state->fontId);
 
-	cverts = nvg__maxi(2, (int)(end - string)) * 6; // conservative estimate.
-	verts = nvg__allocTempVerts(ctx, cverts);
-	if (verts == NULL) return x;
+	cquads = nvg__maxi(2, (int)(end - string)); // conservative estimate.
+	// Quads, the quads sorted by atlas page, and the page of each quad. Room is made
+	// for six vertices per quad, glyph instances take less.
+	quads = (unsigned char*)nvg__allocTempVerts(ctx->cache, cquads*6*2 + (cquads + sizeof(NVGvertex)-1) / sizeof(NVGvertex));
+	if (quads == NULL) return x;
+	sorted = quads + cquads*6*sizeof(NVGvertex);
+	pages = sorted + cquads*6*sizeof(NVGvertex);
 
 	fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_REQUIRED);
 	prevIter = iter;
 	while (fonsTextIterNext(ctx->fs, &iter, &q)) {
-		float c[4*2];
 		if (iter.prevGlyphIndex == -1) { // can not retrieve glyph?
-			if (nverts != 0) {
-				nvg__renderText(ctx, verts, nverts);
-				nverts = 0;
+			// Quads laid out so far may point into the old atlas.
+			run = NULL;
+			if (nquads != 0) {
+				nvg__renderTextPages(ctx, quads, nquads, pages, sorted, glyphs);
+				nquads = 0;
 			}
-			if (!nvg__allocTextAtlas(ctx))
-				break; // no memory :(
-			iter = prevIter;
-			fonsTextIterNext(ctx->fs, &iter, &q); // try again
-			if (iter.prevGlyphIndex == -1) // still can not find glyph?
+			if (nvg__allocTextAtlas(ctx)) {
+				iter = prevIter;
+				fonsTextIterNext(ctx->fs, &iter, &q); // try again
+			}
+			if (iter.prevGlyphIndex == -1) { // still can not find glyph?
+				// Too large for the atlas, draw the rest as paths.
+				iter = prevIter;
+				nvg__textOutlines(ctx, &iter, invscale);
 				break;
+			}
 		}
 		prevIter = iter;
-		// Transform corners.
-		nvgTransformPoint(&c[0],&c[1], state->xform, q.x0*invscale, q.y0*invscale);
-		nvgTransformPoint(&c[2],&c[3], state->xform, q.x1*invscale, q.y0*invscale);
-		nvgTransformPoint(&c[4],&c[5], state->xform, q.x1*invscale, q.y1*invscale);
-		nvgTransformPoint(&c[6],&c[7], state->xform, q.x0*invscale, q.y1*invscale);
-		// Create triangles
-		if (nverts+6 <= cverts) {
-			nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
-			nvg__vset(&verts[nverts], c[2], c[3], q.s1, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[6], c[7], q.s0, q.t1); nverts++;
-			nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
+		if (nquads < cquads) {
+			if (run != NULL) {
+				FONSquad* rq = &run->quads[nquads];
+				*rq = q;
+				rq->x0 -= ix; rq->x1 -= ix;
+				rq->y0 -= iy; rq->y1 -= iy;
+			}
+			pages[nquads] = (unsigned char)q.page;
+			nvg__textOutput(quads, nquads, glyphs, state->xform, &q, invscale);
+			nquads++;
 		}
 	}
 
-	// TODO: add back-end bit to do this just once per frame.
-	nvg__flushTextTexture(ctx);
+	if (run != NULL) {
+		key.text = run->text;
+		key.quads = run->quads;
+		key.capacity = run->capacity;
+		key.nquads = nquads;
+		key.advance = iter.nextx - ix;
+		key.generation = fonsGetAtlasGeneration(ctx->fs);
+		*run = key;
+	}
 
-	nvg__renderText(ctx, verts, nverts);
+	nvg__renderTextPages(ctx, quads, nquads, pages, sorted, glyphs);
 
 	return iter.nextx / scale;
 }
 
+int nvgPrewarmGlyphs(NVGcontext* ctx, int font, const float* sizes, int nsizes, const unsigned int* ranges, int nranges)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+	unsigned int c, last;
+	int i, j, ret, n = 0;
+
+	if (font == FONS_INVALID) return 0;
+
+	fonsSetFont(ctx->fs, font);
+	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	for (i = 0; i < nsizes; i++) {
+		fonsSetSize(ctx->fs, sizes[i]*scale);
+		for (j = 0; j < nranges; j++) {
+			last = ranges[j*2+1] < 0x10ffff ? ranges[j*2+1] : 0x10ffff;
+			for (c = ranges[j*2]; c <= last; c++) {
+				ret = fonsPrewarmGlyph(ctx->fs, c);
+				if (ret < 0) {
+					// The atlas is full, grow it and try again.
+					if (!nvg__allocTextAtlas(ctx))
+						goto done;
+					ret = fonsPrewarmGlyph(ctx->fs, c);
+					if (ret < 0)
+						goto done;
+				}
+				n += ret;
+			}
+		}
+	}
+
+done:
+	nvg__flushTextTexture(ctx);
+	return n;
+}
+
+int nvgSaveFontCache(NVGcontext* ctx, const char* path)
+{
+	nvg__rasterizeGlyphs(ctx);
+	return fonsSaveCache(ctx->fs, path);
+}
+
+int nvgLoadFontCache(NVGcontext* ctx, const char* path)
+{
+	int n, iw = 0, ih = 0, w = 0, h = 0;
+
+	if (ctx->nretiredFontImages + NVG_MAX_FONTIMAGES > NVG_MAX_RETIRED_FONTIMAGES)
+		return 0;
+	fonsGetAtlasSize(ctx->fs, &iw, &ih);
+	n = fonsLoadCache(ctx->fs, path);
+	fonsGetAtlasSize(ctx->fs, &w, &h);
+	// The restored pages get new textures, uploaded whole on first use.
+	if (n > 0 || w != iw || h != ih)
+		nvg__retireFontImages(ctx);
+	return n;
+}
+
+float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end)
+{
+#ifdef NVG_PROFILE
+	long long glyphs = ctx->profileTime[NVG_PROFILE_GLYPHS];
+	NVG_PROFILE_BEGIN(start);
+	float ret = nvg__text(ctx, x, y, string, end);
+	NVG_PROFILE_END(ctx, NVG_PROFILE_TEXT, start + ctx->profileTime[NVG_PROFILE_GLYPHS] - glyphs);
+	return ret;
+#else
+	return nvg__text(ctx, x, y, string, end);
+#endif
+}
+
 void nvgTextBox(NVGcontext* ctx, float x, float y, float breakRowWidth, const char* string, const char* end)
 {
 	NVGstate* state = nvg__getState(ctx);
@@ -2551,7 +4467,7 @@ void nvgTextBox(NVGcontext* ctx, float x, float y, float breakRowWidth, const ch
 	state->textAlign = oldAlign;
 }
 
-int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string, const char* end, NVGglyphPosition* positions, int maxPositions)
+static int nvg__textGlyphPositions(NVGcontext* ctx, float x, float y, const char* string, const char* end, NVGglyphPosition* positions, int maxPositions)
 {
 	NVGstate* state = nvg__getState(ctx);
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
@@ -2594,6 +4510,18 @@ int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string,
 	return npos;
 }
 
+int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string, const char* end, NVGglyphPosition* positions, int maxPositions)
+{
+#ifdef NVG_PROFILE
+	NVG_PROFILE_BEGIN(start);
+	int ret = nvg__textGlyphPositions(ctx, x, y, string, end, positions, maxPositions);
+	NVG_PROFILE_END(ctx, NVG_PROFILE_TEXT, start);
+	return ret;
+#else
+	return nvg__textGlyphPositions(ctx, x, y, string, end, positions, maxPositions);
+#endif
+}
+
 enum NVGcodepointType {
 	NVG_SPACE,
 	NVG_NEWLINE,
@@ -2601,7 +4529,7 @@ enum NVGcodepointType {
 	NVG_CJK_CHAR,
 };
 
-int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows)
+static int nvg__textBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows)
 {
 	NVGstate* state = nvg__getState(ctx);
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
@@ -2807,7 +4735,19 @@ int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, floa
 	return nrows;
 }
 
-float nvgTextBounds(NVGcontext* ctx, float x, float y, const char* string, const char* end, float* bounds)
+int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows)
+{
+#ifdef NVG_PROFILE
+	NVG_PROFILE_BEGIN(start);
+	int ret = nvg__textBreakLines(ctx, string, end, breakRowWidth, rows, maxRows);
+	NVG_PROFILE_END(ctx, NVG_PROFILE_TEXT, start);
+	return ret;
+#else
+	return nvg__textBreakLines(ctx, string, end, breakRowWidth, rows, maxRows);
+#endif
+}
+
+static float nvg__textBounds(NVGcontext* ctx, float x, float y, const char* string, const char* end, float* bounds)
 {
 	NVGstate* state = nvg__getState(ctx);
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
@@ -2834,6 +4774,18 @@ float nvgTextBounds(NVGcontext* ctx, float x, float y, const char* string, const
 	return width * invscale;
 }
 
+float nvgTextBounds(NVGcontext* ctx, float x, float y, const char* string, const char* end, float* bounds)
+{
+#ifdef NVG_PROFILE
+	NVG_PROFILE_BEGIN(start);
+	float ret = nvg__textBounds(ctx, x, y, string, end, bounds);
+	NVG_PROFILE_END(ctx, NVG_PROFILE_TEXT, start);
+	return ret;
+#else
+	return nvg__textBounds(ctx, x, y, string, end, bounds);
+#endif
+}
+
 void nvgTextBoxBounds(NVGcontext* ctx, float x, float y, float breakRowWidth, const char* string, const char* end, float* bounds)
 {
 	NVGstate* state = nvg__getState(ctx);
@@ -2925,4 +4877,246 @@ void nvgTextMetrics(NVGcontext* ctx, float* ascender, float* descender, float* l
 	if (lineh != NULL)
 		*lineh *= invscale;
 }
+// Text layouts
+static NVGtextLayout* nvg__getTextLayout(NVGcontext* ctx, int handle)
+{
+	if (handle < 1 || handle > ctx->ntextLayouts)
+		return NULL;
+	return ctx->textLayouts[handle-1];
+}
+
+static int nvg__addLayoutRow(NVGcontext* ctx, NVGtextLayout* layout, const NVGtextRow* row)
+{
+	NVGlayoutRow* lrow;
+	int maxGlyphs = (int)(row->end - row->start);
+	if (layout->nrows+1 > layout->crows) {
+		NVGlayoutRow* rows;
+		int crows = layout->nrows+1 + layout->crows/2;
+		rows = (NVGlayoutRow*)NVG_REALLOC(layout->rows, sizeof(NVGlayoutRow)*crows);
+		if (rows == NULL) return 0;
+		layout->rows = rows;
+		layout->crows = crows;
+	}
+	if (layout->nglyphs+maxGlyphs > layout->cglyphs) {
+		NVGglyphPosition* glyphs;
+		int cglyphs = layout->nglyphs+maxGlyphs + layout->cglyphs/2;
+		glyphs = (NVGglyphPosition*)NVG_REALLOC(layout->glyphs, sizeof(NVGglyphPosition)*cglyphs);
+		if (glyphs == NULL) return 0;
+		layout->glyphs = glyphs;
+		layout->cglyphs = cglyphs;
+	}
+	lrow = &layout->rows[layout->nrows++];
+	lrow->start = (int)(row->start - layout->text);
+	lrow->end = (int)(row->end - layout->text);
+	lrow->width = row->width;
+	lrow->minx = row->minx;
+	lrow->maxx = row->maxx;
+	lrow->firstGlyph = layout->nglyphs;
+	lrow->nglyphs = maxGlyphs > 0 ? nvgTextGlyphPositions(ctx, 0, 0, row->start, row->end, &layout->glyphs[layout->nglyphs], maxGlyphs) : 0;
+	layout->nglyphs += lrow->nglyphs;
+	return 1;
+}
+
+// Breaks the rows again when the width, the text style or the font scale have changed since last time.
+static int nvg__updateTextLayout(NVGcontext* ctx, NVGtextLayout* layout)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+	float invscale = 1.0f / scale;
+	int valign = state->textAlign & (NVG_ALIGN_TOP | NVG_ALIGN_MIDDLE | NVG_ALIGN_BOTTOM | NVG_ALIGN_BASELINE);
+	int oldAlign = state->textAlign;
+	const char* string = layout->text;
+	const char* end = layout->text + layout->ntext;
+	NVGtextRow rows[16];
+	int nrows, i;
+
+	if (state->fontId == FONS_INVALID) return 0;
+	if (layout->font == state->fontId && layout->align == state->textAlign && layout->size == state->fontSize &&
+		layout->spacing == state->letterSpacing && layout->lineHeight == state->lineHeight && layout->scale == scale)
+		return 1;
+
+	layout->font = FONS_INVALID;
+	layout->nrows = 0;
+	layout->nglyphs = 0;
+
+	nvgTextMetrics(ctx, NULL, NULL, &layout->lineh);
+	layout->lineh *= state->lineHeight;
+
+	state->textAlign = NVG_ALIGN_LEFT | valign;
+
+	fonsSetSize(ctx->fs, state->fontSize*scale);
+	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
+	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetAlign(ctx->fs, state->textAlign);
+	fonsSetFont(ctx->fs, state->fontId);
+	fonsLineBounds(ctx->fs, 0, &layout->rminy, &layout->rmaxy);
+	layout->rminy *= invscale;
+	layout->rmaxy *= invscale;
+
+	while ((nrows = nvgTextBreakLines(ctx, string, end, layout->breakRowWidth, rows, (int)NVG_COUNTOF(rows)))) {
+		for (i = 0; i < nrows; i++) {
+			if (!nvg__addLayoutRow(ctx, layout, &rows[i])) {
+				state->textAlign = oldAlign;
+				return 0;
+			}
+		}
+		string = rows[nrows-1].next;
+	}
+
+	state->textAlign = oldAlign;
+
+	layout->font = state->fontId;
+	layout->align = state->textAlign;
+	layout->size = state->fontSize;
+	layout->spacing = state->letterSpacing;
+	layout->lineHeight = state->lineHeight;
+	layout->scale = scale;
+	return 1;
+}
+
+// Horizontal offset of a row for the current text align.
+static float nvg__layoutRowOffset(NVGcontext* ctx, NVGtextLayout* layout, NVGlayoutRow* row)
+{
+	NVGstate* state = nvg__getState(ctx);
+	if (state->textAlign & NVG_ALIGN_CENTER)
+		return layout->breakRowWidth*0.5f - row->width*0.5f;
+	if (state->textAlign & NVG_ALIGN_RIGHT)
+		return layout->breakRowWidth - row->width;
+	return 0;
+}
+
+int nvgCreateTextLayout(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth)
+{
+	NVGtextLayout* layout = NULL;
+	int i;
+
+	if (end == NULL)
+		end = string + strlen(string);
+
+	layout = (NVGtextLayout*)NVG_MALLOC(sizeof(NVGtextLayout));
+	if (layout == NULL) goto error;
+	memset(layout, 0, sizeof(NVGtextLayout));
+	layout->font = FONS_INVALID;
+	layout->breakRowWidth = breakRowWidth;
+
+	// The rows point into a copy of the string, so the caller's string can go away.
+	layout->ntext = (int)(end - string);
+	layout->text = (char*)NVG_MALLOC(layout->ntext+1);
+	if (layout->text == NULL) goto error;
+	memcpy(layout->text, string, layout->ntext);
+	layout->text[layout->ntext] = '\0';
+
+	// Reuse free slot if possible.
+	for (i = 0; i < ctx->ntextLayouts; i++) {
+		if (ctx->textLayouts[i] == NULL)
+			break;
+	}
+	if (i == ctx->ntextLayouts) {
+		if (ctx->ntextLayouts+1 > ctx->ctextLayouts) {
+			NVGtextLayout** layouts;
+			int clayouts = ctx->ntextLayouts+1 + ctx->ctextLayouts/2;
+			layouts = (NVGtextLayout**)NVG_REALLOC(ctx->textLayouts, sizeof(NVGtextLayout*)*clayouts);
+			if (layouts == NULL) goto error;
+			ctx->textLayouts = layouts;
+			ctx->ctextLayouts = clayouts;
+		}
+		ctx->ntextLayouts++;
+	}
+	ctx->textLayouts[i] = layout;
+
+	nvg__updateTextLayout(ctx, layout);
+
+	return i+1;
+
+error:
+	nvg__deleteTextLayout(layout);
+	return 0;
+}
+
+void nvgTextLayoutWidth(NVGcontext* ctx, int handle, float breakRowWidth)
+{
+	NVGtextLayout* layout = nvg__getTextLayout(ctx, handle);
+	if (layout == NULL || layout->breakRowWidth == breakRowWidth) return;
+	layout->breakRowWidth = breakRowWidth;
+	layout->font = FONS_INVALID;
+}
+
+void nvgDrawTextLayout(NVGcontext* ctx, int handle, float x, float y)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGtextLayout* layout = nvg__getTextLayout(ctx, handle);
+	int oldAlign = state->textAlign;
+	int i;
+
+	if (layout == NULL || !nvg__updateTextLayout(ctx, layout)) return;
+
+	for (i = 0; i < layout->nrows; i++) {
+		NVGlayoutRow* row = &layout->rows[i];
+		float dx = nvg__layoutRowOffset(ctx, layout, row);
+		state->textAlign = NVG_ALIGN_LEFT | (oldAlign & ~(NVG_ALIGN_LEFT | NVG_ALIGN_CENTER | NVG_ALIGN_RIGHT));
+		nvgText(ctx, x + dx, y, layout->text + row->start, layout->text + row->end);
+		state->textAlign = oldAlign;
+		y += layout->lineh;
+	}
+}
+
+void nvgTextLayoutBounds(NVGcontext* ctx, int handle, float x, float y, float* bounds)
+{
+	NVGtextLayout* layout = nvg__getTextLayout(ctx, handle);
+	float minx = x, miny = y, maxx = x, maxy = y;
+	int i;
+
+	if (layout != NULL && nvg__updateTextLayout(ctx, layout)) {
+		for (i = 0; i < layout->nrows; i++) {
+			NVGlayoutRow* row = &layout->rows[i];
+			float dx = nvg__layoutRowOffset(ctx, layout, row);
+			minx = nvg__minf(minx, x + row->minx + dx);
+			maxx = nvg__maxf(maxx, x + row->maxx + dx);
+			miny = nvg__minf(miny, y + layout->rminy);
+			maxy = nvg__maxf(maxy, y + layout->rmaxy);
+			y += layout->lineh;
+		}
+	} else {
+		minx = miny = maxx = maxy = 0.0f;
+	}
+
+	if (bounds != NULL) {
+		bounds[0] = minx;
+		bounds[1] = miny;
+		bounds[2] = maxx;
+		bounds[3] = maxy;
+	}
+}
+
+int nvgTextLayoutHitTest(NVGcontext* ctx, int handle, float x, float y, float px, float py)
+{
+	NVGtextLayout* layout = nvg__getTextLayout(ctx, handle);
+	NVGlayoutRow* row;
+	int i;
+
+	if (layout == NULL || !nvg__updateTextLayout(ctx, layout)) return -1;
+	if (layout->nrows == 0) return 0;
+
+	// Rows are lineh apart, the point belongs to the row whose span it is in.
+	i = (int)floorf((py - y - layout->rminy) / nvg__maxf(layout->lineh, 1e-6f));
+	row = &layout->rows[nvg__clampi(i, 0, layout->nrows-1)];
+	px -= x + nvg__layoutRowOffset(ctx, layout, row);
+
+	// The caret goes before the first glyph whose center is right of the point.
+	for (i = 0; i < row->nglyphs; i++) {
+		NVGglyphPosition* glyph = &layout->glyphs[row->firstGlyph + i];
+		float next = i+1 < row->nglyphs ? glyph[1].x : row->width;
+		if (px < (glyph->x + next) * 0.5f)
+			return (int)(glyph->str - layout->text);
+	}
+	return row->end;
+}
+
+void nvgDeleteTextLayout(NVGcontext* ctx, int handle)
+{
+	NVGtextLayout* layout = nvg__getTextLayout(ctx, handle);
+	if (layout == NULL) return;
+	nvg__deleteTextLayout(layout);
+	ctx->textLayouts[handle-1] = NULL;
+}
 // vim: ft=c nu noet ts=4
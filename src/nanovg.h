@@ -142,6 +142,7 @@ enum NVGimageFlags {
 	NVG_IMAGE_FLIPY				= 1<<3,		// Flips (inverses) image in Y direction when rendered.
 	NVG_IMAGE_PREMULTIPLIED		= 1<<4,		// Image data has premultiplied alpha.
 	NVG_IMAGE_NEAREST			= 1<<5,		// Image interpolation is Nearest instead Linear
+	NVG_IMAGE_SDF				= 1<<6,		// Alpha image holds a signed distance field with the edge at 0.5, see NVGparams.sdfText.
 };
 
 // Begin drawing a new frame
@@ -441,6 +442,10 @@ void nvgIntersectScissor(NVGcontext* ctx, float x, float y, float w, float h);
 // Reset and disables scissoring.
 void nvgResetScissor(NVGcontext* ctx);
 
+// Returns 1 if the specified rectangle, transformed by the current transform, overlaps
+// the viewport and the current scissor. Can be used to skip drawing offscreen content.
+int nvgIsRectVisible(NVGcontext* ctx, float x, float y, float w, float h);
+
 //
 // Paths
 //
@@ -508,6 +513,36 @@ void nvgFill(NVGcontext* ctx);
 // Fills the current path with current stroke style.
 void nvgStroke(NVGcontext* ctx);
 
+//
+// Retained Paths
+//
+// Static paths which are drawn every frame can be captured once as retained paths.
+// A retained path keeps its flattened and expanded geometry between frames, and only
+// rebuilds it when the scale or rotation of the transform, the stroke style or
+// the antialias setting changes. Moving the path with a pure translation reuses
+// the cached geometry.
+//
+//		nvgBeginPath(vg);
+//		nvgRoundedRect(vg, 0,0, 120,30, 4);
+//		button = nvgCreatePath(vg);
+//		...
+//		nvgTranslate(vg, x,y);
+//		nvgFillPath(vg, button);
+
+// Creates retained path from the current path. The path is stored relative to the current
+// transform, so it is drawn in the same place when the transform is unchanged.
+// Returns handle to the path, or 0 on failure.
+int nvgCreatePath(NVGcontext* ctx);
+
+// Fills retained path with current fill style, transformed by the current transform.
+void nvgFillPath(NVGcontext* ctx, int path);
+
+// Strokes retained path with current stroke style, transformed by the current transform.
+void nvgStrokePath(NVGcontext* ctx, int path);
+
+// Deletes retained path.
+void nvgDeletePath(NVGcontext* ctx, int path);
+
 
 //
 // Text
@@ -543,7 +578,8 @@ void nvgStroke(NVGcontext* ctx);
 // Note: currently only solid color fill is supported for text.
 
 // Creates font by loading it from the disk from specified file name.
-// Returns handle to the font.
+// Returns handle to the font. The file is memory mapped once per process and shared
+// by all contexts that create a font from it.
 int nvgCreateFont(NVGcontext* ctx, const char* name, const char* filename);
 
 // fontIndex specifies which font face to load from a .ttf/.ttc file.
@@ -592,6 +628,11 @@ void nvgFontFaceId(NVGcontext* ctx, int font);
 // Sets the font face based on specified name of current text style.
 void nvgFontFace(NVGcontext* ctx, const char* font);
 
+// Sets the size in device pixels above which text is drawn as filled glyph outlines instead of
+// glyphs from the font atlas, for the whole context. Outlines take no atlas space, but the font
+// blur does not apply to them. 0 draws all text from the atlas. The default is 256.
+void nvgTextOutlineSize(NVGcontext* ctx, float size);
+
 // Draws text string at specified location. If end is specified only the sub-string up to the end is drawn.
 float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end);
 
@@ -624,6 +665,90 @@ void nvgTextMetrics(NVGcontext* ctx, float* ascender, float* descender, float* l
 // Words longer than the max width are slit at nearest character (i.e. no hyphenation).
 int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows);
 
+//
+// Text Layouts
+//
+// Paragraphs drawn every frame can be laid out once as text layouts. A layout keeps its
+// row breaks and glyph positions, and only breaks the rows again when its width, the text
+// style or the scale of the transform changes. Like retained paths, layouts are drawn,
+// measured and hit tested in the local space of the current transform.
+//
+//		para = nvgCreateTextLayout(vg, text, NULL, 300);
+//		...
+//		nvgDrawTextLayout(vg, para, x,y);
+
+// Creates text layout of the string wrapped at the specified width with the current text style,
+// as nvgTextBox() would draw it. The string is copied. Returns handle to the layout, or 0 on failure.
+int nvgCreateTextLayout(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth);
+
+// Sets the width the rows of the text layout are wrapped at.
+void nvgTextLayoutWidth(NVGcontext* ctx, int layout, float breakRowWidth);
+
+// Draws text layout at specified location with the current text style and fill.
+void nvgDrawTextLayout(NVGcontext* ctx, int layout, float x, float y);
+
+// Measures text layout drawn at specified location, same as nvgTextBoxBounds().
+void nvgTextLayoutBounds(NVGcontext* ctx, int layout, float x, float y, float* bounds);
+
+// Returns the byte offset in the layout's string of the caret position closest to point (px,py),
+// for text layout drawn at specified location, or -1 if the layout is not valid.
+int nvgTextLayoutHitTest(NVGcontext* ctx, int layout, float x, float y, float px, float py);
+
+// Deletes text layout.
+void nvgDeleteTextLayout(NVGcontext* ctx, int layout);
+
+// Rasterizes the glyphs of the specified font ahead of time, so that the first frame showing them does not stall.
+// Parameter ranges holds nranges pairs of first and last codepoint, which are added at each of the nsizes font sizes,
+// with the current font blur and transform. The glyphs are rasterized on the worker threads with NVG_THREADED_TESSELLATION.
+// Returns the number of glyphs added to the atlas.
+int nvgPrewarmGlyphs(NVGcontext* ctx, int font, const float* sizes, int nsizes, const unsigned int* ranges, int nranges);
+
+// Saves the glyphs in the font atlas to a file, so that later runs can restore them with nvgLoadFontCache()
+// instead of rasterizing them again at startup. Returns 1 on success.
+int nvgSaveFontCache(NVGcontext* ctx, const char* path);
+
+// Restores the font atlas saved by nvgSaveFontCache(), replacing the glyphs cached so far. The file is memory mapped
+// and glyphs are restored only for fonts whose file data and fallbacks are unchanged, so call it after creating the
+// fonts and adding their fallbacks. Returns the number of glyphs restored, 0 if the file is missing or stale.
+int nvgLoadFontCache(NVGcontext* ctx, const char* path);
+
+//
+// Frame Statistics
+//
+// The counters cover the work done since nvgBeginFrame(), so call nvgGetFrameStats()
+// after nvgEndFrame() to get the totals of a frame.
+
+struct NVGframeStats {
+	int drawCalls;
+	int fillTriangles;
+	int strokeTriangles;
+	int textTriangles;
+	int vertexBytes;		// Vertex data passed to the render back-end.
+	int commands;			// Path commands recorded.
+	int points;				// Points produced by flattening paths.
+	int glyphsRasterized;
+	int atlasUploadBytes;	// Font atlas texture data uploaded.
+	int culledDraws;		// Fills and strokes skipped because they were outside the viewport or scissor.
+	int commandsCapacity;	// Allocated sizes of the internal buffers, in elements.
+	int pointsCapacity;		// Current sizes, which shrink after nvgBufferShrinkFrames() idle frames.
+	int pathsCapacity;
+	int vertsCapacity;
+	float flattenTime;		// Time spent per pipeline stage in seconds, summed over all threads.
+	float joinsTime;		// Only measured when nanovg.c is compiled with NVG_PROFILE, zero otherwise.
+	float expandTime;
+	float textTime;			// Text layout, excluding glyph rasterization.
+	float glyphTime;
+};
+typedef struct NVGframeStats NVGframeStats;
+
+// Returns statistics of the current frame.
+void nvgGetFrameStats(NVGcontext* ctx, NVGframeStats* stats);
+
+// Sets how often the internal per-frame buffers are trimmed, in frames. Every this many
+// frames, buffers which are more than twice the size the frames since the previous trim
+// needed are reallocated smaller. 0 disables trimming. The default is 300 frames.
+void nvgBufferShrinkFrames(NVGcontext* ctx, int frames);
+
 //
 // Internal Render API
 //
@@ -643,6 +768,13 @@ struct NVGvertex {
 };
 typedef struct NVGvertex NVGvertex;
 
+// Index type of the fill index lists. Define NVG_INDEX32 to use 32-bit indices.
+#ifdef NVG_INDEX32
+typedef unsigned int NVGindex;
+#else
+typedef unsigned short NVGindex;
+#endif
+
 struct NVGpath {
 	int first;
 	int count;
@@ -650,6 +782,8 @@ struct NVGpath {
 	int nbevel;
 	NVGvertex* fill;
 	int nfill;
+	const NVGindex* fillIndices;	// Triangle list indexing fill, if the back-end asked for indexed fills.
+	int nfillIndices;
 	NVGvertex* stroke;
 	int nstroke;
 	int winding;
@@ -657,9 +791,22 @@ struct NVGpath {
 };
 typedef struct NVGpath NVGpath;
 
+// Glyph of the font atlas drawn as a quad, the compact alternative to two triangles per glyph.
+struct NVGglyphInstance {
+	float x, y;				// Corner at the top left of the glyph in text space, transformed.
+	float w, h;				// Size of the quad, both negative if the transform turns the text upside down.
+	float s0, t0, s1, t1;	// Atlas rectangle in texture coordinates.
+	int page;				// Atlas page, the paint image of the draw is the page's texture.
+};
+typedef struct NVGglyphInstance NVGglyphInstance;
+
 struct NVGparams {
 	void* userPtr;
 	int edgeAntiAlias;
+	int threadedTessellation;	// Defer fills and strokes to nvgEndFrame() and tessellate them on worker threads.
+	int indexedFills;			// Back-end draws fills as indexed triangles, see NVGpath.fillIndices.
+	int sdfText;				// Glyphs are rasterized once as distance fields. Text paints then use an NVG_IMAGE_SDF
+								// image, with the field change per pixel in radius and the blur in feather.
 	int (*renderCreate)(void* uptr);
 	int (*renderCreateTexture)(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data);
 	int (*renderDeleteTexture)(void* uptr, int image);
@@ -671,6 +818,9 @@ struct NVGparams {
 	void (*renderFill)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, const float* bounds, const NVGpath* paths, int npaths);
 	void (*renderStroke)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, float strokeWidth, const NVGpath* paths, int npaths);
 	void (*renderTriangles)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, const NVGvertex* verts, int nverts, float fringe);
+	// Optional. Draws text as one instance per glyph instead of renderTriangles(), for text
+	// that is not rotated, skewed or mirrored. Paint and state are as for renderTriangles().
+	void (*renderGlyphs)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, const NVGglyphInstance* glyphs, int nglyphs, float fringe);
 	void (*renderDelete)(void* uptr);
 };
 typedef struct NVGparams NVGparams;
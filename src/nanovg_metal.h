@@ -16,6 +16,10 @@ enum NVGcreateFlags {
     NVG_STENCIL_STROKES	= 1 << 1,
     // Flag indicating that additional debug checks are done (not implemented in this backend).
     NVG_DEBUG             = 1<<2,
+    // Flag indicating that fills and strokes are tessellated in parallel on worker threads at nvgEndFrame().
+    NVG_THREADED_TESSELLATION = 1<<3,
+    // Flag indicating that glyphs are rasterized once as distance fields and drawn at any size and blur.
+    NVG_SDF_TEXT = 1<<4,
 };
 
 #if defined NANOVG_METAL_IMPLEMENTATION
@@ -90,6 +94,8 @@ typedef struct {
 typedef struct {
     uint32_t fillOffset;
     uint32_t fillCount;
+    uint32_t fillIndexOffset;
+    uint32_t fillIndexCount; // Fill is drawn indexed when non-zero.
     uint32_t strokeOffset;
     uint32_t strokeCount;
 } NVGMTLPath;
@@ -117,6 +123,8 @@ typedef struct {
 // of two.
 static const int NVGMTLFragmentUniformStride = 256;
 
+static const MTLIndexType NVGMTLIndexType = sizeof(NVGindex) == 4 ? MTLIndexTypeUInt32 : MTLIndexTypeUInt16;
+
 #pragma mark - Internal Utility Functions
 
 static void NVGMTLFloat3x4FromElements(float* m3, float* t) {
@@ -213,6 +221,7 @@ static NVGMTLBlendState NVGMetalBlendStateFromCompOpState(NVGcompositeOperationS
 @property (nonatomic, nullable) id<MTLCommandBuffer> currentCommandBuffer;
 @property (nonatomic, nullable) id<MTLRenderCommandEncoder> currentRenderCommandEncoder;
 @property (nonatomic, strong) id<MTLBuffer> currentVertexBuffer;
+@property (nonatomic, strong, nullable) id<MTLBuffer> currentIndexBuffer;
 
 @property (nonatomic, weak) id<MTLRenderPipelineState> currentRenderPipelineState;
 @property (nonatomic, weak) id<MTLDepthStencilState> currentDepthStencilState;
@@ -229,6 +238,9 @@ static NVGMTLBlendState NVGMetalBlendStateFromCompOpState(NVGcompositeOperationS
 @property (nonatomic, assign) struct NVGvertex *verts;
 @property (nonatomic, assign) int cverts;
 @property (nonatomic, assign) int nverts;
+@property (nonatomic, assign) NVGindex *indices;
+@property (nonatomic, assign) int cindices;
+@property (nonatomic, assign) int nindices;
 @property (nonatomic, assign) unsigned char *uniforms;
 @property (nonatomic, assign) int cuniforms;
 @property (nonatomic, assign) int nuniforms;
@@ -353,6 +365,7 @@ static NSUInteger NVGMTLNextContextSlot = 1;
 {
     free(_paths);
     free(_verts);
+    free(_indices);
     free(_uniforms);
     free(_calls);
 }
@@ -361,6 +374,7 @@ static NSUInteger NVGMTLNextContextSlot = 1;
 
 - (void)renderCancel {
     _nverts = 0;
+    _nindices = 0;
     _npaths = 0;
     _ncalls = 0;
     _nuniforms = 0;
@@ -378,6 +392,13 @@ static NSUInteger NVGMTLNextContextSlot = 1;
         
         [renderCommandEncoder setVertexBuffer:vertexBuffer offset:0 atIndex:0];
 
+        id<MTLBuffer> indexBuffer = nil;
+        if (_nindices > 0) {
+            indexBuffer = [self _dequeueReusableBufferOfLength:_nindices * sizeof(NVGindex)];
+            memcpy(indexBuffer.contents, _indices, _nindices * sizeof(NVGindex));
+        }
+        self.currentIndexBuffer = indexBuffer;
+
         [renderCommandEncoder setVertexBytes:&_viewportSize length:sizeof(simd_float2) atIndex:1];
 
         id<MTLBuffer> uniformBuffer = [self _dequeueReusableBufferOfLength:_nuniforms * NVGMTLFragmentUniformStride];
@@ -415,10 +436,14 @@ static NSUInteger NVGMTLNextContextSlot = 1;
         [self.currentCommandBuffer addCompletedHandler:^(id<MTLCommandBuffer> cb) {
             [weakSelf _enqueueReusableBuffer:vertexBuffer];
             [weakSelf _enqueueReusableBuffer:uniformBuffer];
+            if (indexBuffer != nil) {
+                [weakSelf _enqueueReusableBuffer:indexBuffer];
+            }
         }];
     }
 
     _nverts = 0;
+    _nindices = 0;
     _npaths = 0;
     _ncalls = 0;
     _nuniforms = 0;
@@ -603,11 +628,22 @@ compositeOperation:(NVGcompositeOperationState)compositeOperation
         NVGMTLPath *copy = &_paths[call->pathOffset + i];
         const NVGpath *path = &paths[i];
         memset(copy, 0, sizeof(NVGMTLPath));
-        if (path->nfill > 0) {
+        if (path->nfill > 0 && path->fillIndices != NULL) {
+            // Copy the fan once and draw it through the index list.
+            int indexOffset = [self _allocIndices:path->nfillIndices];
+            if (indexOffset == -1) {
+                goto error;
+            }
+            memcpy(&_indices[indexOffset], path->fillIndices, sizeof(NVGindex) * path->nfillIndices);
+            copy->fillIndexOffset = indexOffset;
+            copy->fillIndexCount = path->nfillIndices;
             copy->fillOffset = offset;
-            copy->fillCount = 0;//path->nfill;
-            // TODO: Fix up triangle fan verts
-            //memcpy(&_verts[offset], path->fill, sizeof(NVGvertex) * path->nfill);
+            copy->fillCount = path->nfill;
+            memcpy(&_verts[offset], path->fill, sizeof(NVGvertex) * path->nfill);
+            offset += path->nfill;
+        } else if (path->nfill > 0) {
+            copy->fillOffset = offset;
+            copy->fillCount = 0;
             int triCount = path->nfill - 1;
             for (int j = 0; j < triCount; ++j) {
                 memcpy(&_verts[offset + (j * 3) + 0], path->fill + (0), sizeof(NVGvertex));
@@ -876,6 +912,9 @@ error:
         
         if (tex.type == NVG_TEXTURE_RGBA) {
             uniforms.texType = (tex.flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
+        } else if (tex.flags & NVG_IMAGE_SDF) {
+            uniforms.texType = 3;
+            uniforms.feather = paint->feather;
         } else {
             uniforms.texType = 2;
         }
@@ -899,12 +938,30 @@ error:
 - (int)_maxVertCountForPaths:(const NVGpath *)paths pathCount:(int)pathCount {
     int count = 0;
     for (int i = 0; i < pathCount; ++i) {
-        count += paths[i].nfill * 3; // TODO: Make this a tighter bound
+        count += paths[i].fillIndices != NULL ? paths[i].nfill : paths[i].nfill * 3;
         count += paths[i].nstroke;
     }
     return count;
 }
 
+- (void)_drawFillTriangles:(NVGMTLPath *)path {
+    if (path->fillIndexCount > 0) {
+        [self.currentRenderCommandEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                                                     indexCount:path->fillIndexCount
+                                                      indexType:NVGMTLIndexType
+                                                    indexBuffer:self.currentIndexBuffer
+                                              indexBufferOffset:path->fillIndexOffset * sizeof(NVGindex)
+                                                  instanceCount:1
+                                                     baseVertex:path->fillOffset
+                                                   baseInstance:0];
+    } else {
+        //glDrawArrays(GL_TRIANGLE_FAN, path->fillOffset, path->fillCount);
+        [self.currentRenderCommandEncoder drawPrimitives:MTLPrimitiveTypeTriangle
+                                             vertexStart:path->fillOffset
+                                             vertexCount:path->fillCount];
+    }
+}
+
 - (void)_drawFill:(NVGMTLCall *)call {
     NVGMTLPath *paths = &_paths[call->pathOffset];
     int npaths = call->pathCount;
@@ -918,10 +975,7 @@ error:
 
     [renderCommandEncoder setCullMode:MTLCullModeNone];
     for (int i = 0; i < npaths; i++) {
-        //glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
-        [renderCommandEncoder drawPrimitives:MTLPrimitiveTypeTriangle
-                                 vertexStart:paths[i].fillOffset
-                                 vertexCount:paths[i].fillCount];
+        [self _drawFillTriangles:&paths[i]];
     }
     [renderCommandEncoder setCullMode:MTLCullModeBack];
 
@@ -956,10 +1010,7 @@ error:
     [self setUniformsForOffset:call->uniformOffset textureIdentifier:call->image];
     
     for (int i = 0; i < npaths; ++i) {
-        //glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
-        [self.currentRenderCommandEncoder drawPrimitives:MTLPrimitiveTypeTriangle
-                                             vertexStart:paths[i].fillOffset
-                                             vertexCount:paths[i].fillCount];
+        [self _drawFillTriangles:&paths[i]];
         if (paths[i].strokeCount > 0) {
             [self.currentRenderCommandEncoder drawPrimitives:MTLPrimitiveTypeTriangleStrip
                                                  vertexStart:paths[i].strokeOffset
@@ -1079,6 +1130,24 @@ error:
     return ret;
 }
 
+- (int)_allocIndices:(int)n {
+    // Index buffer offsets must be 4 byte aligned.
+    int align = 4 / sizeof(NVGindex);
+    int start = (_nindices + align - 1) / align * align;
+    if (start + n > _cindices) {
+        NVGindex *indices;
+        int cindices = MAX(start + n, 4096) + _cindices / 2;
+        indices = (NVGindex *)realloc(_indices, sizeof(NVGindex) * cindices);
+        if (indices == NULL) {
+            return -1;
+        }
+        _indices = indices;
+        _cindices = cindices;
+    }
+    _nindices = start + n;
+    return start;
+}
+
 - (int)_allocFragUniforms:(int)n {
     int structSize = NVGMTLFragmentUniformStride;
     if (_nuniforms+n > _cuniforms) {
@@ -1246,6 +1315,9 @@ NVGcontext *nvgCreateMetal(id<MTLDevice> device, id<MTLCommandQueue> commandQueu
     params.renderDelete = NVGMTLRenderDelete;
     params.userPtr = (void *)contextSlot;
     params.edgeAntiAlias = flags & NVG_ANTIALIAS ? 1 : 0;
+    params.threadedTessellation = flags & NVG_THREADED_TESSELLATION ? 1 : 0;
+    params.indexedFills = 1;
+    params.sdfText = flags & NVG_SDF_TEXT ? 1 : 0;
 
     NVGcontext *ctx = nvgCreateInternal(&params);
     if (ctx == NULL) {
@@ -0,0 +1,1545 @@
+//
+// Copyright (c) 2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef NANOVG_SW_H
+#define NANOVG_SW_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Public interface
+
+enum NVGcreateFlags {
+	// Flag indicating if geometry based anti-aliasing is used.
+	NVG_ANTIALIAS 		= 1<<0,
+	// Flag indicating if strokes should be drawn using stencil buffer. The rendering will be a little
+	// slower, but path overlaps (i.e. self-intersecting or sharp turns) will be drawn just once.
+	NVG_STENCIL_STROKES	= 1<<1,
+	// Flag indicating that additional debug checks are done (not implemented in this backend).
+	NVG_DEBUG 			= 1<<2,
+	// Flag indicating that fills and strokes are tessellated in parallel on worker threads at nvgEndFrame().
+	NVG_THREADED_TESSELLATION = 1<<3,
+	// Flag indicating that glyphs are rasterized once as distance fields and drawn at any size and blur.
+	NVG_SDF_TEXT = 1<<4,
+};
+
+// Creates a context that rasterizes on the CPU into a caller supplied RGBA8 buffer.
+// Screen tiles are rendered in parallel on nthreads threads (including the thread calling
+// nvgEndFrame()); pass 0 to use one thread per online CPU.
+NVGcontext* nvgCreateSW(int flags, int nthreads);
+void nvgDeleteSW(NVGcontext* ctx);
+
+// Sets the render target for the next frame. Pixels are premultiplied RGBA8, stride is in bytes.
+// The view set with nvgBeginFrame() is stretched over the whole target, so pass
+// windowWidth*devicePixelRatio pixels for high DPI rendering.
+void nvgBeginFrameSW(NVGcontext* ctx, unsigned char* pixels, int width, int height, int stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NANOVG_SW_H */
+
+#ifdef NANOVG_SW_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifndef NVGSW_NO_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "nanovg.h"
+
+// Size in pixels of the square screen tiles which are binned and rendered independently.
+#ifndef NVGSW_TILE_SIZE
+#define NVGSW_TILE_SIZE 64
+#endif
+
+// Internal structures
+
+enum NVGSWcallType {
+	NVGSW_NONE = 0,
+	NVGSW_FILL,
+	NVGSW_CONVEXFILL,
+	NVGSW_STROKE,
+	NVGSW_TRIANGLES,
+	NVGSW_GLYPHS,
+};
+
+enum NVGSWshaderType {
+	NVGSW_SHADER_FILLGRAD,
+	NVGSW_SHADER_FILLIMG,
+	NVGSW_SHADER_SIMPLE,
+	NVGSW_SHADER_IMG
+};
+
+enum NVGSWstencilFunc {
+	NVGSW_ALWAYS,
+	NVGSW_EQUAL,
+	NVGSW_NOTEQUAL,
+};
+
+enum NVGSWstencilOp {
+	NVGSW_KEEP,
+	NVGSW_ZERO,
+	NVGSW_INCR_WRAP,
+	NVGSW_INCR_DECR_WRAP,	// Increment on front faces, decrement on back faces.
+};
+
+struct NVGSWtexture {
+	int id;
+	int type;
+	int width, height;
+	int flags;
+	unsigned char* data;
+};
+typedef struct NVGSWtexture NVGSWtexture;
+
+struct NVGSWcall {
+	int type;
+	int image;
+	int pathOffset;
+	int pathCount;
+	int triangleOffset;
+	int triangleCount;
+	int glyphOffset;
+	int glyphCount;
+	int uniformOffset;
+	NVGcompositeOperationState blend;
+	float bounds[4];
+	NVGSWtexture* tex;
+};
+typedef struct NVGSWcall NVGSWcall;
+
+struct NVGSWpath {
+	int fillOffset;
+	int fillCount;
+	int strokeOffset;
+	int strokeCount;
+};
+typedef struct NVGSWpath NVGSWpath;
+
+// Same values as the Metal fragment uniforms; the matrices are plain inverse 2x3 transforms.
+struct NVGSWfragUniforms {
+	float scissorMat[6];
+	float paintMat[6];
+	NVGcolor innerCol;
+	NVGcolor outerCol;
+	float scissorExt[2];
+	float scissorScale[2];
+	float extent[2];
+	float radius;
+	float feather;
+	float strokeMult;
+	float strokeThr;
+	int texType;
+	int type;
+};
+typedef struct NVGSWfragUniforms NVGSWfragUniforms;
+
+// Fixed function state of one draw pass, plus the tile it is clipped to.
+struct NVGSWraster {
+	int x0, y0, x1, y1;
+	int cull;
+	int stencilFunc;
+	int stencilPass;
+	int stencilFail;
+	int colorWrite;
+	const NVGSWfragUniforms* frag;
+	const NVGSWtexture* tex;
+	NVGcompositeOperationState blend;
+	float sx, sy;
+	unsigned char* stencil;
+	unsigned char* pixels;
+	int stride;
+};
+typedef struct NVGSWraster NVGSWraster;
+
+struct NVGSWcontext;
+
+struct NVGSWworker {
+	struct NVGSWcontext* sw;
+	unsigned char stencil[NVGSW_TILE_SIZE*NVGSW_TILE_SIZE];
+};
+typedef struct NVGSWworker NVGSWworker;
+
+struct NVGSWcontext {
+	int flags;
+	float view[2];
+
+	unsigned char* pixels;
+	int width, height;
+	int stride;
+
+	NVGSWtexture* textures;
+	int ntextures;
+	int ctextures;
+	int textureId;
+
+	NVGSWcall* calls;
+	int ccalls;
+	int ncalls;
+	NVGSWpath* paths;
+	int cpaths;
+	int npaths;
+	NVGvertex* verts;
+	int cverts;
+	int nverts;
+	NVGglyphInstance* glyphs;
+	int cglyphs;
+	int nglyphs;
+	NVGSWfragUniforms* uniforms;
+	int cuniforms;
+	int nuniforms;
+
+	// Per tile lists of call indices, stored back to back.
+	int tilesx, tilesy;
+	int* binStart;
+	int cbinStart;
+	int* binCalls;
+	int cbinCalls;
+
+	NVGSWworker* workers;
+	int nworkers;
+	int nextTile;
+	int ntiles;
+#ifndef NVGSW_NO_THREADS
+	pthread_t* threads;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	int generation;
+	int active;
+	int quit;
+#endif
+};
+typedef struct NVGSWcontext NVGSWcontext;
+
+// Internal utility functions
+
+static int nvgsw__maxi(int a, int b) { return a > b ? a : b; }
+static int nvgsw__mini(int a, int b) { return a < b ? a : b; }
+static float nvgsw__minf(float a, float b) { return a < b ? a : b; }
+static float nvgsw__maxf(float a, float b) { return a > b ? a : b; }
+static float nvgsw__clampf(float a, float mn, float mx) { return a < mn ? mn : (a > mx ? mx : a); }
+
+static NVGcolor nvgsw__premulColor(NVGcolor c)
+{
+	c.r *= c.a;
+	c.g *= c.a;
+	c.b *= c.a;
+	return c;
+}
+
+static NVGSWtexture* nvgsw__findTexture(NVGSWcontext* sw, int id)
+{
+	int i;
+	for (i = 0; i < sw->ntextures; i++)
+		if (sw->textures[i].id == id)
+			return &sw->textures[i];
+	return NULL;
+}
+
+static NVGSWtexture* nvgsw__allocTexture(NVGSWcontext* sw)
+{
+	NVGSWtexture* tex = NULL;
+	int i;
+
+	for (i = 0; i < sw->ntextures; i++) {
+		if (sw->textures[i].id == 0) {
+			tex = &sw->textures[i];
+			break;
+		}
+	}
+	if (tex == NULL) {
+		if (sw->ntextures+1 > sw->ctextures) {
+			NVGSWtexture* textures;
+			int ctextures = nvgsw__maxi(sw->ntextures+1, 4) + sw->ctextures/2; // 1.5x Overallocate
+			textures = (NVGSWtexture*)realloc(sw->textures, sizeof(NVGSWtexture)*ctextures);
+			if (textures == NULL) return NULL;
+			sw->textures = textures;
+			sw->ctextures = ctextures;
+		}
+		tex = &sw->textures[sw->ntextures++];
+	}
+
+	memset(tex, 0, sizeof(*tex));
+	tex->id = ++sw->textureId;
+
+	return tex;
+}
+
+static NVGSWcall* nvgsw__allocCall(NVGSWcontext* sw)
+{
+	NVGSWcall* ret = NULL;
+	if (sw->ncalls+1 > sw->ccalls) {
+		NVGSWcall* calls;
+		int ccalls = nvgsw__maxi(sw->ncalls+1, 128) + sw->ccalls/2; // 1.5x Overallocate
+		calls = (NVGSWcall*)realloc(sw->calls, sizeof(NVGSWcall) * ccalls);
+		if (calls == NULL) return NULL;
+		sw->calls = calls;
+		sw->ccalls = ccalls;
+	}
+	ret = &sw->calls[sw->ncalls++];
+	memset(ret, 0, sizeof(NVGSWcall));
+	return ret;
+}
+
+static int nvgsw__allocPaths(NVGSWcontext* sw, int n)
+{
+	int ret = 0;
+	if (sw->npaths+n > sw->cpaths) {
+		NVGSWpath* paths;
+		int cpaths = nvgsw__maxi(sw->npaths + n, 128) + sw->cpaths/2; // 1.5x Overallocate
+		paths = (NVGSWpath*)realloc(sw->paths, sizeof(NVGSWpath) * cpaths);
+		if (paths == NULL) return -1;
+		sw->paths = paths;
+		sw->cpaths = cpaths;
+	}
+	ret = sw->npaths;
+	sw->npaths += n;
+	return ret;
+}
+
+static int nvgsw__allocVerts(NVGSWcontext* sw, int n)
+{
+	int ret = 0;
+	if (sw->nverts+n > sw->cverts) {
+		NVGvertex* verts;
+		int cverts = nvgsw__maxi(sw->nverts + n, 4096) + sw->cverts/2; // 1.5x Overallocate
+		verts = (NVGvertex*)realloc(sw->verts, sizeof(NVGvertex) * cverts);
+		if (verts == NULL) return -1;
+		sw->verts = verts;
+		sw->cverts = cverts;
+	}
+	ret = sw->nverts;
+	sw->nverts += n;
+	return ret;
+}
+
+static int nvgsw__allocGlyphs(NVGSWcontext* sw, int n)
+{
+	int ret = 0;
+	if (sw->nglyphs+n > sw->cglyphs) {
+		NVGglyphInstance* glyphs;
+		int cglyphs = nvgsw__maxi(sw->nglyphs + n, 1024) + sw->cglyphs/2; // 1.5x Overallocate
+		glyphs = (NVGglyphInstance*)realloc(sw->glyphs, sizeof(NVGglyphInstance) * cglyphs);
+		if (glyphs == NULL) return -1;
+		sw->glyphs = glyphs;
+		sw->cglyphs = cglyphs;
+	}
+	ret = sw->nglyphs;
+	sw->nglyphs += n;
+	return ret;
+}
+
+static int nvgsw__allocFragUniforms(NVGSWcontext* sw, int n)
+{
+	int ret = 0;
+	if (sw->nuniforms+n > sw->cuniforms) {
+		NVGSWfragUniforms* uniforms;
+		int cuniforms = nvgsw__maxi(sw->nuniforms+n, 128) + sw->cuniforms/2; // 1.5x Overallocate
+		uniforms = (NVGSWfragUniforms*)realloc(sw->uniforms, sizeof(NVGSWfragUniforms) * cuniforms);
+		if (uniforms == NULL) return -1;
+		sw->uniforms = uniforms;
+		sw->cuniforms = cuniforms;
+	}
+	ret = sw->nuniforms;
+	sw->nuniforms += n;
+	return ret;
+}
+
+static int nvgsw__maxVertCount(const NVGpath* paths, int npaths)
+{
+	int i, count = 0;
+	for (i = 0; i < npaths; i++) {
+		count += paths[i].nfill;
+		count += paths[i].nstroke;
+	}
+	return count;
+}
+
+static void nvgsw__callBounds(NVGSWcall* call, const NVGvertex* verts, int nverts)
+{
+	int i;
+	for (i = 0; i < nverts; i++) {
+		call->bounds[0] = nvgsw__minf(call->bounds[0], verts[i].x);
+		call->bounds[1] = nvgsw__minf(call->bounds[1], verts[i].y);
+		call->bounds[2] = nvgsw__maxf(call->bounds[2], verts[i].x);
+		call->bounds[3] = nvgsw__maxf(call->bounds[3], verts[i].y);
+	}
+}
+
+static int nvgsw__convertPaint(NVGSWcontext* sw, NVGSWfragUniforms* frag, NVGpaint* paint,
+							   NVGscissor* scissor, float width, float fringe, float strokeThr)
+{
+	NVGSWtexture* tex = NULL;
+	float invxform[6];
+
+	memset(frag, 0, sizeof(*frag));
+
+	frag->innerCol = nvgsw__premulColor(paint->innerColor);
+	frag->outerCol = nvgsw__premulColor(paint->outerColor);
+
+	if (scissor->extent[0] < -0.5f || scissor->extent[1] < -0.5f) {
+		memset(frag->scissorMat, 0, sizeof(frag->scissorMat));
+		frag->scissorExt[0] = 1.0f;
+		frag->scissorExt[1] = 1.0f;
+		frag->scissorScale[0] = 1.0f;
+		frag->scissorScale[1] = 1.0f;
+	} else {
+		nvgTransformInverse(frag->scissorMat, scissor->xform);
+		frag->scissorExt[0] = scissor->extent[0];
+		frag->scissorExt[1] = scissor->extent[1];
+		frag->scissorScale[0] = sqrtf(scissor->xform[0]*scissor->xform[0] + scissor->xform[2]*scissor->xform[2]) / fringe;
+		frag->scissorScale[1] = sqrtf(scissor->xform[1]*scissor->xform[1] + scissor->xform[3]*scissor->xform[3]) / fringe;
+	}
+
+	memcpy(frag->extent, paint->extent, sizeof(frag->extent));
+	frag->strokeMult = (width*0.5f + fringe*0.5f) / fringe;
+	frag->strokeThr = strokeThr;
+
+	if (paint->image != 0) {
+		tex = nvgsw__findTexture(sw, paint->image);
+		if (tex == NULL) return 0;
+		if ((tex->flags & NVG_IMAGE_FLIPY) != 0) {
+			float m1[6], m2[6];
+			nvgTransformTranslate(m1, 0.0f, frag->extent[1] * 0.5f);
+			nvgTransformMultiply(m1, paint->xform);
+			nvgTransformScale(m2, 1.0f, -1.0f);
+			nvgTransformMultiply(m2, m1);
+			nvgTransformTranslate(m1, 0.0f, -frag->extent[1] * 0.5f);
+			nvgTransformMultiply(m1, m2);
+			nvgTransformInverse(invxform, m1);
+		} else {
+			nvgTransformInverse(invxform, paint->xform);
+		}
+		frag->type = NVGSW_SHADER_FILLIMG;
+
+		if (tex->type == NVG_TEXTURE_RGBA) {
+			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
+		} else if (tex->flags & NVG_IMAGE_SDF) {
+			frag->texType = 3;
+			frag->radius = paint->radius;
+			frag->feather = paint->feather;
+		} else {
+			frag->texType = 2;
+		}
+	} else {
+		frag->type = NVGSW_SHADER_FILLGRAD;
+		frag->radius = paint->radius;
+		frag->feather = paint->feather;
+		nvgTransformInverse(invxform, paint->xform);
+	}
+
+	memcpy(frag->paintMat, invxform, sizeof(frag->paintMat));
+
+	return 1;
+}
+
+// Fragment stage
+
+static float nvgsw__sdroundrect(float px, float py, float ex, float ey, float rad)
+{
+	float dx = fabsf(px) - (ex - rad);
+	float dy = fabsf(py) - (ey - rad);
+	float mx = nvgsw__maxf(dx, 0.0f), my = nvgsw__maxf(dy, 0.0f);
+	return nvgsw__minf(nvgsw__maxf(dx, dy), 0.0f) + sqrtf(mx*mx + my*my) - rad;
+}
+
+static float nvgsw__scissorMask(const NVGSWfragUniforms* frag, float px, float py)
+{
+	const float* t = frag->scissorMat;
+	float scx = fabsf(t[0]*px + t[2]*py + t[4]) - frag->scissorExt[0];
+	float scy = fabsf(t[1]*px + t[3]*py + t[5]) - frag->scissorExt[1];
+	scx = nvgsw__clampf(0.5f - scx * frag->scissorScale[0], 0.0f, 1.0f);
+	scy = nvgsw__clampf(0.5f - scy * frag->scissorScale[1], 0.0f, 1.0f);
+	return scx * scy;
+}
+
+static float nvgsw__strokeMask(const NVGSWfragUniforms* frag, float u, float v)
+{
+	return nvgsw__minf(1.0f, (1.0f - fabsf(u*2.0f - 1.0f)) * frag->strokeMult) * nvgsw__minf(1.0f, v);
+}
+
+static int nvgsw__wrap(int i, int n)
+{
+	i %= n;
+	return i < 0 ? i + n : i;
+}
+
+// Bilinear sample with repeat addressing, matching the Metal sampler.
+static void nvgsw__sampleTexture(const NVGSWtexture* tex, float u, float v, float* color)
+{
+	float fx, fy, tx, ty;
+	int x0, y0, x1, y1, i;
+
+	if (tex == NULL || tex->data == NULL) {
+		color[0] = color[1] = color[2] = color[3] = 0.0f;
+		return;
+	}
+
+	fx = u * tex->width - 0.5f;
+	fy = v * tex->height - 0.5f;
+	x0 = (int)floorf(fx);
+	y0 = (int)floorf(fy);
+	tx = fx - x0;
+	ty = fy - y0;
+	x1 = nvgsw__wrap(x0 + 1, tex->width);
+	y1 = nvgsw__wrap(y0 + 1, tex->height);
+	x0 = nvgsw__wrap(x0, tex->width);
+	y0 = nvgsw__wrap(y0, tex->height);
+
+	if (tex->type == NVG_TEXTURE_RGBA) {
+		const unsigned char* r0 = tex->data + y0 * tex->width * 4;
+		const unsigned char* r1 = tex->data + y1 * tex->width * 4;
+		for (i = 0; i < 4; i++) {
+			float a = r0[x0*4+i] + (r0[x1*4+i] - r0[x0*4+i]) * tx;
+			float b = r1[x0*4+i] + (r1[x1*4+i] - r1[x0*4+i]) * tx;
+			color[i] = (a + (b - a) * ty) * (1.0f/255.0f);
+		}
+	} else {
+		const unsigned char* r0 = tex->data + y0 * tex->width;
+		const unsigned char* r1 = tex->data + y1 * tex->width;
+		float a = r0[x0] + (r0[x1] - r0[x0]) * tx;
+		float b = r1[x0] + (r1[x1] - r1[x0]) * tx;
+		color[0] = (a + (b - a) * ty) * (1.0f/255.0f);
+		color[1] = color[2] = 0.0f;
+		color[3] = 1.0f;
+	}
+}
+
+static void nvgsw__texColor(const NVGSWfragUniforms* frag, float* color)
+{
+	if (frag->texType == 1) {
+		color[0] *= color[3];
+		color[1] *= color[3];
+		color[2] *= color[3];
+	} else if (frag->texType == 2) {
+		color[1] = color[2] = color[3] = color[0];
+	} else if (frag->texType == 3) {
+		// Distance field, soften the edge over a pixel plus the blur. Images drawn
+		// with a pattern have neither, and get a hard edge.
+		float w = nvgsw__maxf(0.5f*frag->radius + frag->feather, 1e-4f);
+		float t = nvgsw__clampf((color[0] - 0.5f + w) / (2.0f*w), 0.0f, 1.0f);
+		color[0] = color[1] = color[2] = color[3] = t*t*(3.0f - 2.0f*t);
+	}
+}
+
+// Returns 0 if the fragment is discarded.
+static int nvgsw__shade(const NVGSWraster* r, float px, float py, float u, float v, float* color)
+{
+	const NVGSWfragUniforms* frag = r->frag;
+	float scissor, strokeAlpha, s;
+	int i;
+
+	scissor = nvgsw__scissorMask(frag, px, py);
+	strokeAlpha = nvgsw__strokeMask(frag, u, v);
+	if (strokeAlpha < frag->strokeThr)
+		return 0;
+
+	switch (frag->type) {
+	case NVGSW_SHADER_FILLGRAD: {
+		const float* t = frag->paintMat;
+		float ptx = t[0]*px + t[2]*py + t[4];
+		float pty = t[1]*px + t[3]*py + t[5];
+		float d = nvgsw__clampf((nvgsw__sdroundrect(ptx, pty, frag->extent[0], frag->extent[1], frag->radius) + frag->feather*0.5f) / frag->feather, 0.0f, 1.0f);
+		s = strokeAlpha * scissor;
+		for (i = 0; i < 4; i++)
+			color[i] = (frag->innerCol.rgba[i] + (frag->outerCol.rgba[i] - frag->innerCol.rgba[i]) * d) * s;
+		break;
+	}
+	case NVGSW_SHADER_FILLIMG: {
+		const float* t = frag->paintMat;
+		float ptx = (t[0]*px + t[2]*py + t[4]) / frag->extent[0];
+		float pty = (t[1]*px + t[3]*py + t[5]) / frag->extent[1];
+		nvgsw__sampleTexture(r->tex, ptx, pty, color);
+		nvgsw__texColor(frag, color);
+		s = strokeAlpha * scissor;
+		for (i = 0; i < 4; i++)
+			color[i] *= frag->innerCol.rgba[i] * s;
+		break;
+	}
+	case NVGSW_SHADER_SIMPLE:
+		color[0] = color[1] = color[2] = color[3] = 1.0f;
+		break;
+	case NVGSW_SHADER_IMG:
+		nvgsw__sampleTexture(r->tex, u, v, color);
+		nvgsw__texColor(frag, color);
+		for (i = 0; i < 4; i++)
+			color[i] *= scissor * frag->innerCol.rgba[i];
+		break;
+	default:
+		color[0] = color[1] = color[2] = color[3] = 0.0f;
+		break;
+	}
+	return 1;
+}
+
+static float nvgsw__blendFactor(int factor, const float* src, const float* dst, int c)
+{
+	switch (factor) {
+	case NVG_ZERO:					return 0.0f;
+	case NVG_ONE:					return 1.0f;
+	case NVG_SRC_COLOR:				return src[c];
+	case NVG_ONE_MINUS_SRC_COLOR:	return 1.0f - src[c];
+	case NVG_DST_COLOR:				return dst[c];
+	case NVG_ONE_MINUS_DST_COLOR:	return 1.0f - dst[c];
+	case NVG_SRC_ALPHA:				return src[3];
+	case NVG_ONE_MINUS_SRC_ALPHA:	return 1.0f - src[3];
+	case NVG_DST_ALPHA:				return dst[3];
+	case NVG_ONE_MINUS_DST_ALPHA:	return 1.0f - dst[3];
+	case NVG_SRC_ALPHA_SATURATE:	return c == 3 ? 1.0f : nvgsw__minf(src[3], 1.0f - dst[3]);
+	default:						return 0.0f;
+	}
+}
+
+static void nvgsw__blend(const NVGSWraster* r, unsigned char* pixel, const float* src)
+{
+	const NVGcompositeOperationState* op = &r->blend;
+	float dst[4], res[4];
+	int i;
+
+	for (i = 0; i < 4; i++)
+		dst[i] = pixel[i] * (1.0f/255.0f);
+
+	if (op->srcRGB == NVG_ONE && op->dstRGB == NVG_ONE_MINUS_SRC_ALPHA &&
+		op->srcAlpha == NVG_ONE && op->dstAlpha == NVG_ONE_MINUS_SRC_ALPHA) {
+		float ia = 1.0f - src[3];
+		for (i = 0; i < 4; i++)
+			res[i] = src[i] + dst[i] * ia;
+	} else {
+		for (i = 0; i < 3; i++)
+			res[i] = src[i] * nvgsw__blendFactor(op->srcRGB, src, dst, i) + dst[i] * nvgsw__blendFactor(op->dstRGB, src, dst, i);
+		res[3] = src[3] * nvgsw__blendFactor(op->srcAlpha, src, dst, 3) + dst[3] * nvgsw__blendFactor(op->dstAlpha, src, dst, 3);
+	}
+
+	for (i = 0; i < 4; i++)
+		pixel[i] = (unsigned char)(nvgsw__clampf(res[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Triangle setup and scan conversion
+
+#define NVGSW_SUBPIXEL_BITS 8
+#define NVGSW_SUBPIXEL (1 << NVGSW_SUBPIXEL_BITS)
+#define NVGSW_MAX_COORD 4000000.0f
+
+static long long nvgsw__fixed(float v)
+{
+	return (long long)floorf(nvgsw__clampf(v, -NVGSW_MAX_COORD, NVGSW_MAX_COORD) * NVGSW_SUBPIXEL + 0.5f);
+}
+
+static int nvgsw__isTopLeft(long long ax, long long ay, long long bx, long long by)
+{
+	return (ay == by && bx > ax) || (by < ay);
+}
+
+static void nvgsw__triangle(NVGSWraster* r, const NVGvertex* va, const NVGvertex* vb, const NVGvertex* vc)
+{
+	const NVGvertex* v[3];
+	long long X[3], Y[3], e[3], dx[3], dy[3], area, bias[3];
+	float inv, isx = 1.0f / r->sx, isy = 1.0f / r->sy;
+	int i, x, y, minx, miny, maxx, maxy, front, sbase;
+
+	v[0] = va; v[1] = vb; v[2] = vc;
+	for (i = 0; i < 3; i++) {
+		X[i] = nvgsw__fixed(v[i]->x * r->sx);
+		Y[i] = nvgsw__fixed(v[i]->y * r->sy);
+	}
+
+	area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+	if (area == 0) return;
+
+	// Front faces are counter clockwise in clip space, which is clockwise with y down.
+	front = area < 0;
+	if (r->cull && !front) return;
+
+	if (area < 0) {
+		long long t;
+		const NVGvertex* tv;
+		t = X[1]; X[1] = X[2]; X[2] = t;
+		t = Y[1]; Y[1] = Y[2]; Y[2] = t;
+		tv = v[1]; v[1] = v[2]; v[2] = tv;
+		area = -area;
+	}
+
+	minx = (int)((nvgsw__mini(nvgsw__mini((int)X[0], (int)X[1]), (int)X[2])) >> NVGSW_SUBPIXEL_BITS);
+	miny = (int)((nvgsw__mini(nvgsw__mini((int)Y[0], (int)Y[1]), (int)Y[2])) >> NVGSW_SUBPIXEL_BITS);
+	maxx = (int)((nvgsw__maxi(nvgsw__maxi((int)X[0], (int)X[1]), (int)X[2])) >> NVGSW_SUBPIXEL_BITS) + 1;
+	maxy = (int)((nvgsw__maxi(nvgsw__maxi((int)Y[0], (int)Y[1]), (int)Y[2])) >> NVGSW_SUBPIXEL_BITS) + 1;
+	minx = nvgsw__maxi(minx, r->x0);
+	miny = nvgsw__maxi(miny, r->y0);
+	maxx = nvgsw__mini(maxx, r->x1);
+	maxy = nvgsw__mini(maxy, r->y1);
+	if (minx >= maxx || miny >= maxy) return;
+
+	// Edge i is opposite to vertex i, and positive inside the triangle.
+	for (i = 0; i < 3; i++) {
+		int a = (i + 1) % 3, b = (i + 2) % 3;
+		long long px = (long long)minx * NVGSW_SUBPIXEL + NVGSW_SUBPIXEL/2;
+		long long py = (long long)miny * NVGSW_SUBPIXEL + NVGSW_SUBPIXEL/2;
+		dx[i] = -(Y[b] - Y[a]) * NVGSW_SUBPIXEL;
+		dy[i] = (X[b] - X[a]) * NVGSW_SUBPIXEL;
+		e[i] = (X[b] - X[a]) * (py - Y[a]) - (Y[b] - Y[a]) * (px - X[a]);
+		bias[i] = nvgsw__isTopLeft(X[a], Y[a], X[b], Y[b]) ? 0 : -1;
+	}
+	inv = 1.0f / (float)area;
+
+	for (y = miny; y < maxy; y++) {
+		long long e0 = e[0], e1 = e[1], e2 = e[2];
+		sbase = (y - r->y0) * NVGSW_TILE_SIZE - r->x0;
+		for (x = minx; x < maxx; x++, e0 += dx[0], e1 += dx[1], e2 += dx[2]) {
+			unsigned char* s;
+			float color[4];
+			int pass;
+			if ((e0 + bias[0]) < 0 || (e1 + bias[1]) < 0 || (e2 + bias[2]) < 0)
+				continue;
+
+			s = &r->stencil[sbase + x];
+			switch (r->stencilFunc) {
+			case NVGSW_EQUAL: pass = *s == 0; break;
+			case NVGSW_NOTEQUAL: pass = *s != 0; break;
+			default: pass = 1; break;
+			}
+			if (!pass) {
+				if (r->stencilFail == NVGSW_ZERO) *s = 0;
+				continue;
+			}
+
+			if (r->colorWrite || r->frag->strokeThr > -1.0f) {
+				float w0 = (float)e0 * inv, w1 = (float)e1 * inv, w2 = 1.0f - w0 - w1;
+				float u = v[0]->u * w0 + v[1]->u * w1 + v[2]->u * w2;
+				float tv = v[0]->v * w0 + v[1]->v * w1 + v[2]->v * w2;
+				if (!nvgsw__shade(r, (x + 0.5f) * isx, (y + 0.5f) * isy, u, tv, color))
+					continue;
+			}
+
+			switch (r->stencilPass) {
+			case NVGSW_ZERO: *s = 0; break;
+			case NVGSW_INCR_WRAP: *s = (unsigned char)(*s + 1); break;
+			case NVGSW_INCR_DECR_WRAP: *s = (unsigned char)(front ? *s + 1 : *s - 1); break;
+			default: break;
+			}
+
+			if (r->colorWrite)
+				nvgsw__blend(r, &r->pixels[y * r->stride + x * 4], color);
+		}
+		e[0] += dy[0];
+		e[1] += dy[1];
+		e[2] += dy[2];
+	}
+}
+
+// Fills the pixels whose centers are inside the glyph quad, the same pixels as its two triangles.
+static void nvgsw__glyph(NVGSWraster* r, const NVGglyphInstance* g)
+{
+	long long X0, Y0, X1, Y1, cx, cy;
+	float s0 = g->s0, t0 = g->t0, s1 = g->s1, t1 = g->t1, du, dv, u, v;
+	float isx = 1.0f / r->sx, isy = 1.0f / r->sy;
+	int x, y, minx, miny, maxx, maxy;
+
+	X0 = nvgsw__fixed(g->x * r->sx);
+	Y0 = nvgsw__fixed(g->y * r->sy);
+	X1 = nvgsw__fixed((g->x + g->w) * r->sx);
+	Y1 = nvgsw__fixed((g->y + g->h) * r->sy);
+	if (X1 < X0) { long long t = X0; float ts = s0; X0 = X1; X1 = t; s0 = s1; s1 = ts; }
+	if (Y1 < Y0) { long long t = Y0; float tt = t0; Y0 = Y1; Y1 = t; t0 = t1; t1 = tt; }
+	if (X0 == X1 || Y0 == Y1) return;
+
+	// First pixel whose center is at or right of the left edge, the right edge is exclusive.
+	minx = nvgsw__maxi((int)((X0 - NVGSW_SUBPIXEL/2 + NVGSW_SUBPIXEL-1) >> NVGSW_SUBPIXEL_BITS), r->x0);
+	miny = nvgsw__maxi((int)((Y0 - NVGSW_SUBPIXEL/2 + NVGSW_SUBPIXEL-1) >> NVGSW_SUBPIXEL_BITS), r->y0);
+	maxx = nvgsw__mini((int)((X1 - NVGSW_SUBPIXEL/2 + NVGSW_SUBPIXEL-1) >> NVGSW_SUBPIXEL_BITS), r->x1);
+	maxy = nvgsw__mini((int)((Y1 - NVGSW_SUBPIXEL/2 + NVGSW_SUBPIXEL-1) >> NVGSW_SUBPIXEL_BITS), r->y1);
+	if (minx >= maxx || miny >= maxy) return;
+
+	du = (s1 - s0) / (float)(X1 - X0);
+	dv = (t1 - t0) / (float)(Y1 - Y0);
+	for (y = miny; y < maxy; y++) {
+		cy = (long long)y * NVGSW_SUBPIXEL + NVGSW_SUBPIXEL/2;
+		v = t0 + dv * (float)(cy - Y0);
+		for (x = minx; x < maxx; x++) {
+			float color[4];
+			cx = (long long)x * NVGSW_SUBPIXEL + NVGSW_SUBPIXEL/2;
+			u = s0 + du * (float)(cx - X0);
+			if (!nvgsw__shade(r, (x + 0.5f) * isx, (y + 0.5f) * isy, u, v, color))
+				continue;
+			nvgsw__blend(r, &r->pixels[y * r->stride + x * 4], color);
+		}
+	}
+}
+
+static void nvgsw__drawFan(NVGSWraster* r, const NVGvertex* verts, int n)
+{
+	int i;
+	for (i = 2; i < n; i++)
+		nvgsw__triangle(r, &verts[0], &verts[i-1], &verts[i]);
+}
+
+static void nvgsw__drawStrip(NVGSWraster* r, const NVGvertex* verts, int n)
+{
+	int i;
+	for (i = 2; i < n; i++) {
+		if (i & 1)
+			nvgsw__triangle(r, &verts[i-1], &verts[i-2], &verts[i]);
+		else
+			nvgsw__triangle(r, &verts[i-2], &verts[i-1], &verts[i]);
+	}
+}
+
+static void nvgsw__drawTriangleList(NVGSWraster* r, const NVGvertex* verts, int n)
+{
+	int i;
+	for (i = 0; i+2 < n; i += 3)
+		nvgsw__triangle(r, &verts[i], &verts[i+1], &verts[i+2]);
+}
+
+static void nvgsw__setPass(NVGSWraster* r, int stencilFunc, int stencilPass, int stencilFail, int colorWrite, int cull)
+{
+	r->stencilFunc = stencilFunc;
+	r->stencilPass = stencilPass;
+	r->stencilFail = stencilFail;
+	r->colorWrite = colorWrite;
+	r->cull = cull;
+}
+
+static void nvgsw__drawFill(NVGSWcontext* sw, NVGSWraster* r, NVGSWcall* call)
+{
+	NVGSWpath* paths = &sw->paths[call->pathOffset];
+	int i, npaths = call->pathCount;
+
+	// Draw shapes into the stencil buffer.
+	r->frag = &sw->uniforms[call->uniformOffset];
+	r->tex = NULL;
+	nvgsw__setPass(r, NVGSW_ALWAYS, NVGSW_INCR_DECR_WRAP, NVGSW_KEEP, 0, 0);
+	for (i = 0; i < npaths; i++)
+		nvgsw__drawFan(r, &sw->verts[paths[i].fillOffset], paths[i].fillCount);
+
+	r->frag = &sw->uniforms[call->uniformOffset + 1];
+	r->tex = call->tex;
+
+	// Draw anti-aliased pixels.
+	if (sw->flags & NVG_ANTIALIAS) {
+		nvgsw__setPass(r, NVGSW_EQUAL, NVGSW_KEEP, NVGSW_KEEP, 1, 1);
+		for (i = 0; i < npaths; i++)
+			nvgsw__drawStrip(r, &sw->verts[paths[i].strokeOffset], paths[i].strokeCount);
+	}
+
+	// Draw fill, clearing the stencil as we go.
+	nvgsw__setPass(r, NVGSW_NOTEQUAL, NVGSW_ZERO, NVGSW_ZERO, 1, 1);
+	nvgsw__drawStrip(r, &sw->verts[call->triangleOffset], call->triangleCount);
+}
+
+static void nvgsw__drawConvexFill(NVGSWcontext* sw, NVGSWraster* r, NVGSWcall* call)
+{
+	NVGSWpath* paths = &sw->paths[call->pathOffset];
+	int i, npaths = call->pathCount;
+
+	r->frag = &sw->uniforms[call->uniformOffset];
+	r->tex = call->tex;
+	nvgsw__setPass(r, NVGSW_ALWAYS, NVGSW_KEEP, NVGSW_KEEP, 1, 1);
+	for (i = 0; i < npaths; i++) {
+		nvgsw__drawFan(r, &sw->verts[paths[i].fillOffset], paths[i].fillCount);
+		if (paths[i].strokeCount > 0)
+			nvgsw__drawStrip(r, &sw->verts[paths[i].strokeOffset], paths[i].strokeCount);
+	}
+}
+
+static void nvgsw__drawStroke(NVGSWcontext* sw, NVGSWraster* r, NVGSWcall* call)
+{
+	NVGSWpath* paths = &sw->paths[call->pathOffset];
+	int i, npaths = call->pathCount;
+
+	r->tex = call->tex;
+	if (sw->flags & NVG_STENCIL_STROKES) {
+		// Fill the stroke base without overlap.
+		r->frag = &sw->uniforms[call->uniformOffset + 1];
+		nvgsw__setPass(r, NVGSW_EQUAL, NVGSW_INCR_WRAP, NVGSW_KEEP, 1, 1);
+		for (i = 0; i < npaths; i++)
+			nvgsw__drawStrip(r, &sw->verts[paths[i].strokeOffset], paths[i].strokeCount);
+
+		// Draw anti-aliased pixels.
+		r->frag = &sw->uniforms[call->uniformOffset];
+		nvgsw__setPass(r, NVGSW_EQUAL, NVGSW_KEEP, NVGSW_KEEP, 1, 1);
+		for (i = 0; i < npaths; i++)
+			nvgsw__drawStrip(r, &sw->verts[paths[i].strokeOffset], paths[i].strokeCount);
+
+		// Clear stencil buffer.
+		nvgsw__setPass(r, NVGSW_ALWAYS, NVGSW_ZERO, NVGSW_ZERO, 0, 1);
+		for (i = 0; i < npaths; i++)
+			nvgsw__drawStrip(r, &sw->verts[paths[i].strokeOffset], paths[i].strokeCount);
+	} else {
+		r->frag = &sw->uniforms[call->uniformOffset];
+		nvgsw__setPass(r, NVGSW_ALWAYS, NVGSW_KEEP, NVGSW_KEEP, 1, 1);
+		for (i = 0; i < npaths; i++)
+			nvgsw__drawStrip(r, &sw->verts[paths[i].strokeOffset], paths[i].strokeCount);
+	}
+}
+
+static void nvgsw__drawTriangles(NVGSWcontext* sw, NVGSWraster* r, NVGSWcall* call)
+{
+	r->frag = &sw->uniforms[call->uniformOffset];
+	r->tex = call->tex;
+	nvgsw__setPass(r, NVGSW_ALWAYS, NVGSW_KEEP, NVGSW_KEEP, 1, 1);
+	nvgsw__drawTriangleList(r, &sw->verts[call->triangleOffset], call->triangleCount);
+}
+
+static void nvgsw__drawGlyphs(NVGSWcontext* sw, NVGSWraster* r, NVGSWcall* call)
+{
+	int i;
+	r->frag = &sw->uniforms[call->uniformOffset];
+	r->tex = call->tex;
+	for (i = 0; i < call->glyphCount; i++)
+		nvgsw__glyph(r, &sw->glyphs[call->glyphOffset + i]);
+}
+
+// Tiling and threading
+
+static void nvgsw__renderTile(NVGSWworker* w, int tile)
+{
+	NVGSWcontext* sw = w->sw;
+	NVGSWraster r;
+	int i, tx = tile % sw->tilesx, ty = tile / sw->tilesx;
+
+	memset(&r, 0, sizeof(r));
+	r.x0 = tx * NVGSW_TILE_SIZE;
+	r.y0 = ty * NVGSW_TILE_SIZE;
+	r.x1 = nvgsw__mini(r.x0 + NVGSW_TILE_SIZE, sw->width);
+	r.y1 = nvgsw__mini(r.y0 + NVGSW_TILE_SIZE, sw->height);
+	r.sx = sw->width / sw->view[0];
+	r.sy = sw->height / sw->view[1];
+	r.stencil = w->stencil;
+	r.pixels = sw->pixels;
+	r.stride = sw->stride;
+
+	memset(w->stencil, 0, sizeof(w->stencil));
+
+	for (i = sw->binStart[tile]; i < sw->binStart[tile+1]; i++) {
+		NVGSWcall* call = &sw->calls[sw->binCalls[i]];
+		r.blend = call->blend;
+		switch (call->type) {
+		case NVGSW_FILL:
+			nvgsw__drawFill(sw, &r, call);
+			break;
+		case NVGSW_CONVEXFILL:
+			nvgsw__drawConvexFill(sw, &r, call);
+			break;
+		case NVGSW_STROKE:
+			nvgsw__drawStroke(sw, &r, call);
+			break;
+		case NVGSW_TRIANGLES:
+			nvgsw__drawTriangles(sw, &r, call);
+			break;
+		case NVGSW_GLYPHS:
+			nvgsw__drawGlyphs(sw, &r, call);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static int nvgsw__claimTile(NVGSWcontext* sw)
+{
+	int tile;
+#ifndef NVGSW_NO_THREADS
+	pthread_mutex_lock(&sw->lock);
+	tile = sw->nextTile++;
+	pthread_mutex_unlock(&sw->lock);
+#else
+	tile = sw->nextTile++;
+#endif
+	return tile;
+}
+
+static void nvgsw__renderTiles(NVGSWworker* w)
+{
+	int tile;
+	while ((tile = nvgsw__claimTile(w->sw)) < w->sw->ntiles)
+		nvgsw__renderTile(w, tile);
+}
+
+#ifndef NVGSW_NO_THREADS
+static void* nvgsw__workerMain(void* arg)
+{
+	NVGSWworker* w = (NVGSWworker*)arg;
+	NVGSWcontext* sw = w->sw;
+	int generation = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&sw->lock);
+		while (sw->generation == generation && !sw->quit)
+			pthread_cond_wait(&sw->wake, &sw->lock);
+		if (sw->quit) {
+			pthread_mutex_unlock(&sw->lock);
+			break;
+		}
+		generation = sw->generation;
+		pthread_mutex_unlock(&sw->lock);
+
+		nvgsw__renderTiles(w);
+
+		pthread_mutex_lock(&sw->lock);
+		if (--sw->active == 0)
+			pthread_cond_signal(&sw->done);
+		pthread_mutex_unlock(&sw->lock);
+	}
+	return NULL;
+}
+#endif
+
+// Sorts the calls into per tile lists, keeping submission order within each tile.
+static int nvgsw__binCalls(NVGSWcontext* sw)
+{
+	int i, tx, ty, total = 0;
+	float sx = sw->width / sw->view[0], sy = sw->height / sw->view[1];
+
+	sw->tilesx = (sw->width + NVGSW_TILE_SIZE-1) / NVGSW_TILE_SIZE;
+	sw->tilesy = (sw->height + NVGSW_TILE_SIZE-1) / NVGSW_TILE_SIZE;
+	sw->ntiles = sw->tilesx * sw->tilesy;
+
+	if (sw->ntiles+1 > sw->cbinStart) {
+		int* binStart = (int*)realloc(sw->binStart, sizeof(int) * (sw->ntiles+1));
+		if (binStart == NULL) return 0;
+		sw->binStart = binStart;
+		sw->cbinStart = sw->ntiles+1;
+	}
+	memset(sw->binStart, 0, sizeof(int) * (sw->ntiles+1));
+
+	// Convert bounds to inclusive tile ranges, and count the calls in each tile.
+	for (i = 0; i < sw->ncalls; i++) {
+		NVGSWcall* call = &sw->calls[i];
+		float* b = call->bounds;
+		int x0 = (int)floorf(b[0] * sx) - 1, y0 = (int)floorf(b[1] * sy) - 1;
+		int x1 = (int)ceilf(b[2] * sx) + 1, y1 = (int)ceilf(b[3] * sy) + 1;
+		if (b[0] > b[2] || x1 < 0 || y1 < 0 || x0 >= sw->width || y0 >= sw->height) {
+			b[0] = 1.0f; b[2] = 0.0f;
+			continue;
+		}
+		b[0] = (float)(nvgsw__maxi(x0, 0) / NVGSW_TILE_SIZE);
+		b[1] = (float)(nvgsw__maxi(y0, 0) / NVGSW_TILE_SIZE);
+		b[2] = (float)(nvgsw__mini(x1, sw->width-1) / NVGSW_TILE_SIZE);
+		b[3] = (float)(nvgsw__mini(y1, sw->height-1) / NVGSW_TILE_SIZE);
+		for (ty = (int)b[1]; ty <= (int)b[3]; ty++)
+			for (tx = (int)b[0]; tx <= (int)b[2]; tx++)
+				sw->binStart[ty * sw->tilesx + tx + 1]++;
+	}
+
+	// Exclusive prefix sum, the start of tile i is stored at i+1 while filling.
+	for (i = 0; i < sw->ntiles; i++) {
+		int count = sw->binStart[i+1];
+		sw->binStart[i+1] = total;
+		total += count;
+	}
+
+	if (total > sw->cbinCalls) {
+		int cbinCalls = nvgsw__maxi(total, 1024) + sw->cbinCalls/2; // 1.5x Overallocate
+		int* binCalls = (int*)realloc(sw->binCalls, sizeof(int) * cbinCalls);
+		if (binCalls == NULL) return 0;
+		sw->binCalls = binCalls;
+		sw->cbinCalls = cbinCalls;
+	}
+
+	// Fill the lists, after this the entry at i+1 is the end of tile i.
+	for (i = 0; i < sw->ncalls; i++) {
+		float* b = sw->calls[i].bounds;
+		if (b[0] > b[2]) continue;
+		for (ty = (int)b[1]; ty <= (int)b[3]; ty++)
+			for (tx = (int)b[0]; tx <= (int)b[2]; tx++)
+				sw->binCalls[sw->binStart[ty * sw->tilesx + tx + 1]++] = i;
+	}
+
+	return 1;
+}
+
+// Backend interface
+
+static int nvgsw__renderCreate(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+	return 1;
+}
+
+static int nvgsw__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	NVGSWtexture* tex = nvgsw__allocTexture(sw);
+	int size = w * h * (type == NVG_TEXTURE_RGBA ? 4 : 1);
+
+	if (tex == NULL) return 0;
+
+	tex->data = (unsigned char*)malloc(size);
+	if (tex->data == NULL) {
+		tex->id = 0;
+		return 0;
+	}
+	if (data != NULL)
+		memcpy(tex->data, data, size);
+	else
+		memset(tex->data, 0, size);
+
+	tex->width = w;
+	tex->height = h;
+	tex->type = type;
+	tex->flags = imageFlags;
+
+	return tex->id;
+}
+
+static int nvgsw__renderDeleteTexture(void* uptr, int image)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	NVGSWtexture* tex = nvgsw__findTexture(sw, image);
+	if (tex == NULL) return 0;
+	free(tex->data);
+	memset(tex, 0, sizeof(*tex));
+	return 1;
+}
+
+static int nvgsw__renderUpdateTexture(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	NVGSWtexture* tex = nvgsw__findTexture(sw, image);
+	int i, bpp;
+
+	if (tex == NULL) return 0;
+
+	// The data pointer points to the whole image, like in the Metal backend.
+	bpp = tex->type == NVG_TEXTURE_RGBA ? 4 : 1;
+	for (i = y; i < y + h; i++)
+		memcpy(&tex->data[(i * tex->width + x) * bpp], &data[(i * tex->width + x) * bpp], w * bpp);
+
+	return 1;
+}
+
+static int nvgsw__renderGetTextureSize(void* uptr, int image, int* w, int* h)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	NVGSWtexture* tex = nvgsw__findTexture(sw, image);
+	if (tex == NULL) return 0;
+	*w = tex->width;
+	*h = tex->height;
+	return 1;
+}
+
+static void nvgsw__renderViewport(void* uptr, float width, float height, float devicePixelRatio)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	NVG_NOTUSED(devicePixelRatio);
+	sw->view[0] = width;
+	sw->view[1] = height;
+}
+
+static void nvgsw__renderCancel(void* uptr)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	sw->nverts = 0;
+	sw->nglyphs = 0;
+	sw->npaths = 0;
+	sw->ncalls = 0;
+	sw->nuniforms = 0;
+}
+
+static void nvgsw__renderFlush(void* uptr)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	int i;
+
+	if (sw->ncalls > 0 && sw->pixels != NULL && sw->width > 0 && sw->height > 0 &&
+		sw->view[0] > 0.0f && sw->view[1] > 0.0f) {
+
+		// Textures may have moved since the calls were recorded.
+		for (i = 0; i < sw->ncalls; i++)
+			sw->calls[i].tex = sw->calls[i].image != 0 ? nvgsw__findTexture(sw, sw->calls[i].image) : NULL;
+
+		if (nvgsw__binCalls(sw)) {
+			sw->nextTile = 0;
+#ifndef NVGSW_NO_THREADS
+			if (sw->nworkers > 1) {
+				pthread_mutex_lock(&sw->lock);
+				sw->active = sw->nworkers - 1;
+				sw->generation++;
+				pthread_cond_broadcast(&sw->wake);
+				pthread_mutex_unlock(&sw->lock);
+
+				nvgsw__renderTiles(&sw->workers[0]);
+
+				pthread_mutex_lock(&sw->lock);
+				while (sw->active > 0)
+					pthread_cond_wait(&sw->done, &sw->lock);
+				pthread_mutex_unlock(&sw->lock);
+			} else
+#endif
+			{
+				nvgsw__renderTiles(&sw->workers[0]);
+			}
+		}
+	}
+
+	sw->nverts = 0;
+	sw->nglyphs = 0;
+	sw->npaths = 0;
+	sw->ncalls = 0;
+	sw->nuniforms = 0;
+}
+
+static void nvgsw__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+							  const float* bounds, const NVGpath* paths, int npaths)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	NVGSWcall* call = nvgsw__allocCall(sw);
+	NVGvertex* quad;
+	int i, maxverts, offset;
+
+	if (call == NULL) return;
+
+	call->type = NVGSW_FILL;
+	call->triangleCount = 4;
+	call->pathOffset = nvgsw__allocPaths(sw, npaths);
+	if (call->pathOffset == -1) goto error;
+	call->pathCount = npaths;
+	call->image = paint->image;
+	call->blend = compositeOperation;
+	call->bounds[0] = call->bounds[1] = 1e6f;
+	call->bounds[2] = call->bounds[3] = -1e6f;
+
+	if (npaths == 1 && paths[0].convex) {
+		call->type = NVGSW_CONVEXFILL;
+		call->triangleCount = 0;	// Bounding box fill quad not needed for convex fill
+	}
+
+	// Allocate vertices for all the paths.
+	maxverts = nvgsw__maxVertCount(paths, npaths) + call->triangleCount;
+	offset = nvgsw__allocVerts(sw, maxverts);
+	if (offset == -1) goto error;
+
+	for (i = 0; i < npaths; i++) {
+		NVGSWpath* copy = &sw->paths[call->pathOffset + i];
+		const NVGpath* path = &paths[i];
+		memset(copy, 0, sizeof(NVGSWpath));
+		if (path->nfill > 0) {
+			copy->fillOffset = offset;
+			copy->fillCount = path->nfill;
+			memcpy(&sw->verts[offset], path->fill, sizeof(NVGvertex) * path->nfill);
+			nvgsw__callBounds(call, path->fill, path->nfill);
+			offset += path->nfill;
+		}
+		if (path->nstroke > 0) {
+			copy->strokeOffset = offset;
+			copy->strokeCount = path->nstroke;
+			memcpy(&sw->verts[offset], path->stroke, sizeof(NVGvertex) * path->nstroke);
+			nvgsw__callBounds(call, path->stroke, path->nstroke);
+			offset += path->nstroke;
+		}
+	}
+
+	if (call->type == NVGSW_FILL) {
+		// Quad
+		call->triangleOffset = offset;
+		quad = &sw->verts[call->triangleOffset];
+		quad[0].x = bounds[2]; quad[0].y = bounds[3]; quad[0].u = 0.5f; quad[0].v = 1.0f;
+		quad[1].x = bounds[2]; quad[1].y = bounds[1]; quad[1].u = 0.5f; quad[1].v = 1.0f;
+		quad[2].x = bounds[0]; quad[2].y = bounds[3]; quad[2].u = 0.5f; quad[2].v = 1.0f;
+		quad[3].x = bounds[0]; quad[3].y = bounds[1]; quad[3].u = 0.5f; quad[3].v = 1.0f;
+		nvgsw__callBounds(call, quad, 4);
+
+		call->uniformOffset = nvgsw__allocFragUniforms(sw, 2);
+		if (call->uniformOffset == -1) goto error;
+		// Simple shader for stencil
+		memset(&sw->uniforms[call->uniformOffset], 0, sizeof(NVGSWfragUniforms));
+		sw->uniforms[call->uniformOffset].strokeThr = -1.0f;
+		sw->uniforms[call->uniformOffset].type = NVGSW_SHADER_SIMPLE;
+		// Fill shader
+		nvgsw__convertPaint(sw, &sw->uniforms[call->uniformOffset + 1], paint, scissor, fringe, fringe, -1.0f);
+	} else {
+		call->uniformOffset = nvgsw__allocFragUniforms(sw, 1);
+		if (call->uniformOffset == -1) goto error;
+		// Fill shader
+		nvgsw__convertPaint(sw, &sw->uniforms[call->uniformOffset], paint, scissor, fringe, fringe, -1.0f);
+	}
+
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (sw->ncalls > 0) sw->ncalls--;
+}
+
+static void nvgsw__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+								float strokeWidth, const NVGpath* paths, int npaths)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	NVGSWcall* call = nvgsw__allocCall(sw);
+	int i, maxverts, offset;
+
+	if (call == NULL) return;
+
+	call->type = NVGSW_STROKE;
+	call->pathOffset = nvgsw__allocPaths(sw, npaths);
+	if (call->pathOffset == -1) goto error;
+	call->pathCount = npaths;
+	call->image = paint->image;
+	call->blend = compositeOperation;
+	call->bounds[0] = call->bounds[1] = 1e6f;
+	call->bounds[2] = call->bounds[3] = -1e6f;
+
+	// Allocate vertices for all the paths.
+	maxverts = nvgsw__maxVertCount(paths, npaths);
+	offset = nvgsw__allocVerts(sw, maxverts);
+	if (offset == -1) goto error;
+
+	for (i = 0; i < npaths; i++) {
+		NVGSWpath* copy = &sw->paths[call->pathOffset + i];
+		const NVGpath* path = &paths[i];
+		memset(copy, 0, sizeof(NVGSWpath));
+		if (path->nstroke) {
+			copy->strokeOffset = offset;
+			copy->strokeCount = path->nstroke;
+			memcpy(&sw->verts[offset], path->stroke, sizeof(NVGvertex) * path->nstroke);
+			nvgsw__callBounds(call, path->stroke, path->nstroke);
+			offset += path->nstroke;
+		}
+	}
+
+	if (sw->flags & NVG_STENCIL_STROKES) {
+		// Fill shader
+		call->uniformOffset = nvgsw__allocFragUniforms(sw, 2);
+		if (call->uniformOffset == -1) goto error;
+		nvgsw__convertPaint(sw, &sw->uniforms[call->uniformOffset], paint, scissor, strokeWidth, fringe, -1.0f);
+		nvgsw__convertPaint(sw, &sw->uniforms[call->uniformOffset + 1], paint, scissor, strokeWidth, fringe, 1.0f - 0.5f/255.0f);
+	} else {
+		// Fill shader
+		call->uniformOffset = nvgsw__allocFragUniforms(sw, 1);
+		if (call->uniformOffset == -1) goto error;
+		nvgsw__convertPaint(sw, &sw->uniforms[call->uniformOffset], paint, scissor, strokeWidth, fringe, -1.0f);
+	}
+
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (sw->ncalls > 0) sw->ncalls--;
+}
+
+static void nvgsw__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+								   const NVGvertex* verts, int nverts, float fringe)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	NVGSWcall* call = nvgsw__allocCall(sw);
+	NVGSWfragUniforms* frag;
+
+	if (call == NULL) return;
+
+	call->type = NVGSW_TRIANGLES;
+	call->image = paint->image;
+	call->blend = compositeOperation;
+	call->bounds[0] = call->bounds[1] = 1e6f;
+	call->bounds[2] = call->bounds[3] = -1e6f;
+
+	// Allocate vertices for all the paths.
+	call->triangleOffset = nvgsw__allocVerts(sw, nverts);
+	if (call->triangleOffset == -1) goto error;
+	call->triangleCount = nverts;
+
+	memcpy(&sw->verts[call->triangleOffset], verts, sizeof(NVGvertex) * nverts);
+	nvgsw__callBounds(call, verts, nverts);
+
+	// Fill shader
+	call->uniformOffset = nvgsw__allocFragUniforms(sw, 1);
+	if (call->uniformOffset == -1) goto error;
+	frag = &sw->uniforms[call->uniformOffset];
+	nvgsw__convertPaint(sw, frag, paint, scissor, 1.0f, fringe, -1.0f);
+	frag->type = NVGSW_SHADER_IMG;
+
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (sw->ncalls > 0) sw->ncalls--;
+}
+
+static void nvgsw__renderGlyphs(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+								const NVGglyphInstance* glyphs, int nglyphs, float fringe)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	NVGSWcall* call = nvgsw__allocCall(sw);
+	NVGSWfragUniforms* frag;
+	int i;
+
+	if (call == NULL) return;
+
+	call->type = NVGSW_GLYPHS;
+	call->image = paint->image;
+	call->blend = compositeOperation;
+	call->bounds[0] = call->bounds[1] = 1e6f;
+	call->bounds[2] = call->bounds[3] = -1e6f;
+
+	call->glyphOffset = nvgsw__allocGlyphs(sw, nglyphs);
+	if (call->glyphOffset == -1) goto error;
+	call->glyphCount = nglyphs;
+
+	memcpy(&sw->glyphs[call->glyphOffset], glyphs, sizeof(NVGglyphInstance) * nglyphs);
+	for (i = 0; i < nglyphs; i++) {
+		const NVGglyphInstance* g = &glyphs[i];
+		call->bounds[0] = nvgsw__minf(call->bounds[0], nvgsw__minf(g->x, g->x + g->w));
+		call->bounds[1] = nvgsw__minf(call->bounds[1], nvgsw__minf(g->y, g->y + g->h));
+		call->bounds[2] = nvgsw__maxf(call->bounds[2], nvgsw__maxf(g->x, g->x + g->w));
+		call->bounds[3] = nvgsw__maxf(call->bounds[3], nvgsw__maxf(g->y, g->y + g->h));
+	}
+
+	// Fill shader
+	call->uniformOffset = nvgsw__allocFragUniforms(sw, 1);
+	if (call->uniformOffset == -1) goto error;
+	frag = &sw->uniforms[call->uniformOffset];
+	nvgsw__convertPaint(sw, frag, paint, scissor, 1.0f, fringe, -1.0f);
+	frag->type = NVGSW_SHADER_IMG;
+
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (sw->ncalls > 0) sw->ncalls--;
+}
+
+static void nvgsw__renderDelete(void* uptr)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)uptr;
+	int i;
+	if (sw == NULL) return;
+
+#ifndef NVGSW_NO_THREADS
+	if (sw->threads != NULL) {
+		pthread_mutex_lock(&sw->lock);
+		sw->quit = 1;
+		pthread_cond_broadcast(&sw->wake);
+		pthread_mutex_unlock(&sw->lock);
+		for (i = 1; i < sw->nworkers; i++)
+			pthread_join(sw->threads[i], NULL);
+		free(sw->threads);
+	}
+	pthread_mutex_destroy(&sw->lock);
+	pthread_cond_destroy(&sw->wake);
+	pthread_cond_destroy(&sw->done);
+#endif
+
+	for (i = 0; i < sw->ntextures; i++)
+		free(sw->textures[i].data);
+	free(sw->textures);
+
+	free(sw->workers);
+	free(sw->binStart);
+	free(sw->binCalls);
+	free(sw->paths);
+	free(sw->verts);
+	free(sw->glyphs);
+	free(sw->uniforms);
+	free(sw->calls);
+
+	free(sw);
+}
+
+// Public API
+
+NVGcontext* nvgCreateSW(int flags, int nthreads)
+{
+	NVGparams params;
+	NVGSWcontext* sw = (NVGSWcontext*)malloc(sizeof(NVGSWcontext));
+	int i;
+	if (sw == NULL) return NULL;
+	memset(sw, 0, sizeof(NVGSWcontext));
+	sw->flags = flags;
+
+#ifndef NVGSW_NO_THREADS
+	pthread_mutex_init(&sw->lock, NULL);
+	pthread_cond_init(&sw->wake, NULL);
+	pthread_cond_init(&sw->done, NULL);
+	if (nthreads <= 0)
+		nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	sw->nworkers = nvgsw__maxi(nthreads, 1);
+#ifdef NVGSW_NO_THREADS
+	sw->nworkers = 1;
+#endif
+
+	sw->workers = (NVGSWworker*)malloc(sizeof(NVGSWworker) * sw->nworkers);
+	if (sw->workers == NULL) goto error;
+	for (i = 0; i < sw->nworkers; i++)
+		sw->workers[i].sw = sw;
+
+#ifndef NVGSW_NO_THREADS
+	if (sw->nworkers > 1) {
+		sw->threads = (pthread_t*)malloc(sizeof(pthread_t) * sw->nworkers);
+		if (sw->threads == NULL) goto error;
+		for (i = 1; i < sw->nworkers; i++) {
+			if (pthread_create(&sw->threads[i], NULL, nvgsw__workerMain, &sw->workers[i]) != 0) {
+				sw->nworkers = i;
+				break;
+			}
+		}
+	}
+#endif
+
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = nvgsw__renderCreate;
+	params.renderCreateTexture = nvgsw__renderCreateTexture;
+	params.renderDeleteTexture = nvgsw__renderDeleteTexture;
+	params.renderUpdateTexture = nvgsw__renderUpdateTexture;
+	params.renderGetTextureSize = nvgsw__renderGetTextureSize;
+	params.renderViewport = nvgsw__renderViewport;
+	params.renderCancel = nvgsw__renderCancel;
+	params.renderFlush = nvgsw__renderFlush;
+	params.renderFill = nvgsw__renderFill;
+	params.renderStroke = nvgsw__renderStroke;
+	params.renderTriangles = nvgsw__renderTriangles;
+	params.renderGlyphs = nvgsw__renderGlyphs;
+	params.renderDelete = nvgsw__renderDelete;
+	params.userPtr = sw;
+	params.edgeAntiAlias = flags & NVG_ANTIALIAS ? 1 : 0;
+	params.threadedTessellation = flags & NVG_THREADED_TESSELLATION ? 1 : 0;
+	params.sdfText = flags & NVG_SDF_TEXT ? 1 : 0;
+
+	// From here on 'sw' belongs to the context, which frees it on failure.
+	return nvgCreateInternal(&params);
+
+error:
+	nvgsw__renderDelete(sw);
+	return NULL;
+}
+
+void nvgDeleteSW(NVGcontext* ctx)
+{
+	nvgDeleteInternal(ctx);
+}
+
+void nvgBeginFrameSW(NVGcontext* ctx, unsigned char* pixels, int width, int height, int stride)
+{
+	NVGSWcontext* sw = (NVGSWcontext*)nvgInternalParams(ctx)->userPtr;
+	sw->pixels = pixels;
+	sw->width = width;
+	sw->height = height;
+	sw->stride = stride;
+}
+
+#endif /* NANOVG_SW_IMPLEMENTATION */